@@ -0,0 +1,71 @@
+/**
+ * @file ACatAsync.cpp
+ * @brief 异步星表查找: 后台I/O线程按提交顺序执行查找, 调用者以future获取结果
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include "ACatAsync.h"
+
+using std::mutex;
+using std::unique_lock;
+using std::future;
+
+namespace AstroUtil {
+///////////////////////////////////////////////////////////////////////////////
+ACatAsync::ACatAsync(ACatalog &cat)
+	: m_cat(cat) {
+	m_stop = false;
+	m_thrd = std::thread(&ACatAsync::thread_io, this);
+}
+
+ACatAsync::~ACatAsync() {
+	{
+		unique_lock<mutex> lck(m_mtx);
+		m_stop = true;
+		m_queue.clear();
+	}
+	m_cv.notify_one();
+	m_thrd.join();
+}
+
+future<CatStarVec> ACatAsync::FindStar(double ra0, double dec0, double radius) {
+	request req;
+	req.ra0    = ra0;
+	req.dec0   = dec0;
+	req.radius = radius;
+	future<CatStarVec> result = req.result.get_future();
+	{
+		unique_lock<mutex> lck(m_mtx);
+		m_queue.push_back(std::move(req));
+	}
+	m_cv.notify_one();
+	return result;
+}
+
+void ACatAsync::Cancel() {
+	unique_lock<mutex> lck(m_mtx);
+	m_queue.clear();
+}
+
+void ACatAsync::thread_io() {
+	while (true) {
+		request req;
+		{
+			unique_lock<mutex> lck(m_mtx);
+			m_cv.wait(lck, [this]() { return m_stop || !m_queue.empty(); });
+			if (m_stop) break;
+			req = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		CatStarVec stars;
+		m_cat.FindStar(req.ra0, req.dec0, req.radius, [&stars](double ra, double dec, double mag) {
+			cat_star star = { ra, dec, mag };
+			stars.push_back(star);
+		});
+		req.result.set_value(std::move(stars));
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
@@ -0,0 +1,79 @@
+/**
+ * @file ACatAsync.h
+ * @brief 异步星表查找: 后台I/O线程按提交顺序执行查找, 调用者以future获取结果
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 用于在匹配当前天区的同时预取后续天区的参考星
+ */
+
+#ifndef ACATASYNC_H_
+#define ACATASYNC_H_
+
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "ACatalog.h"
+
+namespace AstroUtil {
+///////////////////////////////////////////////////////////////////////////////
+class ACatAsync {
+public:
+	/*!
+	 * @brief 构造函数, 启动后台I/O线程
+	 * @param cat  星表. 此后星表只能由后台线程访问
+	 */
+	ACatAsync(ACatalog &cat);
+	/*!
+	 * @brief 析构函数, 放弃尚未执行的查找并结束后台线程
+	 */
+	virtual ~ACatAsync();
+
+protected:
+	/* 数据类型 */
+	struct request {///< 查找请求
+		double ra0, dec0, radius;
+		std::promise<CatStarVec> result;
+	};
+
+protected:
+	/* 成员变量 */
+	ACatalog &m_cat;					//< 星表
+	std::deque<request> m_queue;		//< 待执行的查找请求
+	std::mutex m_mtx;					//< 请求队列互斥锁
+	std::condition_variable m_cv;		//< 请求队列条件变量
+	bool m_stop;						//< 后台线程退出标记
+	std::thread m_thrd;					//< 后台I/O线程
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 提交查找请求
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角分
+	 * @return
+	 * 查找结果. 参数错误或星表不可用时为空集合
+	 */
+	std::future<CatStarVec> FindStar(double ra0, double dec0, double radius);
+	/*!
+	 * @brief 放弃尚未执行的查找
+	 * @note
+	 * 被放弃查找的future以std::future_error(broken_promise)结束
+	 */
+	void Cancel();
+
+protected:
+	/* 功能 */
+	/*!
+	 * @brief 后台线程: 依次执行队列中的查找请求
+	 */
+	void thread_io();
+};
+///////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
+
+#endif /* ACATASYNC_H_ */
@@ -0,0 +1,358 @@
+/**
+ * @file ACatMmap.cpp
+ * @brief 内存映射星表: 适用于数亿颗恒星量级的星表(UCAC4, Gaia)
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#include "ACatMmap.h"
+
+using std::string;
+using std::vector;
+using std::mutex;
+using std::shared_ptr;
+using std::weak_ptr;
+
+namespace AstroUtil {
+///////////////////////////////////////////////////////////////////////////////
+/*!
+ * @struct catmmap_data
+ * @brief 星表不可变数据: 文件映射及其中的文件头、索引和恒星数据
+ * @note
+ * - 进程内按文件路径登记, 同一星表文件的全部实例共享一个映射
+ * - 由std::call_once映射一次, 此后只读
+ * - 已访问天区的记录属于映射, 由全部实例共同计入内存预算, 以互斥锁保护
+ */
+struct catmmap_data {
+	string path;				///< 星表文件路径
+	std::once_flag once;		///< 映射标记
+	void *map;					///< 文件映射地址
+	size_t bytes;				///< 文件字节数
+	catmmap_header *header;		///< 文件头
+	ptr_catmmap_zone zone0;		///< 一级索引
+	ptr_catmmap_zone zone1;		///< 二级索引
+	ptr_tycho2_elem stars;		///< 恒星数据
+	/* 内存预算 */
+	mutable mutex mtxlru;		///< 访问记录互斥锁
+	mutable std::list<int> lru;	///< 已访问一级天区, 最近访问的在前
+	mutable vector<std::list<int>::iterator> lrupos;	///< 一级天区在lru中的位置
+	mutable vector<bool> inlru;	///< 一级天区是否在lru中
+	mutable size_t resident;	///< 已访问天区的字节数
+
+public:
+	catmmap_data(const char *pathcat)
+		: path(pathcat) {
+		map    = NULL;
+		bytes  = 0;
+		header = NULL;
+		zone0  = zone1 = NULL;
+		stars  = NULL;
+		resident = 0;
+	}
+
+	~catmmap_data() {
+		if (map) munmap(map, bytes);
+	}
+
+	/*!
+	 * @brief 获取星表文件的共享映射
+	 * @param pathcat  星表文件路径
+	 * @return
+	 * 已登记的共享映射, 或新建并登记的共享映射. 全部实例释放后解除映射
+	 */
+	static shared_ptr<catmmap_data> Open(const char *pathcat) {
+		static mutex mtx;
+		static std::map<string, weak_ptr<catmmap_data> > registry;
+
+		std::lock_guard<mutex> lck(mtx);
+		weak_ptr<catmmap_data>& entry = registry[pathcat];
+		shared_ptr<catmmap_data> data = entry.lock();
+		if (!data) {
+			data = std::make_shared<catmmap_data>(pathcat);
+			entry = data;
+		}
+		return data;
+	}
+
+	/*!
+	 * @brief 映射文件. 仅首次调用执行映射
+	 * @return
+	 * 映射可用时返回true
+	 */
+	bool Load() {
+		std::call_once(once, [this]() {
+			if (!map_file() && map) {
+				munmap(map, bytes);
+				map = NULL;
+			}
+		});
+		return map != NULL;
+	}
+
+	/*!
+	 * @brief 记录一级天区被访问. 超出内存预算时释放最久未访问的天区
+	 * @param zc      一级天区编号
+	 * @param budget  常驻内存预算, 量纲: 字节. 0表示不限制
+	 * @note
+	 * 释放的天区再次访问时由文件重新加载, 不影响正在访问该天区的查找
+	 */
+	void Touch(int zc, size_t budget) const {
+		std::lock_guard<mutex> lck(mtxlru);
+		if (inlru[zc]) {
+			lru.splice(lru.begin(), lru, lrupos[zc]);
+			return;
+		}
+		lru.push_front(zc);
+		lrupos[zc] = lru.begin();
+		inlru[zc]  = true;
+		resident  += size_t(zone0[zc].number) * sizeof(tycho2_elem);
+		if (!budget) return;
+
+		// 释放最久未访问的天区, 直至满足预算. 当前天区始终保留
+		size_t page = sysconf(_SC_PAGESIZE);
+		while (resident > budget && lru.size() > 1) {
+			int zo = lru.back();
+			size_t n = size_t(zone0[zo].number) * sizeof(tycho2_elem);
+			size_t begin = size_t((char*) (stars + zone0[zo].start) - (char*) map);
+			size_t end   = begin + n;
+			begin = begin / page * page;
+			end   = (end + page - 1) / page * page;
+			if (end > bytes) end = bytes;
+			madvise((char*) map + begin, end - begin, MADV_DONTNEED);
+			lru.pop_back();
+			inlru[zo] = false;
+			resident -= n;
+		}
+	}
+
+	/*!
+	 * @brief 查看已访问天区占用的常驻内存
+	 */
+	size_t Resident() const {
+		std::lock_guard<mutex> lck(mtxlru);
+		return resident;
+	}
+
+protected:
+	bool map_file() {
+		struct stat st;
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		if (fstat(fd, &st) || st.st_size < (off_t) sizeof(catmmap_header)) {
+			close(fd);
+			return false;
+		}
+		bytes = st.st_size;
+		map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED) {
+			map = NULL;
+			return false;
+		}
+		// 检查文件头与索引的完整性
+		header = (catmmap_header*) map;
+		size_t n0 = size_t(header->nZR) * header->nZD;
+		size_t n1 = n0 * header->nsub * header->nsub;
+		size_t offset = sizeof(catmmap_header) + (n0 + n1) * sizeof(catmmap_zone);
+		if (memcmp(header->magic, CATMMAP_MAGIC, sizeof(header->magic)) || !n1
+				|| bytes < offset + size_t(header->nstar) * sizeof(tycho2_elem))
+			return false;
+		zone0 = (ptr_catmmap_zone) ((char*) map + sizeof(catmmap_header));
+		zone1 = zone0 + n0;
+		lrupos.resize(n0);
+		inlru.assign(n0, false);
+		stars = (ptr_tycho2_elem) ((char*) map + offset);
+		// 索引常驻内存, 数据区按需加载, 不做预读
+		madvise(map, offset, MADV_WILLNEED);
+		madvise(stars, bytes - offset, MADV_RANDOM);
+		return true;
+	}
+};
+
+ACatMmap::ACatMmap()
+	: ACatalog() {
+	m_maglim = 99000;
+	m_budget = size_t(256) << 20;
+}
+
+ACatMmap::ACatMmap(const char *pathdir)
+	: ACatalog(pathdir) {
+	m_data   = catmmap_data::Open(m_pathCat);
+	m_maglim = 99000;
+	m_budget = size_t(256) << 20;
+}
+
+ACatMmap::~ACatMmap() {
+}
+
+bool ACatMmap::IsMmapFile(const char *filepath) {
+	char magic[8];
+	FILE *fp = fopen(filepath, "rb");
+	bool rslt(false);
+
+	if (fp) {
+		rslt = fread(magic, sizeof(magic), 1, fp) == 1 && !memcmp(magic, CATMMAP_MAGIC, sizeof(magic));
+		fclose(fp);
+	}
+	return rslt;
+}
+
+ACatalog* ACatMmap::Open(const char *filepath, size_t budget, double maglim) {
+	if (IsMmapFile(filepath)) {
+		ACatMmap *cat = new ACatMmap(filepath);
+		cat->SetMemoryBudget(budget);
+		cat->SetMagLimit(maglim);
+		return cat;
+	}
+	return new ACatTycho2(filepath);
+}
+
+void ACatMmap::SetMemoryBudget(size_t bytes) {
+	m_budget = bytes;
+}
+
+void ACatMmap::SetMagLimit(double mag) {
+	m_maglim = int(mag * 1000.0);
+}
+
+ptr_tycho2_elem ACatMmap::GetResult(int &n) {
+	n = m_nstars;
+	return m_stars.data();
+}
+
+void ACatMmap::SetPathRoot(const char *pathdir) {
+	ACatalog::SetPathRoot(pathdir);
+	m_data = catmmap_data::Open(m_pathCat);
+}
+
+const catmmap_data* ACatMmap::Map() const {
+	return m_data && m_data->Load() ? m_data.get() : NULL;
+}
+
+size_t ACatMmap::ResidentBytes() const {
+	return m_data ? m_data->Resident() : 0;
+}
+
+template <class Func>
+int ACatMmap::ScanZone(const catmmap_data& data, catseek_border csb, double ra0, double dec0, double radius,
+		const cat_footprint* fp, Func&& func) {
+	int step(data.header->step), nsub(data.header->nsub);
+	int nZR(data.header->nZR), nZD(data.header->nZD);
+	int substep = step / nsub;
+	csb.zone_seek(step, step);
+	if (csb.zdmax >= nZD) csb.zdmax = nZD - 1;
+
+	// 以余弦比较距离, 避免逐星反三角运算
+	double sd0(sin(dec0 * D2R)), cd0(cos(dec0 * D2R));
+	double cosr = cos(radius * D2R);
+	int zr, zd, zc, i, j, i0, i1, j0, j1;
+	int ra_lo, spd_lo;	// 一级天区起始位置, 赤经未折算到[0, 360)
+	int n(0);
+
+	for (zd = csb.zdmin; zd <= csb.zdmax; ++zd) {// 遍历赤纬
+		spd_lo = zd * step;
+		// 与搜索范围相交的子天区行
+		j0 = (csb.spdmin - spd_lo) / substep;
+		j1 = (csb.spdmax - spd_lo) / substep;
+		if (j0 < 0) j0 = 0;
+		if (j1 >= nsub) j1 = nsub - 1;
+		for (zr = csb.zrmin; zr <= csb.zrmax; ++zr) {// 遍历赤经
+			zc = zd * nZR + (zr % nZR);
+			if (!data.zone0[zc].number) continue;
+			ra_lo = zr * step;
+			// 与搜索范围相交的子天区列
+			i0 = (csb.ramin - ra_lo) / substep;
+			i1 = (csb.ramax - ra_lo) / substep;
+			if (csb.ramin < ra_lo) i0 = 0;
+			if (i1 >= nsub) i1 = nsub - 1;
+			data.Touch(zc, m_budget);
+
+			for (j = j0; j <= j1; ++j) {
+				ptr_catmmap_zone zone = data.zone1 + (size_t(zc) * nsub + j) * nsub;
+				for (i = i0; i <= i1; ++i) {
+					ptr_tycho2_elem star = data.stars + zone[i].start;
+					ptr_tycho2_elem last = star + zone[i].number;
+					if (star == last) continue;
+					// 与查找区域不相交的子天区不访问
+					if (fp && !fp->Overlap((ra_lo + i * substep) * MAS2D, (ra_lo + (i + 1) * substep) * MAS2D,
+							(spd_lo + j * substep) * MAS2D - 90.0, (spd_lo + (j + 1) * substep) * MAS2D - 90.0))
+						continue;
+					// 子天区内按星等递增排列
+					for (; star < last && star->mag <= m_maglim; ++star) {
+						if (fp) {
+							if (!fp->Contains(star->ra * MAS2D, star->spd * MAS2D - 90.0)) continue;
+							func(*star);
+							++n;
+							continue;
+						}
+						double ra = star->ra * MAS2D * D2R;
+						double de = (star->spd * MAS2D - 90.0) * D2R;
+						double sd(sin(de)), cd(cos(de));
+						if (sd * sd0 + cd * cd0 * cos(ra - ra0 * D2R) < cosr) continue;
+						func(*star);
+						++n;
+					}
+				}
+			}
+		}
+	}
+
+	return n;
+}
+
+bool ACatMmap::FindStar(double ra0, double dec0, double radius) {
+	const catmmap_data* data;
+	if (!(ACatalog::FindStar(ra0, dec0, radius) && (data = Map())))
+		return false;
+
+	// 缓存区保留容量, 内存不足时查找失败
+	m_stars.clear();
+	try {
+		ScanZone(*data, m_csb, ra0, dec0, radius / 60.0, NULL, [this](const tycho2_elem& elem) {
+			m_stars.push_back(elem);
+		});
+	}
+	catch (std::bad_alloc&) {
+		m_stars.clear();
+	}
+	m_nstars = m_stars.size();
+	m_max    = m_stars.capacity();
+	return (m_nstars > 0);
+}
+
+int ACatMmap::FindStar(double ra0, double dec0, double radius, const CatStarVisitor& visit) {
+	const catmmap_data* data;
+	if (!(ValidSeek(ra0, dec0, radius) && (data = Map())))
+		return -1;
+
+	// 搜索边界为局部变量, 不修改实例状态
+	catseek_border csb(ra0, dec0, radius / 60.0);
+	return ScanZone(*data, csb, ra0, dec0, radius / 60.0, NULL, [&visit](const tycho2_elem& elem) {
+		visit(elem.ra * MAS2D, elem.spd * MAS2D - 90.0, elem.mag * 0.001);
+	});
+}
+
+int ACatMmap::FindStar(const cat_footprint& fp, const CatStarVisitor& visit) {
+	const catmmap_data* data;
+	if (!(ValidSeek(fp.ra, fp.dec, fp.radius * 60.0) && (data = Map())))
+		return -1;
+
+	catseek_border csb(fp.ra, fp.dec, fp.radius);
+	return ScanZone(*data, csb, fp.ra, fp.dec, fp.radius, &fp, [&visit](const tycho2_elem& elem) {
+		visit(elem.ra * MAS2D, elem.spd * MAS2D - 90.0, elem.mag * 0.001);
+	});
+}
+///////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
@@ -0,0 +1,173 @@
+/**
+ * @file ACatMmap.h
+ * @brief 内存映射星表: 适用于数亿颗恒星量级的星表(UCAC4, Gaia)
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 文件结构:
+ * - 文件头: catmmap_header
+ * - 一级索引: nZR * nZD条catmmap_zone, 编号 = zd * nZR + zr
+ * - 二级索引: 每个一级天区再划分为nsub * nsub个子天区, 编号 = 一级编号 * nsub^2 + j * nsub + i
+ * - 恒星数据: tycho2_elem. 依一级天区、子天区顺序存储, 子天区内按星等递增排列
+ * @note
+ * 查找时仅访问与搜索范围相交的子天区, 已访问天区的常驻内存受预算约束,
+ * 超出预算时最久未访问的天区被释放
+ */
+
+#ifndef ACATMMAP_H_
+#define ACATMMAP_H_
+
+#include <memory>
+#include <vector>
+#include "ACatTycho2.h"
+
+namespace AstroUtil {
+///////////////////////////////////////////////////////////////////////////////
+#define CATMMAP_MAGIC		"ACATMMP1"	//< 文件标识
+
+struct catmmap_header {///< 内存映射星表文件头
+	char magic[8];			///< 文件标识
+	int step;				///< 一级天区步长, 量纲: 毫角秒
+	int nsub;				///< 一级天区每个方向的子天区数量
+	int nZR;				///< 赤经一级天区数量
+	int nZD;				///< 赤纬一级天区数量
+	unsigned int nstar;		///< 恒星总数
+	int reserved;			///< 保留
+};
+
+struct catmmap_zone {///< 内存映射星表天区索引
+	unsigned int start;		///< 天区第一颗星在恒星数据中的位置
+	unsigned int number;	///< 天区恒星数量
+};
+typedef catmmap_zone* ptr_catmmap_zone;
+
+struct catmmap_data;
+
+/*!
+ * @class ACatMmap
+ * @brief 内存映射星表查找
+ * @note
+ * - 文件映射属于不可变数据, 同一进程内同一星表文件只映射一次, 由全部实例共享
+ * - FindStar(访问接口)可被多个线程并发调用
+ * - 已访问天区记录于共享映射, 全部实例共同计入内存预算. 每个一级天区的记录短暂持有互斥锁
+ * - FindStar(缓存区)与GetResult使用实例内缓存区, 每个线程应使用各自的实例
+ */
+class ACatMmap : public ACatalog {
+public:
+	ACatMmap();
+	ACatMmap(const char *pathdir);
+	virtual ~ACatMmap();
+
+public:
+	/*!
+	 * @brief 检查文件是否内存映射星表
+	 * @param filepath  文件路径
+	 */
+	static bool IsMmapFile(const char *filepath);
+	/*!
+	 * @brief 依据文件格式创建参考星表
+	 * @param filepath  星表文件路径
+	 * @param budget    内存映射星表的常驻内存预算, 量纲: 字节. 0表示不限制
+	 * @param maglim    内存映射星表的星等上限
+	 * @return
+	 * 内存映射格式使用ACatMmap, 其它格式使用ACatTycho2. 由调用者释放
+	 */
+	static ACatalog* Open(const char *filepath, size_t budget, double maglim);
+	/*!
+	 * @brief 设置常驻内存预算
+	 * @param bytes  预算, 量纲: 字节. 0表示不限制
+	 * @note
+	 * 预算约束共享映射的全部已访问天区. 各实例查找时按自身的预算释放天区
+	 */
+	void SetMemoryBudget(size_t bytes);
+	/*!
+	 * @brief 设置星等上限
+	 * @param mag  星等上限. 子天区内按星等排列, 遇到更暗的恒星即停止该子天区的查找
+	 */
+	void SetMagLimit(double mag);
+	/*!
+	 * @brief 查看已访问天区占用的常驻内存
+	 * @return
+	 * 共享映射的全部实例已访问天区的常驻内存, 量纲: 字节
+	 */
+	size_t ResidentBytes() const;
+	/*!
+	 * @brief 查看搜索结果
+	 * @param n 找到的恒星数量
+	 * @return
+	 * 已找到的恒星数据缓存区
+	 */
+	ptr_tycho2_elem GetResult(int &n);
+	/*!
+	 * @brief 设置星表文件路径, 并关联该文件的共享映射
+	 * @param pathdir 星表文件路径
+	 */
+	void SetPathRoot(const char *pathdir);
+	/*!
+	 * @brief 查找中心位置附近的恒星
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角分
+	 * @return
+	 * 若能够找到符合条件的恒星, 则返回true, 否则返回false
+	 */
+	bool FindStar(double ra0, double dec0, double radius);
+	/*!
+	 * @brief 查找中心位置附近的恒星, 并逐颗交由访问接口处理
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角分
+	 * @param visit   访问接口
+	 * @return
+	 * 符合条件的恒星数量. 参数错误或星表不可用时返回-1
+	 * @note
+	 * 不使用结果缓存区, GetResult不反映该次查找. 可被多个线程并发调用
+	 */
+	int FindStar(double ra0, double dec0, double radius, const CatStarVisitor& visit);
+	/*!
+	 * @brief 查找区域内的恒星, 并逐颗交由访问接口处理
+	 * @param fp     查找区域
+	 * @param visit  访问接口
+	 * @return
+	 * 符合条件的恒星数量. 参数错误或星表不可用时返回-1
+	 * @note
+	 * 仅访问与区域相交的子天区. 可被多个线程并发调用
+	 */
+	int FindStar(const cat_footprint& fp, const CatStarVisitor& visit);
+
+protected:
+	/*!
+	 * @brief 获取星表共享映射, 首次访问时映射文件并检查文件头和索引
+	 * @return
+	 * 星表共享映射. 未设置路径或映射失败时返回NULL. 映射失败后不再重试
+	 */
+	const catmmap_data* Map() const;
+	/*!
+	 * @brief 遍历与搜索范围相交的子天区, 将符合条件的恒星交由处理函数
+	 * @param data    星表共享映射
+	 * @param csb     搜索边界
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角度
+	 * @param fp      查找区域. 非空时以区域代替搜索半径筛选子天区和恒星
+	 * @param func    处理函数, 参数为const tycho2_elem&
+	 * @return
+	 * 符合条件的恒星数量
+	 */
+	template <class Func>
+	int ScanZone(const catmmap_data& data, catseek_border csb, double ra0, double dec0, double radius,
+			const cat_footprint* fp, Func&& func);
+
+private:
+	/* 映射 */
+	std::shared_ptr<catmmap_data> m_data;	//< 星表共享映射. 仅在构造和设置路径时改变, 查找时只读
+	/* 查找 */
+	std::vector<tycho2_elem> m_stars;	//< 符合搜索条件的恒星缓存区
+	int m_maglim;				//< 星等上限, 量纲: 毫星等
+	/* 内存预算 */
+	size_t m_budget;			//< 常驻内存预算, 量纲: 字节
+};
+///////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
+
+#endif /* ACATMMAP_H_ */
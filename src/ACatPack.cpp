@@ -0,0 +1,96 @@
+/**
+ * @file ACatPack.cpp
+ * @brief 紧凑星表格式: 天区内差分编码
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <algorithm>
+#include "ACatPack.h"
+
+using std::vector;
+
+namespace AstroUtil {
+///////////////////////////////////////////////////////////////////////////////
+unsigned int catpack_adler32(const unsigned char *data, unsigned int bytes) {
+	unsigned int a(1), b(0);
+	unsigned int i, n;
+
+	while (bytes) {// 分段累加, 避免溢出
+		n = bytes < 5552 ? bytes : 5552;
+		for (i = 0; i < n; ++i) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data  += n;
+		bytes -= n;
+	}
+	return (b << 16) | a;
+}
+
+static void put_varint(unsigned int x, vector<unsigned char> &block) {
+	while (x >= 0x80) {
+		block.push_back((unsigned char) (x | 0x80));
+		x >>= 7;
+	}
+	block.push_back((unsigned char) x);
+}
+
+static bool get_varint(const unsigned char *&ptr, const unsigned char *end, unsigned int &x) {
+	int shift(0);
+
+	x = 0;
+	while (ptr < end && shift < 32) {
+		unsigned char c = *ptr++;
+		x |= (unsigned int) (c & 0x7F) << shift;
+		if (!(c & 0x80)) return true;
+		shift += 7;
+	}
+	return false;
+}
+
+void catpack_encode(ptr_tycho2_elem stars, int n, int ra0, int spd0, vector<unsigned char> &block) {
+	int spd(spd0), mag;
+
+	std::sort(stars, stars + n, [](const tycho2_elem &x1, const tycho2_elem &x2) {
+		return x1.spd < x2.spd;
+	});
+	block.clear();
+	for (int i = 0; i < n; ++i) {
+		unsigned int dra = (unsigned int) (stars[i].ra - ra0);
+		put_varint((unsigned int) (stars[i].spd - spd), block);
+		block.push_back((unsigned char) dra);
+		block.push_back((unsigned char) (dra >> 8));
+		block.push_back((unsigned char) (dra >> 16));
+		put_varint((unsigned int) ((stars[i].pmrac << 1) ^ (stars[i].pmrac >> 15)), block);
+		put_varint((unsigned int) ((stars[i].pmdc  << 1) ^ (stars[i].pmdc  >> 15)), block);
+		mag = (stars[i].mag - CATPACK_MAGMIN + CATPACK_MAGSTEP / 2) / CATPACK_MAGSTEP;
+		if (mag < 0) mag = 0;
+		else if (mag > 255) mag = 255;
+		block.push_back((unsigned char) mag);
+		spd = stars[i].spd;
+	}
+}
+
+bool catpack_decode(const unsigned char *block, unsigned int bytes, int n, int ra0, int spd0, ptr_tycho2_elem stars) {
+	const unsigned char *ptr(block), *end(block + bytes);
+	unsigned int dspd, pmra, pmdc;
+	int spd(spd0);
+
+	for (int i = 0; i < n; ++i) {
+		if (!get_varint(ptr, end, dspd) || end - ptr < 3) return false;
+		spd += (int) dspd;
+		stars[i].spd = spd;
+		stars[i].ra  = ra0 + (ptr[0] | (ptr[1] << 8) | (ptr[2] << 16));
+		ptr += 3;
+		if (!get_varint(ptr, end, pmra) || !get_varint(ptr, end, pmdc) || ptr >= end) return false;
+		stars[i].pmrac = (short) ((pmra >> 1) ^ -(int) (pmra & 1));
+		stars[i].pmdc  = (short) ((pmdc >> 1) ^ -(int) (pmdc & 1));
+		stars[i].mag   = (short) (*ptr++ * CATPACK_MAGSTEP + CATPACK_MAGMIN);
+	}
+	return ptr == end;
+}
+///////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
@@ -0,0 +1,78 @@
+/**
+ * @file ACatPack.h
+ * @brief 紧凑星表格式: 天区内差分编码
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 文件结构:
+ * - 文件头: catpack_header
+ * - 天区索引: nZR * nZD条catpack_zone, 编号 = zd * nZR + zr
+ * - 天区数据块: 天区内恒星按spd递增排列, 每颗星依次为
+ *   1. spd与前一颗星(首颗星: 天区下边界)的差, 无符号变长整数
+ *   2. ra与天区左边界的差, 3字节
+ *   3. pmrac, pmdc, zigzag变长整数
+ *   4. 量化星等, 1字节, 量化步长CATPACK_MAGSTEP毫星等
+ * - 每个数据块记录Adler-32校验和
+ */
+
+#ifndef ACATPACK_H_
+#define ACATPACK_H_
+
+#include <vector>
+#include "ACatTycho2.h"
+
+namespace AstroUtil {
+///////////////////////////////////////////////////////////////////////////////
+#define CATPACK_MAGIC		"ACATPAK1"	//< 文件标识
+#define CATPACK_MAGMIN		-2000		//< 量化星等下限, 量纲: 毫星等
+#define CATPACK_MAGSTEP		70			//< 量化星等步长, 量纲: 毫星等
+
+struct catpack_header {///< 紧凑星表文件头
+	char magic[8];			///< 文件标识
+	int step;				///< 天区步长, 量纲: 毫角秒
+	int nZR;				///< 赤经天区数量
+	int nZD;				///< 赤纬天区数量
+	unsigned int nstar;		///< 恒星总数
+};
+
+struct catpack_zone {///< 紧凑星表天区索引
+	unsigned int offset;	///< 数据块相对数据区起始位置的字节偏移量
+	unsigned int bytes;		///< 数据块字节数
+	unsigned int number;	///< 天区恒星数量
+	unsigned int checksum;	///< 数据块Adler-32校验和
+};
+typedef catpack_zone* ptr_catpack_zone;
+
+/*!
+ * @brief 计算Adler-32校验和
+ * @param data   数据
+ * @param bytes  字节数
+ * @return
+ * 校验和
+ */
+unsigned int catpack_adler32(const unsigned char *data, unsigned int bytes);
+/*!
+ * @brief 编码一个天区
+ * @param stars  天区内恒星. 编码时按spd排序
+ * @param n      恒星数量
+ * @param ra0    天区左边界, 量纲: 毫角秒
+ * @param spd0   天区下边界, 量纲: 毫角秒
+ * @param block  编码后的数据块
+ */
+void catpack_encode(ptr_tycho2_elem stars, int n, int ra0, int spd0, std::vector<unsigned char> &block);
+/*!
+ * @brief 解码一个天区
+ * @param block  数据块
+ * @param bytes  数据块字节数
+ * @param n      恒星数量
+ * @param ra0    天区左边界, 量纲: 毫角秒
+ * @param spd0   天区下边界, 量纲: 毫角秒
+ * @param stars  解码后的恒星, 至少容纳n颗
+ * @return
+ * 数据块完整且解码成功时返回true
+ */
+bool catpack_decode(const unsigned char *block, unsigned int bytes, int n, int ra0, int spd0, ptr_tycho2_elem stars);
+///////////////////////////////////////////////////////////////////////////////
+} /* namespace AstroUtil */
+
+#endif /* ACATPACK_H_ */
@@ -7,160 +7,257 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
 #include <vector>
 #include "ACatTycho2.h"
+#include "ACatPack.h"
 
+using std::string;
 using std::vector;
+using std::mutex;
+using std::shared_ptr;
+using std::weak_ptr;
 
 namespace AstroUtil {
 ///////////////////////////////////////////////////////////////////////////////
+/*!
+ * @struct tycho2_data
+ * @brief 星表不可变数据: 索引与文件句柄
+ * @note
+ * - 进程内按文件路径登记, 同一星表文件的全部实例共享一份数据
+ * - 索引由std::call_once加载一次, 此后只读
+ * - 以pread读取天区数据, 不共享文件位置, 读路径无需加锁
+ */
+struct tycho2_data {
+	string path;					///< 星表文件路径
+	std::once_flag once;			///< 索引加载标记
+	bool ready;						///< 索引加载成功标记
+	int fd;							///< 文件描述符
+	vector<tycho2_asc> asc;			///< 原始格式快速索引
+	vector<catpack_zone> zones;		///< 紧凑格式天区索引. 非空时星表为紧凑格式
+	long offset;					///< 数据区在文件中的字节偏移量
+	int nZR;						///< 赤经天区总数
+	int nZD;						///< 赤纬天区总数
+	int stepR, stepD;				///< 星表中赤经赤纬步长, 量纲: 毫角秒
+
+public:
+	tycho2_data(const char *pathcat)
+		: path(pathcat) {
+		ready  = false;
+		fd     = -1;
+		offset = 0;
+		nZR = nZD = 0;
+		stepR = stepD = 0;
+	}
+
+	~tycho2_data() {
+		if (fd >= 0) close(fd);
+	}
+
+	/*!
+	 * @brief 获取星表文件的共享数据
+	 * @param pathcat  星表文件路径
+	 * @return
+	 * 已登记的共享数据, 或新建并登记的共享数据. 全部实例释放后数据被销毁
+	 */
+	static shared_ptr<tycho2_data> Open(const char *pathcat) {
+		static mutex mtx;
+		static std::map<string, weak_ptr<tycho2_data> > registry;
+
+		std::lock_guard<mutex> lck(mtx);
+		weak_ptr<tycho2_data>& entry = registry[pathcat];
+		shared_ptr<tycho2_data> data = entry.lock();
+		if (!data) {
+			data = std::make_shared<tycho2_data>(pathcat);
+			entry = data;
+		}
+		return data;
+	}
+
+	/*!
+	 * @brief 加载索引. 仅首次调用执行加载
+	 * @return
+	 * 索引可用时返回true
+	 */
+	bool Load() {
+		std::call_once(once, [this]() {
+			ready = load_index();
+		});
+		return ready;
+	}
+
+protected:
+	bool load_index() {
+		if ((fd = open(path.c_str(), O_RDONLY)) < 0) return false;
+
+		catpack_header header;
+		if (pread(fd, &header, sizeof(catpack_header), 0) == (ssize_t) sizeof(catpack_header)
+				&& !memcmp(header.magic, CATPACK_MAGIC, sizeof(header.magic))) {// 紧凑格式
+			stepR = stepD = header.step;
+			nZR   = header.nZR;
+			nZD   = header.nZD;
+			zones.resize(nZR * nZD);
+			offset = sizeof(catpack_header) + zones.size() * sizeof(catpack_zone);
+			ssize_t bytes = zones.size() * sizeof(catpack_zone);
+			return pread(fd, zones.data(), bytes, sizeof(catpack_header)) == bytes;
+		}
+
+		double step = 2.5;
+		stepR = int(MILLIAS * step);
+		stepD = int(MILLIAS * step);
+		nZR   = int(360.001 / step);
+		nZD   = int(180.001 / step);
+		asc.resize(nZR * nZD);
+		offset = asc.size() * sizeof(tycho2_asc);
+		return pread(fd, asc.data(), offset, 0) == (ssize_t) offset;
+	}
+};
+
 ACatTycho2::ACatTycho2()
 	: ACatalog() {
-	m_stars = NULL;
-	m_asc   = NULL;
-	m_nasc  = 0;
-	m_offset= 0;
-	m_nZR   = 0;
-	m_nZD   = 0;
-	m_stepR = 0;
-	m_stepD = 0;
 }
 
 ACatTycho2::ACatTycho2(const char *pathdir)
 	: ACatalog(pathdir) {
-	m_stars = NULL;
-	m_asc   = NULL;
-	m_nasc  = 0;
-	m_offset= 0;
-	m_nZR   = 0;
-	m_nZD   = 0;
-	m_stepR = 0;
-	m_stepD = 0;
+	m_data = tycho2_data::Open(m_pathCat);
 }
 
 ACatTycho2::~ACatTycho2() {
-	if (m_stars) free(m_stars);
-	if (m_asc)   free(m_asc);
 }
 
 ptr_tycho2_elem ACatTycho2::GetResult(int &n) {
 	n = m_nstars;
-	return m_stars;
+	return m_stars.data();
 }
 
-bool ACatTycho2::AllocBuffer(int n) {
-	if (n > m_max) {// 缓存区不足, 重新分配内存
-		m_max = (n + 15) & ~15;	// 条目数为16整数倍
-		if (m_stars) {
-			free(m_stars);
-			m_stars = NULL;
-		}
-	}
-	if ((m_nstars = n) > 0 && m_stars == NULL)
-		m_stars = (ptr_tycho2_elem) calloc(m_max, sizeof(tycho2_elem));
-
-	return (m_stars != NULL);
+void ACatTycho2::SetPathRoot(const char *pathdir) {
+	ACatalog::SetPathRoot(pathdir);
+	m_data = tycho2_data::Open(m_pathCat);
 }
 
-double ACatTycho2::SphereRange(double alpha1, double beta1, double alpha2, double beta2)
+double ACatTycho2::SphereRange(double alpha1, double beta1, double alpha2, double beta2) const
 {
 	double v = cos(beta1) * cos(beta2) * cos(alpha1 - alpha2) + sin(beta1) * sin(beta2);
 	return acos(v);
 }
 
-bool ACatTycho2::LoadAsc() {
-	if (m_asc) return true;
-	double step = 2.5;
-	m_stepR = int(MILLIAS * step);
-	m_stepD = int(MILLIAS * step);
-	m_nZR   = int(360.001 / step);
-	m_nZD   = int(180.001 / step);
-	m_nasc  = m_nZR * m_nZD;
-	m_offset = m_nasc * sizeof(tycho2_asc);
-	m_asc = (ptr_tycho2asc) calloc(m_nasc, sizeof(tycho2_asc));
-	if (m_asc == NULL) return false;
-
-	if (access(m_pathCat, 0)) {
-		free (m_asc);
-		m_asc = NULL;
-		return false;
-	}
-	// 打开文件
-	FILE *fp = fopen(m_pathCat, "rb");
-	if (fp == NULL) {
-		free (m_asc);
-		m_asc = NULL;
-		return false;
-	}
-	// 提取文件内容
-	fread(m_asc, sizeof(tycho2_asc), m_nasc, fp);
-	fclose(fp);
-
-	return true;
+const tycho2_data* ACatTycho2::LoadAsc() const {
+	return m_data && m_data->Load() ? m_data.get() : NULL;
 }
 
-bool ACatTycho2::FindStar(double ra0, double dec0, double radius) {
-	if (!(ACatalog::FindStar(ra0, dec0, radius) && LoadAsc()))
-		return false;
-
-	vector<tycho2_elem> vecrslt;	// 查找到条目的临时缓存区
-	int n;
+template <class Func>
+int ACatTycho2::ScanZone(const tycho2_data& data, catseek_border csb, double ra0, double dec0, double radius,
+		const cat_footprint* fp, Func&& func) const {
+	csb.zone_seek(data.stepR, data.stepD);
 
-	m_csb.zone_seek(m_stepR, m_stepD);
-
-	ra0 *= D2R;		// 量纲转换, 为后续工作准备
-	dec0 *= D2R;
-	radius = radius * D2R / 60.0;
 	// 遍历星表, 查找符合条件的条目
 	int zr, zd;		// 赤经赤纬天区编号
 	int ZC, ZC0;	// 在索引区中的编号
 	double ra, de;	// 星表赤经赤纬
 	unsigned int start, number;	// 天区中第一颗星在数据文件中的位置, 和该天区的星数
-	FILE *fp = fopen(m_pathCat, "rb");					// 主数据文件访问句柄
-	ptr_tycho2_elem buff = NULL;		// 星表数据临时存放地址
-	int nelem = 0;					// 星表数据临时存放参考星条目数
+	vector<tycho2_elem> buff;		// 星表数据临时存放地址
 	int bytes = (int) sizeof(tycho2_elem);
+	bool packed = !data.zones.empty();
+	vector<unsigned char> block;	// 紧凑格式数据块
+	int n(0);
 
-	for (zd = m_csb.zdmin; zd <= m_csb.zdmax; ++zd) {// 遍历赤纬
-		ZC0 = zd * m_nZR;
-		for (zr = m_csb.zrmin; zr <= m_csb.zrmax; ++zr) {// 遍历赤经
-			ZC = ZC0 + (zr % m_nZR);
-			start = m_asc[ZC].start;
-			number= m_asc[ZC].number;
+	for (zd = csb.zdmin; zd <= csb.zdmax; ++zd) {// 遍历赤纬
+		ZC0 = zd * data.nZR;
+		for (zr = csb.zrmin; zr <= csb.zrmax; ++zr) {// 遍历赤经
+			ZC = ZC0 + (zr % data.nZR);
+			if (packed) {
+				start = data.zones[ZC].offset;
+				number= data.zones[ZC].number;
+			}
+			else {
+				start = data.asc[ZC].start;
+				number= data.asc[ZC].number;
+			}
 			if (number == 0) continue;
+			// 与查找区域不相交的天区不读取
+			if (fp && !fp->Overlap(zr * data.stepR * MAS2D, (zr + 1) * data.stepR * MAS2D,
+					zd * data.stepD * MAS2D - 90.0, (zd + 1) * data.stepD * MAS2D - 90.0))
+				continue;
 			// 为天区数据分配内存
-			if (nelem < ((number + 15) & ~15)) {
-				free(buff);
-				buff = NULL;
-				nelem = (number + 15) & ~15;
-			}
-			if (buff == NULL) buff = (ptr_tycho2_elem) calloc(nelem, sizeof(tycho2_elem));
-			if (buff == NULL) break;
+			if (buff.size() < number) buff.resize(number);
 			// 加载天区数据
-			fseek(fp, bytes * start + m_offset, SEEK_SET);
-			fread(buff, bytes, number, fp);
+			if (packed) {
+				const catpack_zone& zone = data.zones[ZC];
+				block.resize(zone.bytes);
+				if (pread(data.fd, block.data(), zone.bytes, data.offset + start) != (ssize_t) zone.bytes
+						|| catpack_adler32(block.data(), zone.bytes) != zone.checksum
+						|| !catpack_decode(block.data(), zone.bytes, number,
+								(zr % data.nZR) * data.stepR, zd * data.stepD, buff.data()))
+					continue;
+			}
+			else if (pread(data.fd, buff.data(), (size_t) bytes * number, data.offset + (long) bytes * start)
+					!= (ssize_t) bytes * number)
+				continue;
 			// 遍历参考星, 检查是否符合查找条件
 			for (unsigned int i = 0; i < number; ++i) {
 				ra = (double) buff[i].ra / MILLIAS * D2R;
 				de = ((double) buff[i].spd / MILLIAS - 90) * D2R;
-				double v = SphereRange(ra0, dec0, ra, de);
-				if (v > radius) continue;
-				vecrslt.push_back(*(buff + i));
+				if (fp) {
+					if (!fp->Contains(ra * R2D, de * R2D)) continue;
+				}
+				else if (SphereRange(ra0, dec0, ra, de) > radius) continue;
+				func(buff[i]);
+				++n;
 			}
 		}
 	}
-	fclose(fp);
-	if (buff) free(buff);
+	return n;
+}
+
+bool ACatTycho2::FindStar(double ra0, double dec0, double radius) {
+	const tycho2_data* data;
+	if (!(ACatalog::FindStar(ra0, dec0, radius) && (data = LoadAsc())))
+		return false;
 
-	// 将查找到的条目存入固定缓存区
-	n = (int) vecrslt.size();
-	if (AllocBuffer(n)) {
-		memcpy(m_stars, vecrslt.data(), n * sizeof(tycho2_elem));
+	// 符合条件的条目直接写入缓存区. 缓存区保留容量, 内存不足时查找失败
+	m_stars.clear();
+	try {
+		ScanZone(*data, m_csb, ra0 * D2R, dec0 * D2R, radius * D2R / 60.0, NULL, [this](const tycho2_elem& elem) {
+			m_stars.push_back(elem);
+		});
+	}
+	catch (std::bad_alloc&) {
+		m_stars.clear();
 	}
-	vecrslt.clear();
+	m_nstars = m_stars.size();
+	m_max    = m_stars.capacity();
 	return (m_nstars > 0);
 }
 
+int ACatTycho2::FindStar(double ra0, double dec0, double radius, const CatStarVisitor& visit) {
+	const tycho2_data* data;
+	if (!(ValidSeek(ra0, dec0, radius) && (data = LoadAsc())))
+		return -1;
+
+	// 搜索边界为局部变量, 不修改实例状态
+	catseek_border csb(ra0, dec0, radius / 60.0);
+	return ScanZone(*data, csb, ra0 * D2R, dec0 * D2R, radius * D2R / 60.0, NULL, [&visit](const tycho2_elem& elem) {
+		visit(elem.ra * MAS2D, elem.spd * MAS2D - 90.0, elem.mag * 0.001);
+	});
+}
+
+int ACatTycho2::FindStar(const cat_footprint& fp, const CatStarVisitor& visit) {
+	const tycho2_data* data;
+	double radius = fp.radius * 60.0;
+	if (!(ValidSeek(fp.ra, fp.dec, radius) && (data = LoadAsc())))
+		return -1;
+
+	catseek_border csb(fp.ra, fp.dec, fp.radius);
+	return ScanZone(*data, csb, fp.ra * D2R, fp.dec * D2R, fp.radius * D2R, &fp, [&visit](const tycho2_elem& elem) {
+		visit(elem.ra * MAS2D, elem.spd * MAS2D - 90.0, elem.mag * 0.001);
+	});
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 } /* namespace AstroUtil */
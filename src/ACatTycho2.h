@@ -8,6 +8,8 @@
 #ifndef ACATTYCHO2_H_
 #define ACATTYCHO2_H_
 
+#include <memory>
+#include <vector>
 #include "ACatalog.h"
 
 namespace AstroUtil {
@@ -20,7 +22,7 @@ struct tycho2_elem {
     short   mag;	// 星等, 量纲: millimag
 
 public:
-    tycho2_elem& operator=(tycho2_elem &other) {
+    tycho2_elem& operator=(const tycho2_elem &other) {
     	if (this != &other) memcpy(this, &other, sizeof(tycho2_elem));
     	return *this;
     }
@@ -33,6 +35,16 @@ struct tycho2_asc {///< UCAC4星表索引
 };
 typedef tycho2_asc* ptr_tycho2asc;
 
+struct tycho2_data;
+
+/*!
+ * @class ACatTycho2
+ * @brief Tycho2星表查找
+ * @note
+ * - 索引和文件句柄属于不可变数据, 同一进程内同一星表文件只加载一次, 由全部实例共享
+ * - FindStar(访问接口)不修改实例状态, 多个线程可并发使用同一实例, 读路径无锁
+ * - FindStar(缓存区)与GetResult使用实例内缓存区, 每个线程应使用各自的实例
+ */
 class ACatTycho2 : public ACatalog {
 public:
 	ACatTycho2();
@@ -47,6 +59,11 @@ public:
 	 * 已找到的恒星数据缓存区
 	 */
 	ptr_tycho2_elem GetResult(int &n);
+	/*!
+	 * @brief 设置星表文件路径, 并关联该文件的共享数据
+	 * @param pathdir 星表文件路径
+	 */
+	void SetPathRoot(const char *pathdir);
 	/*!
 	 * @brief 查找中心位置附近的恒星
 	 * @param ra0     中心赤经, 量纲: 角度
@@ -56,21 +73,38 @@ public:
 	 * 若能够找到符合条件的恒星, 则返回true, 否则返回false
 	 */
 	bool FindStar(double ra0, double dec0, double radius);
-
-protected:
 	/*!
-	 * @brief 为最近一次搜索结果分配缓存区
-	 * @param n 搜索结果的条目数
+	 * @brief 查找中心位置附近的恒星, 并逐颗交由访问接口处理
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角分
+	 * @param visit   访问接口
+	 * @return
+	 * 符合条件的恒星数量. 参数错误或星表不可用时返回-1
+	 * @note
+	 * 不使用结果缓存区, GetResult不反映该次查找. 可被多个线程并发调用
+	 */
+	int FindStar(double ra0, double dec0, double radius, const CatStarVisitor& visit);
+	/*!
+	 * @brief 查找区域内的恒星, 并逐颗交由访问接口处理
+	 * @param fp     查找区域
+	 * @param visit  访问接口
 	 * @return
-	 * 操作成功标记. true: 成功; false: 失败
+	 * 符合条件的恒星数量. 参数错误或星表不可用时返回-1
+	 * @note
+	 * 与区域不相交的天区不读取. 可被多个线程并发调用
 	 */
-	bool AllocBuffer(int n);
+	int FindStar(const cat_footprint& fp, const CatStarVisitor& visit);
+
+protected:
 	/*!
-	 * @brief 加载星表快速索引
+	 * @brief 获取星表共享数据, 首次访问时加载索引
 	 * @return
-	 * 若加载成功返回true, 否则返回false
+	 * 星表共享数据. 未设置路径或加载失败时返回NULL. 加载失败后不再重试
+	 * @note
+	 * 依据文件标识识别紧凑格式(ACatPack.h), 否则按原始格式加载
 	 */
-	bool LoadAsc();
+	const tycho2_data* LoadAsc() const;
 	/*!
 	 * \brief 计算球上两点之间的距离
 	 * \param[in] alpha1   位置1的alpha位置, 量纲: 弧度
@@ -80,16 +114,28 @@ protected:
 	 * \return
 	 * 两点在球上的距离, 量纲: 弧度
 	 **/
-	double SphereRange(double alpha1, double beta1, double alpha2, double beta2);
+	double SphereRange(double alpha1, double beta1, double alpha2, double beta2) const;
+	/*!
+	 * @brief 遍历搜索边界内的天区, 将符合条件的恒星交由处理函数
+	 * @note
+	 * 紧凑格式天区先校验再解码, 校验失败的天区被跳过
+	 * @param data    星表共享数据
+	 * @param csb     搜索边界
+	 * @param ra0     中心赤经, 量纲: 弧度
+	 * @param dec0    中心赤纬, 量纲: 弧度
+	 * @param radius  搜索半径, 量纲: 弧度
+	 * @param fp      查找区域. 非空时以区域代替搜索半径筛选天区和恒星
+	 * @param func    处理函数, 参数为const tycho2_elem&
+	 * @return
+	 * 符合条件的恒星数量
+	 */
+	template <class Func>
+	int ScanZone(const tycho2_data& data, catseek_border csb, double ra0, double dec0, double radius,
+			const cat_footprint* fp, Func&& func) const;
 
 private:
-	ptr_tycho2_elem m_stars;		//< 符合搜索条件的恒星缓存区
-	ptr_tycho2asc m_asc;			//< 快速索引记录
-	int m_nasc;					//< 快速索引记录条目数
-	int m_offset;				//< 索引和数据在一个文件中, 数据前的字节偏移量
-	int m_nZR;	//< 赤经天区总数
-	int m_nZD;	//< 赤纬天区总数
-	int m_stepR, m_stepD;		//< 星表中赤经赤纬步长, 量纲: 毫角秒/度
+	std::vector<tycho2_elem> m_stars;	//< 符合搜索条件的恒星缓存区
+	std::shared_ptr<tycho2_data> m_data;	//< 星表共享数据. 仅在构造和设置路径时改变, 查找时只读
 };
 ///////////////////////////////////////////////////////////////////////////////
 } /* namespace AstroUtil */
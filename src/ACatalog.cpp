@@ -5,8 +5,12 @@
  *      Author: lxm
  */
 
+#include <cmath>
+#include <algorithm>
 #include "ACatalog.h"
 
+using std::vector;
+
 namespace AstroUtil {
 ///////////////////////////////////////////////////////////////////////////////
 ACatalog::ACatalog() {
@@ -28,11 +32,191 @@ void ACatalog::SetPathRoot(const char *pathdir) {
 	strcpy(m_pathCat, pathdir);
 }
 
+bool ACatalog::ValidSeek(double ra0, double dec0, double radius) const {
+	return !(ra0 < 0 || ra0 > 360 || dec0 < -90 || dec0 > 90 || radius < 0.001);
+}
+
 bool ACatalog::FindStar(double ra0, double dec0, double radius) {
-	if (ra0 < 0 || ra0 > 360 || dec0 < -90 || dec0 > 90 || radius < 0.001)
-		return false;
+	if (!ValidSeek(ra0, dec0, radius)) return false;
 	m_csb.new_seek(ra0, dec0, radius / 60.0);	// 计算搜索范围
 	return true;
 }
+
+int ACatalog::FindStar(double ra0, double dec0, double radius, const CatStarVisitor& visit) {
+	return ValidSeek(ra0, dec0, radius) ? 0 : -1;
+}
+
+int ACatalog::FindStar(const cat_footprint& fp, const CatStarVisitor& visit) {
+	int n(0);
+	int rslt = FindStar(fp.ra, fp.dec, fp.radius * 60.0, [&fp, &visit, &n](double ra, double dec, double mag) {
+		if (fp.Contains(ra, dec)) {
+			visit(ra, dec, mag);
+			++n;
+		}
+	});
+	return rslt < 0 ? rslt : n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* 查找区域 */
+void cat_footprint::SetCircle(double ra0, double dec0, double r) {
+	ra     = ra0;
+	dec    = dec0;
+	radius = r / 60.0;
+	sd0_   = sin(dec0 * D2R);
+	cd0_   = cos(dec0 * D2R);
+	xi.clear();
+	eta.clear();
+}
+
+void cat_footprint::SetRect(double ra0, double dec0, double w, double h, double rotation, double margin) {
+	double cr(cos(rotation * D2R)), sr(sin(rotation * D2R));
+	double x[4], y[4], u, v;
+
+	for (int i = 0; i < 4; ++i) {
+		u = (i == 1 || i == 2 ? 0.5 : -0.5) * w;
+		v = (i >= 2 ? 0.5 : -0.5) * h;
+		x[i] = u * cr - v * sr;
+		y[i] = u * sr + v * cr;
+	}
+	SetPolygon(ra0, dec0, x, y, 4, margin);
+}
+
+void cat_footprint::SetPolygon(double ra0, double dec0, const double *x, const double *y, int n, double margin) {
+	vector<double> px, py;
+	double r, a, m(fabs(margin) * D2R);
+
+	SetCircle(ra0, dec0, 0.0);
+	for (int i = 0; i < n; ++i) {
+		r = sqrt(x[i] * x[i] + y[i] * y[i]) / 60.0 * D2R;
+		a = atan2(y[i], x[i]);
+		if (m <= 0.0) {
+			px.push_back(r * cos(a));
+			py.push_back(r * sin(a));
+			continue;
+		}
+		// 转动圆弧[a - m, a + m]: 两个端点, 及端点与中点处切线的两个交点
+		double rt = m < API * 0.5 ? r / cos(m * 0.5) : r;
+		px.push_back(r * cos(a - m));
+		py.push_back(r * sin(a - m));
+		px.push_back(r * cos(a + m));
+		py.push_back(r * sin(a + m));
+		px.push_back(rt * cos(a - m * 0.5));
+		py.push_back(rt * sin(a - m * 0.5));
+		px.push_back(rt * cos(a + m * 0.5));
+		py.push_back(rt * sin(a + m * 0.5));
+	}
+	build_hull(px, py);
+	if (m >= API * 0.5) {// 退化为外接圆
+		xi.clear();
+		eta.clear();
+	}
+}
+
+void cat_footprint::build_hull(vector<double> &x, vector<double> &y) {
+	int n(x.size()), i, k(0), lower;
+	vector<int> ids(n), hull(2 * n + 1);
+
+	for (i = 0; i < n; ++i) ids[i] = i;
+	std::sort(ids.begin(), ids.end(), [&x, &y](int i1, int i2) {
+		return x[i1] < x[i2] || (x[i1] == x[i2] && y[i1] < y[i2]);
+	});
+	// 单调链: 下凸包与上凸包, 逆时针排列
+	auto cross = [&x, &y](int o, int a, int b) {
+		return (x[a] - x[o]) * (y[b] - y[o]) - (y[a] - y[o]) * (x[b] - x[o]);
+	};
+	for (i = 0; i < n; ++i) {
+		while (k >= 2 && cross(hull[k - 2], hull[k - 1], ids[i]) <= 0.0) --k;
+		hull[k++] = ids[i];
+	}
+	for (i = n - 2, lower = k + 1; i >= 0; --i) {
+		while (k >= lower && cross(hull[k - 2], hull[k - 1], ids[i]) <= 0.0) --k;
+		hull[k++] = ids[i];
+	}
+	if (k > 1) --k;	// 末点与起点重合
+
+	double r2(0.0), d2;
+	xi.resize(k);
+	eta.resize(k);
+	for (i = 0; i < k; ++i) {
+		xi[i]  = x[hull[i]];
+		eta[i] = y[hull[i]];
+		if ((d2 = xi[i] * xi[i] + eta[i] * eta[i]) > r2) r2 = d2;
+	}
+	radius = atan(sqrt(r2)) * R2D;
+}
+
+bool cat_footprint::project(double ra1, double dec1, double &x, double &y) const {
+	double dra = (ra1 - ra) * D2R;
+	double sd(sin(dec1 * D2R)), cd(cos(dec1 * D2R)), cdra(cos(dra));
+	double cosc = sd * sd0_ + cd * cd0_ * cdra;
+
+	if (cosc <= 0.0) return false;
+	x = cd * sin(dra) / cosc;
+	y = (sd * cd0_ - cd * sd0_ * cdra) / cosc;
+	return true;
+}
+
+bool cat_footprint::Contains(double ra1, double dec1) const {
+	if (xi.size() < 3) {// 外接圆
+		double dra = (ra1 - ra) * D2R;
+		return sin(dec1 * D2R) * sd0_ + cos(dec1 * D2R) * cd0_ * cos(dra) >= cos(radius * D2R);
+	}
+	double x, y;
+	if (!project(ra1, dec1, x, y)) return false;
+	for (int i = 0, n = xi.size(), j = n - 1; i < n; j = i++) {
+		if ((xi[i] - xi[j]) * (y - eta[j]) - (eta[i] - eta[j]) * (x - xi[j]) < 0.0) return false;
+	}
+	return true;
+}
+
+bool cat_footprint::Overlap(double ra1, double ra2, double dec1, double dec2) const {
+	/* 天区外接圆: 中心取赤经和赤纬中点, 半径取中心至角点和边中点的最大角距 */
+	double rc((ra1 + ra2) * 0.5), dc((dec1 + dec2) * 0.5);
+	double sdc(sin(dc * D2R)), cdc(cos(dc * D2R)), cosr(1.0), v;
+	double ras[] = { ra1, rc, ra2 }, decs[] = { dec1, dc, dec2 };
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			v = sin(decs[j] * D2R) * sdc + cos(decs[j] * D2R) * cdc * cos((ras[i] - rc) * D2R);
+			if (v < cosr) cosr = v;
+		}
+	}
+	double r = acos(cosr > 1.0 ? 1.0 : cosr) * 1.01;
+	/* 外接圆之间的角距 */
+	v = sdc * sd0_ + cdc * cd0_ * cos((rc - ra) * D2R);
+	double d = acos(v > 1.0 ? 1.0 : (v < -1.0 ? -1.0 : v));
+	if (d > radius * D2R + r) return false;
+	if (xi.size() < 3) return true;
+
+	/* 天区外接圆在切平面上的投影被半径方向的最大放大率覆盖 */
+	double x, y;
+	if (d + r >= API * 0.4 || !project(rc, dc, x, y)) return true;
+	double c = cos(d + r), rp = r / (c * c);
+	bool inside(true);
+	for (int i = 0, n = xi.size(), j = n - 1; i < n; j = i++) {
+		double ex(xi[i] - xi[j]), ey(eta[i] - eta[j]);
+		double px(x - xi[j]), py(y - eta[j]);
+		double len2 = ex * ex + ey * ey;
+		if (ex * py - ey * px < 0.0) inside = false;
+		// 圆心至边的距离
+		double t = len2 > 0.0 ? (px * ex + py * ey) / len2 : 0.0;
+		if (t < 0.0) t = 0.0;
+		else if (t > 1.0) t = 1.0;
+		double dx(px - t * ex), dy(py - t * ey);
+		if (dx * dx + dy * dy <= rp * rp) return true;
+	}
+	return inside;
+}
+
+double cat_footprint::Area() const {
+	if (xi.size() < 3) {
+		double r = tan(radius * D2R);
+		return API * r * r;
+	}
+	double area(0.0);
+	for (int i = 0, n = xi.size(), j = n - 1; i < n; j = i++)
+		area += xi[j] * eta[i] - xi[i] * eta[j];
+	return area * 0.5;
+}
 ///////////////////////////////////////////////////////////////////////////////
 } /* namespace AstroUtil */
@@ -9,6 +9,8 @@
 #define ACATALOG_H_
 
 #include <string.h>
+#include <vector>
+#include <functional>
 #include "ADefine.h"
 
 namespace AstroUtil {
@@ -65,6 +67,108 @@ public:
 	}
 };
 
+/*!
+ * @brief 查找结果访问接口: 每找到一颗符合条件的恒星调用一次
+ * @param ra   赤经, J2000, 量纲: 角度
+ * @param dec  赤纬, J2000, 量纲: 角度
+ * @param mag  星等
+ * @note
+ * 恒星直接写入调用者的缓存区, 星表内部不再保存查找结果
+ */
+typedef std::function<void(double ra, double dec, double mag)> CatStarVisitor;
+
+struct cat_star {///< 查找结果中的恒星
+	double ra;		///< 赤经, J2000, 量纲: 角度
+	double dec;		///< 赤纬, J2000, 量纲: 角度
+	double mag;		///< 星等
+};
+typedef std::vector<cat_star> CatStarVec;
+
+/*!
+ * @struct cat_footprint
+ * @brief 查找区域: 以中心为切点的切平面上的凸多边形
+ * @note
+ * - 顶点为理想坐标(xi, eta), 量纲: 弧度. xi指向赤经增加方向, eta指向北
+ * - 旋转角不确定时, 多边形在±margin内绕中心旋转扫过的区域以凸包覆盖:
+ *   每个顶点以其转动圆弧的两个端点和圆弧切线的交点代替. margin不小于90度时退化为外接圆
+ * - 查找时仅访问与多边形相交的天区, 天区以其外接圆与多边形作相交检验
+ */
+struct cat_footprint {
+	double ra, dec;		///< 中心, 量纲: 角度
+	double radius;		///< 外接圆半径, 量纲: 角度
+	std::vector<double> xi, eta;	///< 凸多边形顶点, 逆时针排列, 量纲: 弧度. 为空时为外接圆
+
+public:
+	cat_footprint() {
+		ra = dec = radius = 0.0;
+		sd0_ = 0.0;
+		cd0_ = 1.0;
+	}
+	/*!
+	 * @brief 设置圆形区域
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param r       半径, 量纲: 角分
+	 */
+	void SetCircle(double ra0, double dec0, double r);
+	/*!
+	 * @brief 设置矩形区域
+	 * @param ra0       中心赤经, 量纲: 角度
+	 * @param dec0      中心赤纬, 量纲: 角度
+	 * @param w         宽度, 量纲: 角分
+	 * @param h         高度, 量纲: 角分
+	 * @param rotation  宽度方向相对xi轴的旋转角, 量纲: 角度
+	 * @param margin    旋转角的不确定度, 量纲: 角度
+	 */
+	void SetRect(double ra0, double dec0, double w, double h, double rotation, double margin);
+	/*!
+	 * @brief 设置凸多边形区域
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param x       顶点理想坐标xi, 量纲: 角分
+	 * @param y       顶点理想坐标eta, 量纲: 角分
+	 * @param n       顶点数量. 顶点顺序不限, 以其凸包为区域
+	 * @param margin  旋转角的不确定度, 量纲: 角度
+	 */
+	void SetPolygon(double ra0, double dec0, const double *x, const double *y, int n, double margin);
+	/*!
+	 * @brief 检查位置是否在区域内
+	 * @param ra   赤经, 量纲: 角度
+	 * @param dec  赤纬, 量纲: 角度
+	 */
+	bool Contains(double ra, double dec) const;
+	/*!
+	 * @brief 检查天区是否可能与区域相交
+	 * @param ra1   天区赤经下限, 量纲: 角度. 可大于360
+	 * @param ra2   天区赤经上限, 量纲: 角度
+	 * @param dec1  天区赤纬下限, 量纲: 角度
+	 * @param dec2  天区赤纬上限, 量纲: 角度
+	 * @return
+	 * 天区外接圆与区域相交时返回true. 不会遗漏相交的天区
+	 */
+	bool Overlap(double ra1, double ra2, double dec1, double dec2) const;
+	/*!
+	 * @brief 计算区域面积
+	 * @return
+	 * 切平面上的面积, 量纲: 平方弧度
+	 */
+	double Area() const;
+
+protected:
+	double sd0_, cd0_;	//< 中心赤纬的正弦和余弦
+
+	/*!
+	 * @brief 球面位置投影至切平面
+	 * @return
+	 * 位置在切点所在半球时返回true
+	 */
+	bool project(double ra1, double dec1, double &x, double &y) const;
+	/*!
+	 * @brief 由候选顶点建立凸包, 并计算外接圆半径
+	 */
+	void build_hull(std::vector<double> &x, std::vector<double> &y);
+};
+
 class ACatalog {
 public:
 	ACatalog();
@@ -75,8 +179,10 @@ public:
 	/*!
 	 * @brief 设置星表文件存储路径
 	 * @param pathdir 存储星表文件的目录名
+	 * @note
+	 * 不可与查找并发调用
 	 */
-	void SetPathRoot(const char *pathdir);
+	virtual void SetPathRoot(const char *pathdir);
 	/*!
 	 * @brief 查找中心位置附近的恒星
 	 * @param ra0     中心赤经, 量纲: 角度
@@ -86,8 +192,38 @@ public:
 	 * 若能够找到符合条件的恒星, 则返回true, 否则返回false
 	 */
 	virtual bool FindStar(double ra0, double dec0, double radius);
+	/*!
+	 * @brief 查找中心位置附近的恒星, 并逐颗交由访问接口处理
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角分
+	 * @param visit   访问接口
+	 * @return
+	 * 符合条件的恒星数量. 参数错误或星表不可用时返回-1
+	 */
+	virtual int FindStar(double ra0, double dec0, double radius, const CatStarVisitor& visit);
+	/*!
+	 * @brief 查找区域内的恒星, 并逐颗交由访问接口处理
+	 * @param fp     查找区域
+	 * @param visit  访问接口
+	 * @return
+	 * 符合条件的恒星数量. 参数错误或星表不可用时返回-1
+	 * @note
+	 * 缺省实现在外接圆内查找后逐颗筛选. 派生类仅访问与区域相交的天区
+	 */
+	virtual int FindStar(const cat_footprint& fp, const CatStarVisitor& visit);
 
 protected:
+	/*!
+	 * @brief 检查查找条件是否有效
+	 * @param ra0     中心赤经, 量纲: 角度
+	 * @param dec0    中心赤纬, 量纲: 角度
+	 * @param radius  搜索半径, 量纲: 角分
+	 * @return
+	 * 查找条件有效时返回true. 不修改实例状态
+	 */
+	bool ValidSeek(double ra0, double dec0, double radius) const;
+
 	char m_pathCat[300];		//< 星表文件存储目录
 	int m_nstars;				//< 找到的符合条件的恒星数量
 	int m_max;					//< 缓存区可容纳的最大恒星数量
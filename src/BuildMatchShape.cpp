@@ -0,0 +1,127 @@
+/**
+ * @file BuildMatchShape.cpp
+ * @brief 创建匹配模型
+ * @version 0.1
+ * @date 2020-11-02
+ * @author 卢晓猛
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "ADefine.h"
+#include "BuildMatchShape.h"
+
+template <typename T>
+BuildMatchShape<T>::BuildMatchShape() {
+	angle_ = T(60);
+	pts_ = NULL;
+	len_low_ = T(0);
+	dmag_ = T(0);
+	idc_ = npolar_ = korient_ = 0;
+	lo_ = hi_ = 0;
+}
+
+template <typename T>
+BuildMatchShape<T>::~BuildMatchShape() {
+
+}
+
+template <typename T>
+void BuildMatchShape<T>::SetAngle(T angle) {
+	angle_ = angle;
+}
+
+template <typename T>
+int BuildMatchShape<T>::build_polar(const PtMSVec<T>& pts, int idc, T len_low) {
+	int n(pts.size()), id;
+	T low2 = len_low * len_low;
+	T xc(pts[idc].x), yc(pts[idc].y);
+	T dx, dy, len;
+	polar_point pt;
+
+	polars_.clear();
+	for (id = 0; id < n; ++id) {
+		if (id == idc) continue;
+		dx = pts[id].x - xc;
+		dy = pts[id].y - yc;
+		if ((len = dx * dx + dy * dy) < low2) continue;
+		pt.id   = id;
+		pt.len  = std::sqrt(len);
+		pt.incl = std::atan2(dy, dx) * T(R2D);
+		polars_.push_back(pt);
+	}
+	std::sort(polars_.begin(), polars_.end(), [](const polar_point& pt1, const polar_point& pt2) {
+		return pt1.incl < pt2.incl;
+	});
+	return polars_.size();
+}
+
+template <typename T>
+int BuildMatchShape<T>::Build(const PtMSVec<T>& pts, T len_low, MatchShapeVec<T>& shapes, T dmag) {
+	Begin(pts, len_low, dmag);
+	return Next(shapes, 0);
+}
+
+template <typename T>
+void BuildMatchShape<T>::Begin(const PtMSVec<T>& pts, T len_low, T dmag) {
+	pts_     = &pts;
+	len_low_ = len_low;
+	dmag_    = dmag;
+	idc_     = -1;
+	npolar_  = korient_ = 0;
+	lo_ = hi_ = 0;
+}
+
+template <typename T>
+int BuildMatchShape<T>::Next(MatchShapeVec<T>& shapes, size_t budget) {
+	if (!pts_) return 0;
+	int n(pts_->size()), m(npolar_), count(0);
+	size_t bytes(0);
+	T half = angle_ * T(0.5);
+
+	// 展开索引: 序号e对应样本polars_[e % m], 倾角增加360*(e / m - 1)
+	auto incl_ext = [&](int e) {
+		return polars_[e % m].incl + T(360) * (e / m - 1);
+	};
+
+	while (idc_ < n) {
+		if (korient_ >= m) {// 下一个中心
+			if (++idc_ >= n) break;
+			m = npolar_ = build_polar(*pts_, idc_, len_low_);
+			korient_ = m < 3 ? m : 0;
+			lo_ = hi_ = 0;
+			continue;
+		}
+		const polar_point& orient = polars_[korient_++];
+		// 指向ID大于中心ID. 亮度相近时另构建反向模型
+		if (orient.id < idc_ && !(dmag_ > T(0) && std::fabs((*pts_)[orient.id].z - (*pts_)[idc_].z) <= dmag_))
+			continue;
+		// 滑动窗口: 指向倾角递增, 窗口边界单调递增
+		T incl_lo(orient.incl - half), incl_hi(orient.incl + half);
+		while (incl_ext(lo_) < incl_lo) ++lo_;
+		if (hi_ < lo_) hi_ = lo_;
+		while (hi_ < 3 * m && incl_ext(hi_) <= incl_hi) ++hi_;
+		if (hi_ - lo_ < 3) continue;	// 除指向外至少2个样本
+
+		if (count == int(shapes.size())) shapes.resize(count + 1);
+		MatchShape<T>& shape = shapes[count];
+		shape.Reset();
+		shape.idc  = idc_;
+		shape.ido  = orient.id;
+		shape.len  = orient.len;
+		shape.incl = orient.incl;
+		for (int e = lo_; e < hi_; ++e) {
+			const polar_point& pt = polars_[e % m];
+			if (pt.id != orient.id) shape.AddPoint(pt.id, pt.len, pt.incl);
+		}
+		++count;
+		bytes += sizeof(MatchShape<T>) + shape.Count() * (sizeof(int) + 2 * sizeof(T));
+		if (budget && bytes >= budget) break;
+	}
+	if (idc_ >= n) pts_ = NULL;
+	return count;
+}
+
+/* 实例: 单精度与双精度 */
+template class BuildMatchShape<float>;
+template class BuildMatchShape<double>;
@@ -4,6 +4,17 @@
  * @version 0.1
  * @date 2020-11-02
  * @author 卢晓猛
+ * @note
+ * 以每个样本为中心建立极坐标索引: 其它样本按相对中心的倾角排序.
+ * 对每个指向, 楔形内的样本在索引中是连续区间, 随指向倾角递增单调滑动,
+ * 因此无需为每对(中心, 指向)遍历全部样本. 构建耗时约为O(n^2·logn)+输出规模
+ * @note
+ * 分块构建: Begin后反复调用Next, 每次输出不超过内存预算的一块匹配模型, 构建状态在两次调用之间保持.
+ * 匹配模型总量为O(n^2)个模型 × O(n)个样本, 分块后峰值内存与样本数量无关
+ * @note
+ * 定向: 每对样本只以较亮者为中心构建一个匹配模型. 两个坐标系的亮度排序不一致时, 对应样本对的
+ * 定向相反, 无法匹配. 以亮度相近阈值构建时, 亮度差不超过阈值的样本对另以较暗者为中心构建反向模型.
+ * 反向模型仅在一个集合中构建, 即可覆盖两种定向
  */
 
 #ifndef BUILDMATCHSHAPE_H_
@@ -15,16 +26,96 @@
 #include "MatchingShapePoint.h"
 #include "MatchedShapePointPair.h"
 
+/*!
+ * @class BuildMatchShape
+ * @brief 由样本集合构建楔形匹配模型
+ * @tparam T 坐标精度: float或double
+ */
+template <typename T>
 class BuildMatchShape {
+public:
+	BuildMatchShape();
+	virtual ~BuildMatchShape();
 
 public:
+	/* 数据类型 */
+	/*!
+	 * @struct polar_point
+	 * @brief 样本相对中心的极坐标
+	 */
+	struct polar_point {
+		int id;		///< 样本ID
+		T len;		///< 距离
+		T incl;		///< 倾角, 量纲: 角度, 有效范围: [-180, +180]
+	};
+	typedef std::vector<polar_point> PolarPtVec;
+
+protected:
 	/* 成员变量 */
+	T angle_;				//< 楔形夹角, 量纲: 角度
+	PolarPtVec polars_;		//< 当前中心的极坐标索引, 按倾角递增排序
+
+	/* 分块构建状态 */
+	const PtMSVec<T>* pts_;	//< 样本集合
+	T len_low_;				//< 样本与中心的最小距离
+	T dmag_;				//< 构建反向模型的亮度差阈值
+	int idc_;				//< 当前中心ID
+	int npolar_;			//< 当前中心的极坐标索引长度
+	int korient_;			//< 下一个指向在极坐标索引中的序号
+	int lo_, hi_;			//< 楔形窗口在三倍展开索引中的区间: [lo, hi)
 
 public:
 	/* 接口 */
+	/*!
+	 * @brief 设置楔形夹角
+	 * @param angle  楔形夹角, 量纲: 角度. 有效范围: (0, 360)
+	 */
+	void SetAngle(T angle);
+	/*!
+	 * @brief 查看楔形夹角, 量纲: 角度
+	 */
+	T Angle() const {
+		return angle_;
+	}
+	/*!
+	 * @brief 以样本集合构建所有可能的匹配模型
+	 * @param pts      样本集合, 按亮度递减排列
+	 * @param len_low  样本与中心的最小距离
+	 * @param shapes   匹配模型集合. 已有元素的内存被重复使用
+	 * @param dmag     亮度差阈值, 量纲: 星等. 亮度(z)差不超过该值的样本对另构建反向模型. 0: 不构建
+	 * @return
+	 * 有效匹配模型数量, 即shapes中前若干个元素
+	 */
+	int Build(const PtMSVec<T>& pts, T len_low, MatchShapeVec<T>& shapes, T dmag = T(0));
+	/*!
+	 * @brief 开始分块构建
+	 * @param pts      样本集合, 按亮度递减排列. 调用者保证其在分块构建期间有效
+	 * @param len_low  样本与中心的最小距离
+	 * @param dmag     亮度差阈值, 量纲: 星等. 0: 不构建反向模型
+	 */
+	void Begin(const PtMSVec<T>& pts, T len_low, T dmag = T(0));
+	/*!
+	 * @brief 构建下一块匹配模型
+	 * @param shapes  匹配模型集合. 已有元素的内存被重复使用
+	 * @param budget  内存预算, 量纲: 字节. 0表示不限制
+	 * @return
+	 * 本块有效匹配模型数量. 0表示全部匹配模型已构建
+	 * @note
+	 * 按模型自身存储估计内存, 超出预算时结束本块. 每块至少包含一个匹配模型
+	 */
+	int Next(MatchShapeVec<T>& shapes, size_t budget);
 
 protected:
 	/* 功能 */
+	/*!
+	 * @brief 建立中心的极坐标索引
+	 * @param pts      样本集合
+	 * @param idc      中心ID
+	 * @param len_low  样本与中心的最小距离
+	 * @return
+	 * 索引内样本数量
+	 */
+	int build_polar(const PtMSVec<T>& pts, int idc, T len_low);
 };
 
 #endif /* BUILDMATCHSHAPE_H_ */
@@ -0,0 +1,164 @@
+/**
+ * @file FieldCache.cpp
+ * @brief 已解算星场的持久缓存: 以图像亮星构型的不变量编码索引定位解
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include "ADefine.h"
+#include "FieldCache.h"
+
+using namespace std;
+
+static bool operator<(const fieldcache_index& x1, const fieldcache_index& x2) {
+	return x1.code < x2.code || (x1.code == x2.code && x1.field < x2.field);
+}
+
+static bool operator==(const fieldcache_index& x1, const fieldcache_index& x2) {
+	return x1.code == x2.code && x1.field == x2.field;
+}
+
+FieldCache::FieldCache() {
+}
+
+FieldCache::~FieldCache() {
+}
+
+bool FieldCache::Load(const char* filepath) {
+	fields_.clear();
+	index_.clear();
+	FILE *fp = fopen(filepath, "rb");
+	if (!fp) return true;
+
+	fieldcache_header header;
+	bool rslt = fread(&header, sizeof(header), 1, fp) == 1
+			&& !memcmp(header.magic, FIELDCACHE_MAGIC, sizeof(header.magic))
+			&& header.nfield >= 0 && header.nindex >= 0;
+	if (rslt) {
+		fields_.resize(header.nfield);
+		index_.resize(header.nindex);
+		rslt = fread(fields_.data(), sizeof(fieldcache_field), header.nfield, fp) == size_t(header.nfield)
+				&& fread(index_.data(), sizeof(fieldcache_index), header.nindex, fp) == size_t(header.nindex);
+	}
+	fclose(fp);
+	// 索引项须指向有效星场
+	for (size_t i = 0; rslt && i < index_.size(); ++i) {
+		if (index_[i].field < 0 || index_[i].field >= header.nfield) rslt = false;
+	}
+	if (!rslt) {
+		fields_.clear();
+		index_.clear();
+	}
+	return rslt;
+}
+
+bool FieldCache::Save(const char* filepath) {
+	string pathtmp = string(filepath) + ".tmp";
+	FILE *fp = fopen(pathtmp.c_str(), "wb");
+	if (!fp) return false;
+
+	fieldcache_header header;
+	memcpy(header.magic, FIELDCACHE_MAGIC, sizeof(header.magic));
+	header.nfield = fields_.size();
+	header.nindex = index_.size();
+	bool rslt = fwrite(&header, sizeof(header), 1, fp) == 1
+			&& fwrite(fields_.data(), sizeof(fieldcache_field), fields_.size(), fp) == fields_.size()
+			&& fwrite(index_.data(), sizeof(fieldcache_index), index_.size(), fp) == index_.size();
+	rslt = !fclose(fp) && rslt;
+	if (rslt) rslt = !rename(pathtmp.c_str(), filepath);
+	if (!rslt) remove(pathtmp.c_str());
+	return rslt;
+}
+
+int FieldCache::Hash(const MatchRefsys::ObjImgVec& objs, int n, double lmin, vector<unsigned int>& codes) {
+	if (n > int(objs.size())) n = objs.size();
+	int i, j, k;
+	double s[3], t;
+
+	codes.clear();
+	for (i = 0; i < n; ++i) {
+		for (j = i + 1; j < n; ++j) {
+			for (k = j + 1; k < n; ++k) {
+				s[0] = hypot(objs[i].x - objs[j].x, objs[i].y - objs[j].y);
+				s[1] = hypot(objs[j].x - objs[k].x, objs[j].y - objs[k].y);
+				s[2] = hypot(objs[k].x - objs[i].x, objs[k].y - objs[i].y);
+				if (s[0] > s[1]) { t = s[0]; s[0] = s[1]; s[1] = t; }
+				if (s[1] > s[2]) { t = s[1]; s[1] = s[2]; s[2] = t; }
+				if (s[0] > s[1]) { t = s[0]; s[0] = s[1]; s[1] = t; }
+				if (s[0] < lmin) continue;
+				// 短边比值范围(0, 1], 中边比值范围[0.5, 1]. 各量化为8位
+				int q1 = int(s[0] / s[2] * 256.0);
+				int q2 = int((s[1] / s[2] - 0.5) * 512.0);
+				if (q1 > 255) q1 = 255;
+				if (q2 > 255) q2 = 255;
+				codes.push_back((unsigned int) (q1 << 8 | q2));
+			}
+		}
+	}
+	sort(codes.begin(), codes.end());
+	codes.erase(unique(codes.begin(), codes.end()), codes.end());
+	return codes.size();
+}
+
+int FieldCache::Lookup(const vector<unsigned int>& codes, int vote_min, vector<int>& fields) {
+	fieldcache_index key;
+	vector<fieldcache_index>::iterator first, last;
+
+	fields.clear();
+	votes_.assign(fields_.size(), 0);
+	key.field = -1;
+	for (size_t i = 0; i < codes.size(); ++i) {
+		key.code = codes[i];
+		first = lower_bound(index_.begin(), index_.end(), key);
+		for (last = first; last != index_.end() && last->code == key.code; ++last)
+			++votes_[last->field];
+	}
+	for (int k = 0; k < int(fields_.size()); ++k) {
+		if (votes_[k] >= vote_min) fields.push_back(k);
+	}
+	stable_sort(fields.begin(), fields.end(), [this](int k1, int k2) {
+		return votes_[k1] > votes_[k2];
+	});
+	return fields.size();
+}
+
+int FieldCache::Add(const MatchRefsys::solution& sol, int w, int h, const vector<unsigned int>& codes) {
+	double fov = (w > h ? w : h) * sol.scale * AS2D;
+	double cosd = cos(sol.dec * D2R);
+	int k, n(fields_.size());
+
+	/* 同一星场: 中心距与比例尺均接近 */
+	for (k = 0; k < n; ++k) {
+		const fieldcache_field& field = fields_[k];
+		double dra  = cyclemod(field.ra - sol.ra + 180.0, 360.0) - 180.0;
+		double ddec = field.dec - sol.dec;
+		if (sqrt(dra * dra * cosd * cosd + ddec * ddec) <= fov * 0.125
+				&& fabs(field.scale / sol.scale - 1.0) <= 0.02)
+			break;
+	}
+	if (k == n) fields_.push_back(fieldcache_field());
+	fieldcache_field& field = fields_[k];
+	field.ra       = sol.ra;
+	field.dec      = sol.dec;
+	field.scale    = sol.scale;
+	field.rotation = sol.rotation;
+	field.parity   = sol.parity;
+	field.w        = w;
+	field.h        = h;
+
+	/* 合并编码 */
+	fieldcache_index item;
+	item.field = k;
+	for (size_t i = 0; i < codes.size(); ++i) {
+		item.code = codes[i];
+		index_.push_back(item);
+	}
+	sort(index_.begin(), index_.end());
+	index_.erase(unique(index_.begin(), index_.end()), index_.end());
+
+	return k;
+}
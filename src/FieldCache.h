@@ -0,0 +1,121 @@
+/**
+ * @file FieldCache.h
+ * @brief 已解算星场的持久缓存: 以图像亮星构型的不变量编码索引定位解
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 编码: 最亮的若干星像两两组成三角形(最简的楔形), 三边按长度排序, 短边与中边相对长边的比值
+ * 与旋转、比例尺和镜像无关. 两个比值分别量化为8位, 组成16位编码
+ * @note
+ * 函数调用流程:
+ * - Load: 加载缓存文件. 文件不存在时为空缓存
+ * - Hash: 计算图像编码
+ * - Lookup: 以编码投票查找候选星场, 由调用者以候选星场的定位解为先验复核
+ * - Add: 解算成功后加入缓存. 与已有星场重合时合并编码
+ * - Save: 写入缓存文件
+ * @note
+ * 文件格式: 文件头 + 星场记录 + 按编码排序的倒排索引(编码, 星场编号). 字节序与主机相同
+ */
+
+#ifndef FIELDCACHE_H_
+#define FIELDCACHE_H_
+
+#include <string>
+#include <vector>
+#include "MatchRefsys.h"
+
+#define FIELDCACHE_MAGIC	"AFCACHE1"	//< 文件标识
+
+struct fieldcache_header {///< 缓存文件头
+	char magic[8];			///< 文件标识
+	int nfield;				///< 星场数量
+	int nindex;				///< 倒排索引项数量
+};
+
+struct fieldcache_field {///< 星场记录
+	double ra, dec;		///< 图像中心的世界坐标, 量纲: 角度
+	double scale;		///< 像元比例尺, 量纲: 角秒/像素
+	double rotation;	///< 旋转角, 量纲: 角度
+	int parity;			///< 镜像
+	int w, h;			///< 图像宽度和高度
+};
+
+struct fieldcache_index {///< 倒排索引项
+	unsigned int code;	///< 编码
+	int field;			///< 星场编号
+};
+
+class FieldCache {
+public:
+	FieldCache();
+	virtual ~FieldCache();
+
+protected:
+	std::vector<fieldcache_field> fields_;	//< 星场
+	std::vector<fieldcache_index> index_;	//< 倒排索引, 按编码递增排列
+	std::vector<int> votes_;				//< 查找时各星场的得票
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 加载缓存文件
+	 * @param filepath  文件路径
+	 * @return
+	 * 文件不存在或加载成功时返回true. 文件格式错误时返回false, 缓存为空
+	 */
+	bool Load(const char* filepath);
+	/*!
+	 * @brief 写入缓存文件
+	 * @param filepath  文件路径
+	 * @return
+	 * 写入结果
+	 * @note
+	 * 先写入临时文件再重命名, 写入中断时不破坏已有文件
+	 */
+	bool Save(const char* filepath);
+	/*!
+	 * @brief 计算图像编码
+	 * @param objs   图像目标. 样本在前部, 按亮度递增排列
+	 * @param n      参与编码的最亮目标数量
+	 * @param lmin   三角形最短边的下限, 量纲: 像素. 短边过短时比值对定位误差敏感
+	 * @param codes  编码, 已排序并去除重复项
+	 * @return
+	 * 编码数量
+	 */
+	static int Hash(const MatchRefsys::ObjImgVec& objs, int n, double lmin, std::vector<unsigned int>& codes);
+	/*!
+	 * @brief 查找候选星场
+	 * @param codes     图像编码
+	 * @param vote_min  候选星场的最少得票
+	 * @param fields    候选星场编号, 按得票递减排列
+	 * @return
+	 * 候选星场数量
+	 */
+	int Lookup(const std::vector<unsigned int>& codes, int vote_min, std::vector<int>& fields);
+	/*!
+	 * @brief 加入已解算星场
+	 * @param sol    定位解
+	 * @param w      图像宽度
+	 * @param h      图像高度
+	 * @param codes  图像编码
+	 * @return
+	 * 星场编号
+	 * @note
+	 * 中心距不超过视场的1/8且比例尺相差不超过2%时, 视为同一星场: 更新其定位解并合并编码
+	 */
+	int Add(const MatchRefsys::solution& sol, int w, int h, const std::vector<unsigned int>& codes);
+	/*!
+	 * @brief 查看星场记录
+	 */
+	const fieldcache_field& GetField(int k) const {
+		return fields_[k];
+	}
+	/*!
+	 * @brief 查看星场数量
+	 */
+	int FieldCount() const {
+		return fields_.size();
+	}
+};
+
+#endif /* FIELDCACHE_H_ */
@@ -0,0 +1,108 @@
+/**
+ * @file KdTree.cpp
+ * @brief 二维k-d树: 静态点集的最近邻搜索
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <algorithm>
+#include "KdTree.h"
+
+using namespace std;
+
+#define KDTREE_LEAF		8	//< 叶节点容量
+
+KdTree::KdTree() {
+}
+
+KdTree::~KdTree() {
+}
+
+void KdTree::Build(const double* x, const double* y, int n) {
+	pts_.resize(n);
+	axis_.assign(n, 0);
+	for (int i = 0; i < n; ++i) {
+		pts_[i].x  = x[i];
+		pts_[i].y  = y[i];
+		pts_[i].id = i;
+	}
+	build(0, n);
+	// 坐标按建树顺序分列存储, 叶节点内连续比较
+	x_.resize(n);
+	y_.resize(n);
+	ids_.resize(n);
+	for (int i = 0; i < n; ++i) {
+		x_[i]   = pts_[i].x;
+		y_[i]   = pts_[i].y;
+		ids_[i] = pts_[i].id;
+	}
+}
+
+void KdTree::build(int lo, int hi) {
+	if (hi - lo <= KDTREE_LEAF) return;
+
+	double xmin(pts_[lo].x), xmax(xmin), ymin(pts_[lo].y), ymax(ymin);
+	for (int i = lo + 1; i < hi; ++i) {
+		const point& pt = pts_[i];
+		if (pt.x < xmin) xmin = pt.x;
+		else if (pt.x > xmax) xmax = pt.x;
+		if (pt.y < ymin) ymin = pt.y;
+		else if (pt.y > ymax) ymax = pt.y;
+	}
+	int m = (lo + hi) / 2;
+	char axis = ymax - ymin > xmax - xmin;
+	if (axis) {
+		nth_element(pts_.begin() + lo, pts_.begin() + m, pts_.begin() + hi, [](const point& pt1, const point& pt2) {
+			return pt1.y < pt2.y;
+		});
+	}
+	else {
+		nth_element(pts_.begin() + lo, pts_.begin() + m, pts_.begin() + hi, [](const point& pt1, const point& pt2) {
+			return pt1.x < pt2.x;
+		});
+	}
+	axis_[m] = axis;
+	build(lo, m);
+	build(m + 1, hi);
+}
+
+int KdTree::Nearest(double x, double y, double r, double& d2) const {
+	int best(-1);
+	d2 = r * r;
+	search(0, ids_.size(), x, y, d2, best);
+	return best >= 0 ? ids_[best] : -1;
+}
+
+void KdTree::search(int lo, int hi, double x, double y, double& d2, int& best) const {
+	double dx, dy, d;
+
+	if (hi - lo <= KDTREE_LEAF) {
+		for (int i = lo; i < hi; ++i) {
+			dx = x_[i] - x;
+			dy = y_[i] - y;
+			if ((d = dx * dx + dy * dy) < d2) {
+				d2   = d;
+				best = i;
+			}
+		}
+		return;
+	}
+
+	int m = (lo + hi) / 2;
+	dx = x_[m] - x;
+	dy = y_[m] - y;
+	if ((d = dx * dx + dy * dy) < d2) {
+		d2   = d;
+		best = m;
+	}
+	// 先搜索查询点所在一侧; 划分线距离小于当前最近距离时再搜索另一侧
+	double diff = axis_[m] ? y - y_[m] : x - x_[m];
+	if (diff < 0.0) {
+		search(lo, m, x, y, d2, best);
+		if (diff * diff < d2) search(m + 1, hi, x, y, d2, best);
+	}
+	else {
+		search(m + 1, hi, x, y, d2, best);
+		if (diff * diff < d2) search(lo, m, x, y, d2, best);
+	}
+}
@@ -0,0 +1,70 @@
+/**
+ * @file KdTree.h
+ * @brief 二维k-d树: 静态点集的最近邻搜索
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 函数调用流程:
+ * - Build: 由点集建立索引. 点集在建立后不再变化
+ * - Nearest: 查找搜索半径内的最近点
+ * @note
+ * 存储: 节点不单独分配, 点按建树顺序重排于连续数组. 区间[lo, hi)的中位点为节点,
+ * 沿区间内跨度较大的坐标轴划分. 区间点数不超过叶节点容量时为叶节点, 搜索时逐点比较
+ */
+
+#ifndef KDTREE_H_
+#define KDTREE_H_
+
+#include <vector>
+
+class KdTree {
+public:
+	KdTree();
+	virtual ~KdTree();
+
+protected:
+	/* 数据类型 */
+	struct point {
+		double x, y;
+		int id;
+	};
+
+protected:
+	std::vector<point> pts_;		//< 建树时的点集
+	std::vector<double> x_, y_;		//< 按建树顺序重排的坐标
+	std::vector<int> ids_;			//< 按建树顺序重排的点ID
+	std::vector<char> axis_;		//< 节点划分轴. 0: X; 1: Y. 下标与重排后的点一致
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 建立索引
+	 * @param x  X坐标
+	 * @param y  Y坐标
+	 * @param n  点数量. 点ID为下标
+	 */
+	void Build(const double* x, const double* y, int n);
+	/*!
+	 * @brief 查找搜索半径内的最近点
+	 * @param x   X坐标
+	 * @param y   Y坐标
+	 * @param r   搜索半径
+	 * @param d2  最近点的距离平方
+	 * @return
+	 * 最近点ID. 搜索半径内无点时返回-1
+	 */
+	int Nearest(double x, double y, double r, double& d2) const;
+	/*!
+	 * @brief 查看点数量
+	 */
+	int Count() const {
+		return ids_.size();
+	}
+
+protected:
+	/* 功能 */
+	void build(int lo, int hi);
+	void search(int lo, int hi, double x, double y, double& d2, int& best) const;
+};
+
+#endif /* KDTREE_H_ */
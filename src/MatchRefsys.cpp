@@ -4,51 +4,89 @@
  * @date Sep 2020
  */
 
+#include <stdio.h>
 #include <algorithm>
+#include <type_traits>
 #include "ADefine.h"
+#include "ParamMatchShape.h"
 #include "MatchRefsys.h"
+#include "ShapeKernel.h"
+#include "MatchSolver.h"
 
 using namespace std;
 using namespace AstroUtil;
 
+#define TRACK_ROTATION_MAX	3.0		// 跟踪: 修正先验指向时搜索的旋转角偏差, 量纲: 角度
+
 MatchRefsys::MatchRefsys() {
 	aimg_min_ = 50.0;
-	diff_incl_max_ = 0.1;
-	diff_lnormal_max_ = 0.002;
-	shape_count_min_ = 10;
 	count_img_max_ = 40;
 	count_wcs_max_ = count_img_max_ * 3;
+	sample_cell_ = 3.0;
+	sample_depth_ = 1.5;
+	hit_ratio_min_ = 3.0;
 	good_match_ = 0.5;
+	track_radius_ = 10.0;
+	track_ratio_min_ = 0.5;
+	track_rms_max_ = 2.0;
+	use_float_ = false;
+	use_kernel_ = true;
+	use_stdprint_ = true;
 
 	scale_low_ = scale_high_ = 0.0;
 	aimg_low_ = 0.0;
 	awcs_low_ = 0.0;
 
+	wimg_ = himg_ = 0;
 	imgsample_ = 0;
 	wcssample_ = 0;
-	matched_.resize(count_img_max_);
+	imgdepth_  = 0;
+	wcsmag_lim_ = 0.0;
+	grid_cell_ = 0.0;
+	grid_nx_ = grid_ny_ = 0;
+	field_ = NULL;
 }
 
 MatchRefsys::~MatchRefsys() {
 
 }
 
+void MatchRefsys::SetParameter(const ParamMatchShape& param) {
+	aimg_min_         = param.aimg_min;
+	count_img_max_    = param.count_img_max;
+	count_wcs_max_    = param.count_wcs_max;
+	sample_cell_      = param.sample_cell;
+	sample_depth_     = param.sample_depth;
+	hit_ratio_min_    = param.hit_ratio_min;
+	good_match_       = param.good_match;
+	track_radius_     = param.track_radius;
+	track_ratio_min_  = param.track_ratio_min;
+	track_rms_max_    = param.track_rms_max;
+	use_float_        = param.use_float;
+	use_kernel_       = param.use_kernel;
+	use_stdprint_     = param.use_stdprint;
+	engine32_.SetParameter(param);
+	engine64_.SetParameter(param);
+}
+
 void MatchRefsys::SetGuessScale(double low, double high) {
 	scale_low_  = low * AS2R;
 	scale_high_ = high * AS2R;
 }
 
 void MatchRefsys::BeginImportImageObject(int w, int h) {
+	wimg_ = w;
+	himg_ = h;
 	if ((aimg_low_ = sqrt(w * w + h * h) * 0.126) < aimg_min_) aimg_low_ = aimg_min_;
 	objimg_.clear();
-	shapeimg_.clear();
+	pairs_.clear();
 }
 
 void MatchRefsys::BeginImportWcsObject(double l, double b) {
 	refwcs_.x = l * D2R;
 	refwcs_.y = b * D2R;
 	objwcs_.clear();
-	shapewcs_.clear();
+	pairs_.clear();
 }
 
 void MatchRefsys::ImportImageObject(double x, double y, double flux) {
@@ -71,214 +109,498 @@ void MatchRefsys::ImportWcsObject(double l, double b, float mag) {
 }
 
 void MatchRefsys::CompleteImportImageObject() {
-	/* 按照流量递减排序 */
-	stable_sort(objimg_.begin(), objimg_.end(), [](const object_image& x1, const object_image& x2) {
-		return (x1.brightness <= x2.brightness);
-	});
-	// 初始化候选匹配项
-	imgsample_ = objimg_.size() > count_img_max_ ? count_img_max_ : objimg_.size();
-	for (int i = 0; i < imgsample_; ++i) matched_[i].reset();
+	/* 选取空间均匀分布的亮目标 */
+	imgsample_ = select_sample(objimg_, objimg_.size(), count_img_max_, sample_cell());
+	/* 图像样本深度 */
+	imgdepth_ = imgsample_;
+	if (imgsample_) {
+		short faint = objimg_[imgsample_ - 1].brightness;
+		for (int i = imgsample_; i < int(objimg_.size()); ++i) {
+			if (objimg_[i].brightness <= faint) ++imgdepth_;
+		}
+	}
 }
 
 void MatchRefsys::CompleteImportWcsObjectr() {
-	/* 按照星等递增排序 */
-	stable_sort(objwcs_.begin(), objwcs_.end(), [](const object_wcs& x1, const object_wcs& x2) {
-		return (x1.brightness <= x2.brightness);
+	/* 在极限星等以内选取空间均匀分布的亮星. 网格与图像网格对应的天区尺寸一致 */
+	int n = select_depth(objwcs_.size());
+	wcssample_ = select_sample(objwcs_, n, count_wcs_max_, sample_cell() * scale_low_);
+}
+
+int MatchRefsys::select_depth(int n) {
+	wcsmag_lim_ = 0.0;
+	if (sample_depth_ <= 0.0 || !imgdepth_ || wimg_ <= 0 || himg_ <= 0 || scale_low_ <= 0.0) return n;
+
+	/* 候选参考星的天区面积与图像天区面积. 查询区域可为矩形或多边形, 以候选参考星的凸包计算面积 */
+	vector<int> ids(n), hull(2 * n + 1);
+	int i, k(0), lower;
+	for (i = 0; i < n; ++i) ids[i] = i;
+	sort(ids.begin(), ids.end(), [this](int i1, int i2) {
+		return objwcs_[i1].x < objwcs_[i2].x || (objwcs_[i1].x == objwcs_[i2].x && objwcs_[i1].y < objwcs_[i2].y);
 	});
-	wcssample_ = objwcs_.size() > count_wcs_max_ ? count_wcs_max_ : objwcs_.size();
+	auto cross = [this](int o, int a, int b) {
+		return (objwcs_[a].x - objwcs_[o].x) * (objwcs_[b].y - objwcs_[o].y)
+				- (objwcs_[a].y - objwcs_[o].y) * (objwcs_[b].x - objwcs_[o].x);
+	};
+	for (i = 0; i < n; ++i) {
+		while (k >= 2 && cross(hull[k - 2], hull[k - 1], ids[i]) <= 0.0) --k;
+		hull[k++] = ids[i];
+	}
+	for (i = n - 2, lower = k + 1; i >= 0; --i) {
+		while (k >= lower && cross(hull[k - 2], hull[k - 1], ids[i]) <= 0.0) --k;
+		hull[k++] = ids[i];
+	}
+	double area_wcs(0.0);
+	for (i = 1; i < k; ++i) {
+		area_wcs += objwcs_[hull[i - 1]].x * objwcs_[hull[i]].y - objwcs_[hull[i]].x * objwcs_[hull[i - 1]].y;
+	}
+	area_wcs *= 0.5;
+	// 比例尺取下限: 图像天区面积最小, 换算的星数最多
+	double area_img = double(wimg_) * himg_ * scale_low_ * scale_low_;
+	if (area_img <= 0.0) return n;
+	// 与图像样本深度相当的星表星数
+	int ndepth = int(imgdepth_ * sample_depth_ * area_wcs / area_img + 0.5);
+	if (ndepth < imgsample_) ndepth = imgsample_;
+	if (ndepth >= n) return n;
+
+	nth_element(objwcs_.begin(), objwcs_.begin() + ndepth - 1, objwcs_.begin() + n,
+			[](const object_wcs& x1, const object_wcs& x2) {
+		return x1.brightness < x2.brightness;
+	});
+	wcsmag_lim_ = objwcs_[ndepth - 1].brightness * 0.001;
+	return ndepth;
 }
 
-bool MatchRefsys::DoMatch() {
-	awcs_low_ = scale_low_ * aimg_low_;
+double MatchRefsys::sample_cell() {
+	if (sample_cell_ <= 0.0) return 0.0;
+	int ng = int(sqrt(count_img_max_ / sample_cell_) + 0.5);
+	return ng > 1 ? (wimg_ >= himg_ ? wimg_ : himg_) / double(ng) : 0.0;
+}
 
-	if (!build_wedge_image(60.0)) return false;
-	if (!build_wedge_wcs(60.0)) return false;
+template <class Obj>
+int MatchRefsys::select_sample(vector<Obj>& objs, int n, int nsample, double cell) {
+	auto brighter = [](const Obj& x1, const Obj& x2) {
+		return x1.brightness < x2.brightness;
+	};
+	if (nsample > n) nsample = n;
+	if (cell <= 0.0 || nsample == n) {// 不划分网格
+		partial_sort(objs.begin(), objs.begin() + nsample, objs.begin() + n, brighter);
+		return nsample;
+	}
 
-	int n1(shapeimg_.size()), n2(shapewcs_.size()), n(0);
-	int i, j;
-	bool success(false);
+	/* 候选目标的包围盒与网格 */
+	double xmin(objs[0].x), xmax(xmin), ymin(objs[0].y), ymax(ymin);
+	int i, k, r;
+	for (i = 1; i < n; ++i) {
+		if (objs[i].x < xmin) xmin = objs[i].x;
+		else if (objs[i].x > xmax) xmax = objs[i].x;
+		if (objs[i].y < ymin) ymin = objs[i].y;
+		else if (objs[i].y > ymax) ymax = objs[i].y;
+	}
+	int nx = int((xmax - xmin) / cell) + 1, ny = int((ymax - ymin) / cell) + 1;
+	int ncell(nx * ny);
+	vector<int> cells(n), start(ncell + 1, 0), ids(n);
+	// 计数排序: 按网格编号排列候选目标
+	for (i = 0; i < n; ++i) {
+		cells[i] = int((objs[i].y - ymin) / cell) * nx + int((objs[i].x - xmin) / cell);
+		++start[cells[i] + 1];
+	}
+	for (k = 0; k < ncell; ++k) start[k + 1] += start[k];
+	vector<int> pos(start.begin(), start.end() - 1);
+	for (i = 0; i < n; ++i) ids[pos[cells[i]]++] = i;
+	// 网格内按亮度部分排序, 深度不超过样本数量
+	auto brighter_id = [&objs](int i1, int i2) {
+		return objs[i1].brightness < objs[i2].brightness;
+	};
+	for (k = 0; k < ncell; ++k) {
+		int depth = start[k + 1] - start[k] < nsample ? start[k + 1] - start[k] : nsample;
+		partial_sort(ids.begin() + start[k], ids.begin() + start[k] + depth, ids.begin() + start[k + 1], brighter_id);
+	}
 
-	for (i = 0; i < n1; ++i) {
-		wedge_shape& shapeimg = shapeimg_[i];
-		for (j = 0; j < n2; ++j) {
-			if (match_wedge(shapeimg, shapewcs_[j])) ++n;
+	/* 逐轮选取各网格中第r亮的目标 */
+	vector<int> chosen, round;
+	for (r = 0; int(chosen.size()) < nsample; ++r) {
+		round.clear();
+		for (k = 0; k < ncell; ++k) {
+			if (start[k] + r < start[k + 1]) round.push_back(ids[start[k] + r]);
+		}
+		int need = nsample - chosen.size();
+		if (int(round.size()) > need) {
+			nth_element(round.begin(), round.begin() + need, round.end(), brighter_id);
+			round.resize(need);
 		}
+		chosen.insert(chosen.end(), round.begin(), round.end());
 	}
 
-	if (n) {
-		int id;
-		double ratio;
+	/* 样本按亮度递增排列在前, 其余候选目标保持原顺序 */
+	vector<char> flag(n, 0);
+	vector<Obj> sorted;
+	sorted.reserve(n);
+	sort(chosen.begin(), chosen.end(), brighter_id);
+	for (k = 0; k < nsample; ++k) {
+		flag[chosen[k]] = 1;
+		sorted.push_back(objs[chosen[k]]);
+	}
+	for (i = 0; i < n; ++i) {
+		if (!flag[i]) sorted.push_back(objs[i]);
+	}
+	copy(sorted.begin(), sorted.end(), objs.begin());
 
-		for (i = 0, n = 0; i < imgsample_; ++i) {
-			if ((id = matched_[i].get_maxhit(ratio)) >= 0 && ratio > 3.0) ++n;
-		}
-		success = n > int(imgsample_ * good_match_);
-		if (success) {
-			for (i = 0, n = 0; i < imgsample_; ++i) {
-				if ((id = matched_[i].get_maxhit(ratio)) >= 0 && ratio > 3.0) {
-					printf ("%4d %6.1f %6.1f | %4d %8.4f %8.4f | %4lu %4d\n",
-							i, objimg_[i].x, objimg_[i].y,
-							id, objwcs_[id].l * R2D, objwcs_[id].b * R2D,
-							matched_[i].idPeer.size(), int(ratio));
-				}
-			}
+	return nsample;
+}
+
+bool MatchRefsys::DoMatch() {
+	awcs_low_ = scale_low_ * aimg_low_;
+	pairs_.clear();
+
+	solution sol;
+	int n = use_float_ ? match_engine(engine32_) : match_engine(engine64_);
+	bool success = n > int(imgsample_ * good_match_) && fit_solution(sol);
+	if (!success) {// 宽比例尺范围: 复核得票最多的比例尺
+		success = use_float_ ? match_refine(engine32_, n, sol) : match_refine(engine64_, n, sol);
+	}
+	if (success) solution_ = sol;	// 匹配失败时保留此前的解
+
+	if (success && use_stdprint_) {
+		for (int i = 0; i < n; ++i) {
+			int idimg(pairs_[i].id1), idwcs(pairs_[i].id2);
+			printf ("%4d %6.1f %6.1f | %4d %8.4f %8.4f\n",
+					idimg, objimg_[idimg].x, objimg_[idimg].y,
+					idwcs, objwcs_[idwcs].l * R2D, objwcs_[idwcs].b * R2D);
 		}
 	}
 	return success;
 }
 
-void MatchRefsys::sphere2plane(double l, double b, double &xi, double &eta) {
-	double fract = sin(refwcs_.y) * sin(b) + cos(refwcs_.y) * cos(b) * cos(l - refwcs_.x);
-	xi  = cos(b) * sin(l - refwcs_.x) / fract;
-	eta = (cos(refwcs_.y) * sin(b) - sin(refwcs_.y) * cos(b) * cos(l - refwcs_.x)) / fract;
+bool MatchRefsys::DoMatch(const MatchField& field) {
+	refwcs_ = field.refwcs;
+	objwcs_.assign(field.objwcs.begin(), field.objwcs.end());
+	wcssample_ = field.wcssample;
+	field_ = &field;
+	bool success = DoMatch();
+	field_ = NULL;
+	return success;
 }
 
-void MatchRefsys::calc_image_points(const int idc, const int id, double &len, double &incl) {
-	double dx = objimg_[id].x - objimg_[idc].x;
-	double dy = objimg_[id].y - objimg_[idc].y;
-	len  = sqrt(dx * dx + dy * dy);
-	incl = atan2(dy, dx) * R2D;
+template <typename T>
+int MatchRefsys::match_engine(ShapeMatch<T>& engine) {
+	PtMSVec<T> pts;
+	int i;
+
+	engine.SetScale(T(scale_low_), T(scale_high_));
+	// 图像匹配单元
+	for (i = 0; i < imgsample_; ++i)
+		pts.push_back(PointMS<T>(i, T(objimg_[i].x), T(objimg_[i].y), T(objimg_[i].brightness * 0.001)));
+	if (!engine.BuildShape1(pts, T(aimg_low_))) return 0;
+	// 世界匹配单元: 优先引用精度一致的星表侧模型
+	if (field_ && field_->use_float == std::is_same<T, float>::value) {
+		if (!engine.UseShape2(field_->Shapes(T()), field_->nshape, field_->ids,
+				&field_->Pool(T()), &field_->quant)) return 0;
+	}
+	else {
+		pts.clear();
+		for (i = 0; i < wcssample_; ++i)
+			pts.push_back(PointMS<T>(i, T(objwcs_[i].x), T(objwcs_[i].y)));
+		// 流式匹配: 世界匹配单元分块生成并匹配
+		if (engine.Streaming()) {
+			if (!engine.MatchStream(pts, T(awcs_low_))) return 0;
+			return engine.GetMatchedPair(hit_ratio_min_, pairs_);
+		}
+		if (!engine.BuildShape2(pts, T(awcs_low_))) return 0;
+	}
+	// 匹配与投票: 优先使用样本容量适用的定长匹配核
+	int n = use_kernel_ ? ShapeKernelSet<T>::Match(engine, hit_ratio_min_, pairs_) : -1;
+	if (n >= 0) return n;
+	if (!engine.Match()) return 0;
+	return engine.GetMatchedPair(hit_ratio_min_, pairs_);
 }
 
-void MatchRefsys::calc_wcs_points(const int idc, const int id, double &len, double &incl) {
-	double dx = objwcs_[id].x - objwcs_[idc].x;
-	double dy = objwcs_[id].y - objwcs_[idc].y;
-	len  = sqrt(dx * dx + dy * dy);
-	incl = atan2(dy, dx) * R2D;
+template <typename T>
+bool MatchRefsys::match_refine(ShapeMatch<T>& engine, int& n, solution& sol) {
+	if (!engine.Bucketed()) return false;
+
+	double scale = engine.BestScale();
+	double margin = exp(1.5 * engine.BucketWidth());
+	double low(scale_low_), high(scale_high_);
+	const MatchField* field(field_);
+	ObjWcsVec objwcs(objwcs_);	// 复核失败时恢复
+	int wcssample(wcssample_);
+	double maglim(wcsmag_lim_);
+	// 该比例尺对应视场内的参考星排在前面, 从中重新选样
+	double r = sqrt(double(wimg_) * wimg_ + double(himg_) * himg_) * 0.5 * scale * margin;
+	ObjWcsVec::iterator it = partition(objwcs_.begin(), objwcs_.end(), [r](const object_wcs& obj) {
+		return obj.x * obj.x + obj.y * obj.y <= r * r;
+	});
+	int nin = it - objwcs_.begin();
+
+	scale_low_  = scale / margin > low ? scale / margin : low;
+	scale_high_ = scale * margin < high ? scale * margin : high;
+	awcs_low_   = scale_low_ * aimg_low_;
+	wcssample_  = select_sample(objwcs_, select_depth(nin), count_wcs_max_, sample_cell() * scale_low_);
+	field_      = NULL;	// 星表侧模型按宽范围建立, 复核时重建世界匹配单元
+	pairs_.clear();
+	n = match_engine(engine);
+	scale_low_  = low;
+	scale_high_ = high;
+	field_      = field;
+	if (n > int(imgsample_ * good_match_) && fit_solution(sol)) return true;
+
+	objwcs_.swap(objwcs);
+	wcssample_  = wcssample;
+	wcsmag_lim_ = maglim;
+	pairs_.clear();
+	return false;
 }
 
-bool MatchRefsys::build_wedge_image(const int idc, const int ido, double angle, wedge_shape &shape) {
-	int id;
-	double low2 = aimg_low_ * aimg_low_;
-	double len_orient, incl_orient, recip;
-	double len, incl;
-	double dx, dy;
-
-	// 计算指向点的距离和倾角
-	calc_image_points(idc, ido, len_orient, incl_orient);
-	if (len_orient < aimg_low_) return false;
-	recip = 1.0 / len_orient;
-	// 遍历符合条件的图像点
-	angle *= 0.5;
-	for (id = 0; id < imgsample_; ++id) {
-		if (!(id == idc || id == ido)) {
-			dx = objimg_[id].x - objimg_[idc].x;
-			dy = objimg_[id].y - objimg_[idc].y;
-			len = dx * dx + dy * dy;
-			if (len < low2) continue;
-			incl = atan2(dy, dx) * R2D - incl_orient;
-			if (fabs(incl) > angle) continue;
-
-			wedge_item item;
-			item.id      = id;
-			item.incl    = incl;
-			item.lnormal = sqrt(len) * recip;
-			shape.items.push_back(item);
+bool MatchRefsys::DoTrack(const solution& prior) {
+	if (prior.scale > 0.0 && !objimg_.empty() && !objwcs_.empty()) {
+		/* 以先验解建立样本对并拟合, 再以拟合结果缩小半径重复一次 */
+		solution sol(prior), fit;
+		double r(track_radius_);
+		int nbright(0);
+		bool fitted(false);	// 两次拟合均成功
+
+		estimate_shift(sol, r * 2.0);
+		build_grid(r);
+		for (int pass = 0; pass < 2; ++pass, r *= 0.5) {
+			nbright = match_nearest(sol, r);
+			if (!(fitted = fit_solution(fit))) break;
+			sol = fit;
+		}
+		/* 检查跟踪质量. 通过检查后才更新solution_ */
+		if (fitted && nbright >= int(imgsample_ * track_ratio_min_) && fit.matched >= 3
+				&& fit.rms <= track_rms_max_) {
+			solution_ = fit;
+			return true;
 		}
 	}
-	if (shape.items.size() < 2) return false;
-	// 填充其它信息
-	shape.idCenter = idc;
-	shape.idOrient = ido;
-	shape.incl     = incl_orient;
-	shape.len      = len_orient;
-
-	return true;
+	// 回退: 完整匹配
+	return DoMatch();
 }
 
-bool MatchRefsys::build_wedge_wcs(const int idc, const int ido, double angle, wedge_shape &shape) {
-	int id;
-	double low2 = awcs_low_ * awcs_low_;
-	double len_orient, incl_orient, recip;
-	double len, incl;
-	double dx, dy;
-
-	// 计算指向点的距离和倾角
-	calc_wcs_points(idc, ido, len_orient, incl_orient);
-	if (len_orient < awcs_low_) return false;
-	recip = 1.0 / len_orient;
-	// 遍历符合条件的世界点
-	angle *= 0.5;
-	for (id = 0; id < wcssample_; ++id) {
-		if (!(id == idc || id == ido)) {
-			dx = objwcs_[id].x - objwcs_[idc].x;
-			dy = objwcs_[id].y - objwcs_[idc].y;
-			len = dx * dx + dy * dy;
-			if (len < low2) continue;
-			incl = atan2(dy, dx) * R2D - incl_orient;
-			if (fabs(incl) > angle) continue;
-
-			wedge_item item;
-			item.id      = id;
-			item.incl    = incl;
-			item.lnormal = sqrt(len) * recip;
-			shape.items.push_back(item);
+int MatchRefsys::estimate_shift(solution& sol, double cell) {
+	double x0(wimg_ * 0.5), y0(himg_ * 0.5);
+	double limit = (wimg_ <= himg_ ? wimg_ : himg_) * 0.25;	// 位移上限
+	// 旋转角步长: 旋转偏差在图像边缘引起的位移不超过网格尺寸
+	double step = cell / sqrt(x0 * x0 + y0 * y0) * R2D;
+	int nrot = int(TRACK_ROTATION_MAX / step);
+	int nside = 2 * int(limit / cell) + 1;
+	int i, j, k, rot, n(wcssample_);
+	double a, b, s2, c, d, dxi, deta, dx, dy;
+	vector<double> px(n), py(n);
+	vector<int> votes(nside * nside);
+
+	/* 以参考星样本的预测坐标计算位移 */
+	auto predict = [&](double rotation) {
+		a  = sol.scale * AS2R * cos(rotation * D2R);
+		b  = sol.scale * AS2R * sin(rotation * D2R);
+		s2 = a * a + b * b;
+		for (j = 0; j < n; ++j) {
+			dxi  = objwcs_[j].x - c;
+			deta = objwcs_[j].y - d;
+			px[j] = x0 + sol.parity * (a * dxi + b * deta) / s2;
+			py[j] = y0 + (a * deta - b * dxi) / s2;
+		}
+	};
+
+	/* 在旋转角偏差范围内位移投票 */
+	int best(-1), bestrot(0), peak(0);
+	sphere2plane(sol.ra * D2R, sol.dec * D2R, c, d);
+	for (rot = -nrot; rot <= nrot; ++rot) {
+		predict(sol.rotation + rot * step);
+		votes.assign(nside * nside, 0);
+		for (i = 0; i < imgsample_; ++i) {
+			for (j = 0; j < n; ++j) {
+				dx = objimg_[i].x - px[j];
+				dy = objimg_[i].y - py[j];
+				if (fabs(dx) >= limit || fabs(dy) >= limit) continue;
+				k = int((dy + limit) / cell) * nside + int((dx + limit) / cell);
+				if (++votes[k] > peak) {
+					peak    = votes[k];
+					best    = k;
+					bestrot = rot;
+				}
+			}
 		}
 	}
-	if (shape.items.size() < 2) return false;
-	// 填充其它信息
-	shape.idCenter = idc;
-	shape.idOrient = ido;
-	shape.incl     = incl_orient;
-	shape.len      = len_orient;
-
-	return true;
+	if (peak < 3) return peak;
+
+	/* 得票最多网格及其相邻网格内的位移均值 */
+	double cx = (best % nside + 0.5) * cell - limit, cy = (best / nside + 0.5) * cell - limit;
+	double sx(0.0), sy(0.0);
+	int m(0);
+	sol.rotation += bestrot * step;
+	predict(sol.rotation);
+	for (i = 0; i < imgsample_; ++i) {
+		for (j = 0; j < n; ++j) {
+			dx = objimg_[i].x - px[j];
+			dy = objimg_[i].y - py[j];
+			if (fabs(dx - cx) > cell || fabs(dy - cy) > cell) continue;
+			sx += dx;
+			sy += dy;
+			++m;
+		}
+	}
+	dx = sx / m;
+	dy = sy / m;
+	/* 图像中心对应预测坐标(x0 - dx, y0 - dy) */
+	double u(-sol.parity * dx), v(-dy);
+	plane2sphere(a * u - b * v + c, b * u + a * v + d, sol.ra, sol.dec);
+	sol.ra  *= R2D;
+	sol.dec *= R2D;
+	return peak;
 }
 
-bool MatchRefsys::build_wedge_image(double angle) {
-	int idc, ido;
-
-	for (idc = 0; idc < imgsample_; ++idc) {
-		for (ido = idc + 1; ido < imgsample_; ++ido) {
-			wedge_shape shape;
-			if (build_wedge_image(idc, ido, angle, shape)) shapeimg_.push_back(shape);
+int MatchRefsys::match_nearest(const solution& sol, double r) {
+	/* 以定位解预测参考星的图像坐标 */
+	double x0(wimg_ * 0.5), y0(himg_ * 0.5);
+	double a = sol.scale * AS2R * cos(sol.rotation * D2R);
+	double b = sol.scale * AS2R * sin(sol.rotation * D2R);
+	double s2 = a * a + b * b;
+	double c, d, dxi, deta, x, y, dx, dy, len;
+	int i, id, n(objwcs_.size()), nbright(0);
+
+	owner_.assign(objimg_.size(), -1);
+	dist_.resize(objimg_.size());
+	sphere2plane(sol.ra * D2R, sol.dec * D2R, c, d);
+	for (i = 0; i < n; ++i) {
+		dxi  = objwcs_[i].x - c;
+		deta = objwcs_[i].y - d;
+		x = x0 + sol.parity * (a * dxi + b * deta) / s2;
+		y = y0 + (a * deta - b * dxi) / s2;
+		if (x < -r || y < -r || x > wimg_ + r || y > himg_ + r) continue;
+		if ((id = find_nearest(x, y, r)) < 0) continue;
+		// 一个图像目标仅保留距离最近的参考星
+		dx  = objimg_[id].x - x;
+		dy  = objimg_[id].y - y;
+		len = dx * dx + dy * dy;
+		if (owner_[id] < 0 || len < dist_[id]) {
+			owner_[id] = i;
+			dist_[id]  = len;
 		}
 	}
-	return shapeimg_.size() >= shape_count_min_;
+
+	pairs_.clear();
+	for (i = 0; i < int(owner_.size()); ++i) {
+		if (owner_[i] < 0) continue;
+		pairs_.push_back(PointPairMS(i, owner_[i]));
+		if (i < imgsample_) ++nbright;
+	}
+	return nbright;
 }
 
-bool MatchRefsys::build_wedge_wcs(double angle) {
-	int idc, ido;
+void MatchRefsys::build_grid(double cell) {
+	int n(objimg_.size()), i, k;
+
+	grid_cell_ = cell;
+	grid_nx_ = int(wimg_ / cell) + 1;
+	grid_ny_ = int(himg_ / cell) + 1;
+	grid_start_.assign(grid_nx_ * grid_ny_ + 1, 0);
+	grid_ids_.resize(n);
+	vector<int> cells(n);
+	// 计数排序: 按网格编号排列图像目标
+	for (i = 0; i < n; ++i) {
+		int ix = int(objimg_[i].x / cell), iy = int(objimg_[i].y / cell);
+		if (ix < 0) ix = 0;
+		else if (ix >= grid_nx_) ix = grid_nx_ - 1;
+		if (iy < 0) iy = 0;
+		else if (iy >= grid_ny_) iy = grid_ny_ - 1;
+		cells[i] = iy * grid_nx_ + ix;
+		++grid_start_[cells[i] + 1];
+	}
+	for (k = 0; k < grid_nx_ * grid_ny_; ++k) grid_start_[k + 1] += grid_start_[k];
+	vector<int> pos(grid_start_.begin(), grid_start_.end() - 1);
+	for (i = 0; i < n; ++i) grid_ids_[pos[cells[i]]++] = i;
+}
 
-	for (idc = 0; idc < wcssample_; ++idc) {
-		for (ido = idc + 1; ido < wcssample_; ++ido) {
-			wedge_shape shape;
-			if (build_wedge_wcs(idc, ido, angle, shape)) shapewcs_.push_back(shape);
+int MatchRefsys::find_nearest(double x, double y, double r) {
+	int ix = int(floor(x / grid_cell_)), iy = int(floor(y / grid_cell_));
+	int i, j, k, id(-1);
+	double dx, dy, len, lmin(r * r);
+
+	for (j = iy - 1; j <= iy + 1; ++j) {
+		if (j < 0 || j >= grid_ny_) continue;
+		for (i = ix - 1; i <= ix + 1; ++i) {
+			if (i < 0 || i >= grid_nx_) continue;
+			int cellid = j * grid_nx_ + i;
+			for (k = grid_start_[cellid]; k < grid_start_[cellid + 1]; ++k) {
+				dx = objimg_[grid_ids_[k]].x - x;
+				dy = objimg_[grid_ids_[k]].y - y;
+				if ((len = dx * dx + dy * dy) < lmin) {
+					lmin = len;
+					id   = grid_ids_[k];
+				}
+			}
 		}
 	}
-	return shapewcs_.size() >= shape_count_min_;
+	return id;
 }
 
-bool MatchRefsys::match_wedge(const wedge_shape &shapeImg, const wedge_shape &shapeWcs) {
-	double scale = shapeWcs.len / shapeImg.len;
-	if (scale < scale_low_ || scale > scale_high_) return false;
-
-	const WedgeItemVec& items_img = shapeImg.items;
-	const WedgeItemVec& items_wcs = shapeWcs.items;
-	double incl, lnormal;
-	int n1(items_img.size()), n2(items_wcs.size()), n0(0);
-	int i, j, id;
-
-	for (i = 0; i < n1; ++i) {
-		id      = items_img[i].id;
-		incl    = items_img[i].incl;
-		lnormal = items_img[i].lnormal;
-		for (j = 0; j < n2; ++j) {
-			// 正方向角度偏差大于阈值: 角度正反向需单独判定...
-			if (   fabs(incl - items_wcs[j].incl) > diff_incl_max_) continue;
-			// 归一距离偏差大于阈值
-			if (fabs(items_wcs[j].lnormal - lnormal) > diff_lnormal_max_) continue;
-			// 加入候选匹配项
-			++n0;
-			matched_[id].add_point(items_wcs[j].id);
+bool MatchRefsys::fit_solution(solution& sol) {
+	int n(pairs_.size()), i, k;
+	if (n < 3) return false;
+
+	double x0(wimg_ * 0.5), y0(himg_ * 0.5);
+	double best(-1.0);
+
+	for (int parity = 1; parity >= -1; parity -= 2) {
+		/* 最小二乘: 去均值后求解相似变换 */
+		double mx(0.0), my(0.0), mp(0.0), mq(0.0);
+		double suu(0.0), sa(0.0), sb(0.0), u, v, p, q;
+		for (k = 0; k < n; ++k) {
+			i = pairs_[k].id1;
+			mx += parity * (objimg_[i].x - x0);
+			my += objimg_[i].y - y0;
+			mp += objwcs_[pairs_[k].id2].x;
+			mq += objwcs_[pairs_[k].id2].y;
+		}
+		mx /= n, my /= n, mp /= n, mq /= n;
+		for (k = 0; k < n; ++k) {
+			i = pairs_[k].id1;
+			u = parity * (objimg_[i].x - x0) - mx;
+			v = objimg_[i].y - y0 - my;
+			p = objwcs_[pairs_[k].id2].x - mp;
+			q = objwcs_[pairs_[k].id2].y - mq;
+			suu += u * u + v * v;
+			sa  += u * p + v * q;
+			sb  += u * q - v * p;
+		}
+		if (suu <= 0.0) return false;
+		double a(sa / suu), b(sb / suu);
+		double c(mp - a * mx + b * my), d(mq - b * mx - a * my);
+		double s(sqrt(a * a + b * b)), res(0.0);
+		for (k = 0; k < n; ++k) {
+			i = pairs_[k].id1;
+			u = parity * (objimg_[i].x - x0);
+			v = objimg_[i].y - y0;
+			p = a * u - b * v + c - objwcs_[pairs_[k].id2].x;
+			q = b * u + a * v + d - objwcs_[pairs_[k].id2].y;
+			res += p * p + q * q;
+		}
+		res = sqrt(res / n) / s;
+		if (best < 0.0 || res < best) {
+			best = res;
+			plane2sphere(c, d, sol.ra, sol.dec);
+			sol.ra      *= R2D;
+			sol.dec     *= R2D;
+			sol.scale    = s * R2AS;
+			sol.rotation = atan2(b, a) * R2D;
+			sol.parity   = parity;
+			sol.rms      = res;
+			sol.matched  = n;
 		}
 	}
+	return true;
+}
 
-	// 中心点和定向点加入候选匹配项
-	if (n0) {
-		matched_[shapeImg.idCenter].add_point(shapeWcs.idCenter);
-		matched_[shapeImg.idOrient].add_point(shapeWcs.idOrient);
-	}
+void MatchRefsys::sphere2plane(double l, double b, double &xi, double &eta) {
+	double fract = sin(refwcs_.y) * sin(b) + cos(refwcs_.y) * cos(b) * cos(l - refwcs_.x);
+	xi  = cos(b) * sin(l - refwcs_.x) / fract;
+	eta = (cos(refwcs_.y) * sin(b) - sin(refwcs_.y) * cos(b) * cos(l - refwcs_.x)) / fract;
+}
 
-	return n0;
+void MatchRefsys::plane2sphere(double xi, double eta, double &l, double &b) {
+	double fract = cos(refwcs_.y) - eta * sin(refwcs_.y);
+	l = cyclemod(refwcs_.x + atan2(xi, fract), A2PI);
+	b = atan2((eta * cos(refwcs_.y) + sin(refwcs_.y)) * cos(l - refwcs_.x), fract);
 }
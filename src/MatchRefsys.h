@@ -4,6 +4,7 @@
  * @date Sep 2020
  * @note
  * 函数调用流程:
+ * - SetParameter
  * - SetGuessScale
  * - BeginImportImageObject
  * - ImportImageObject
@@ -12,12 +13,23 @@
  * - ImportWcsObject
  * - CompleteImportWcsObject
  * - DoMatch
+ *
+ * 共享星表侧模型(MatchSolver): 世界系不导入, 以DoMatch(field)替代DoMatch
+ *
+ * 跟踪模式: 同一指向的帧序列, 以前一帧的解为先验
+ * - BeginImportImageObject ... CompleteImportImageObject
+ * - BeginImportWcsObject ... CompleteImportWcsObjectr
+ * - DoTrack
+ * - GetSolution
  */
 
 #ifndef MATCHREFSYS_H_
 #define MATCHREFSYS_H_
 
 #include <vector>
+#include "ShapeMatch.h"
+
+struct MatchField;
 
 class MatchRefsys {
 public:
@@ -45,120 +57,46 @@ public:
 	using ObjWcsVec = std::vector<object_wcs>;
 
 	/*!
-	 * @brief 匹配元素的归算结果
-	 */
-	struct wedge_item {
-		int id;
-		double incl;	//< 相对定向指向的夹角, 角度
-		double lnormal;	//< 归一化距离
-	};
-	using WedgeItemVec = std::vector<wedge_item>;
-
-	/*!
-	 * @struct 匹配单元
-	 */
-	struct wedge_shape {
-		int idCenter;	//< 中心ID
-		int idOrient;	//< 朝向ID
-		double incl;	//< 倾角: 中心-朝向
-		double len;		//< 距离: 中心-朝向
-		WedgeItemVec items;	//< 楔子内其它元素的归算结果
-
-	public:
-		void reset() {
-			items.clear();
-		}
-	};
-	using WedgeShapeVec = std::vector<wedge_shape>;
-
-	/*!
-	 * @struct hit_point 命中点
-	 * @member id  世界系ID
-	 * @member hit 命中次数
-	 */
-	struct hit_point {
-		int id;
-		int hit;
-
-	public:
-		hit_point() {
-			id = hit = 0;
-		}
-
-		hit_point(int _id) {
-			id  = _id;
-			hit = 1;
-		}
-
-		void inc() {
-			++hit;
-		}
-	};
-	using HitPtVec = std::vector<hit_point>;
-
-	/*!
-	 * @struct matched_point 点匹配对应关系
+	 * @struct solution 定位解: 图像系到世界系的相似变换
+	 * @note
+	 * 投影平面坐标: xi  = a * x' - b * y' + c
+	 *               eta = b * x' + a * y' + d
+	 * 其中, x' = parity * (x - x0), y' = y - y0, (x0, y0)为图像中心
 	 */
-	struct matched_point {
-		HitPtVec idPeer;
+	struct solution {
+		double ra, dec;		//< 图像中心的世界坐标, 量纲: 角度
+		double scale;		//< 像元比例尺, 量纲: 角秒/像素
+		double rotation;	//< 旋转角, 量纲: 角度
+		int parity;			//< 镜像: +1, 同向; -1, 沿X轴镜像
+		double rms;			//< 残差, 量纲: 像素
+		int matched;		//< 参与拟合的样本对数量
 
 	public:
-		virtual ~matched_point() {
-			idPeer.clear();
-		}
-
-		void reset() {
-			idPeer.clear();
-		}
-
-		void add_point(int id) {
-			HitPtVec::iterator it;
-			for (it = idPeer.begin(); it != idPeer.end() && it->id != id; ++it);
-			if (it != idPeer.end()) it->inc();
-			else {
-				hit_point pt(id);
-				idPeer.push_back(pt);
-			}
-		}
-
-		/*!
-		 * @brief 提取命中率最高的WCS目标ID
-		 * @param ratio 命中率最高与次高的比值
-		 * @return
-		 * 命中率最高的ID
-		 */
-		int get_maxhit(double &ratio) {
-			int n(idPeer.size());
-			if (!n) return -1;
-
-			int i, id, hit, sechit(1), maxhit(1);
-			for (i = 0; i < n; ++i) {
-				if (maxhit < (hit = idPeer[i].hit)) {
-					sechit = maxhit;
-					maxhit = hit;
-					id     = idPeer[i].id;
-				}
-				else if (sechit < hit)
-					sechit = hit;
-			}
-
-			ratio = double(maxhit) / sechit;
-			return id;
+		solution() {
+			ra = dec = scale = rotation = rms = 0.0;
+			parity  = 1;
+			matched = 0;
 		}
 	};
-	using MatchedPtVec = std::vector<matched_point>;
 
 protected:
 	/* 参数 */
 	double aimg_min_;			//< 约束: 定向点的中心距
-	double diff_incl_max_;		//< 约束: 倾角最大偏差
-	double diff_lnormal_max_;	//< 约束: 归一距离最大偏差
-	int shape_count_min_;		//< 约束: 匹配单元最小数量
 	int count_img_max_;			//< 约束: 图像系参与匹配的最大目标数
 	int count_wcs_max_;			//< 约束: 世界系参与匹配的最大目标数
+	double sample_cell_;		//< 约束: 空间均匀选样时每个网格的平均样本数
+	double sample_depth_;		//< 约束: 星表样本深度与图像样本深度之比
+	double hit_ratio_min_;		//< 约束: 命中率最高与次高的比值阈值
 	double good_match_;			//< 约束: 匹配成功阈值
+	double track_radius_;		//< 跟踪: 最近邻搜索半径, 量纲: 像素
+	double track_ratio_min_;	//< 跟踪: 亮样本最小匹配比例
+	double track_rms_max_;		//< 跟踪: 最大残差, 量纲: 像素
+	bool use_float_;			//< 使用单精度匹配引擎
+	bool use_kernel_;			//< 使用定长匹配核
+	bool use_stdprint_;			//< 在标准输出设备打印匹配结果
 
 	/* 匹配项 */
+	int wimg_, himg_;	//< 图像宽度和高度
 	refcenter refwcs_;	//< 世界坐标中心, 量纲: 弧度
 	ObjImgVec objimg_;	//< 图像坐标集合
 	ObjWcsVec objwcs_;	//< 世界坐标集合
@@ -170,12 +108,29 @@ protected:
 
 	int imgsample_;		//< 参与匹配的图像样本数量
 	int wcssample_;		//< 参与匹配的世界样本数量
-	WedgeShapeVec shapeimg_;	//< 图像匹配单元集合
-	WedgeShapeVec shapewcs_;	//< 世界匹配单元集合
-	MatchedPtVec matched_;	//< 匹配候选
+	int imgdepth_;		//< 图像样本深度: 不暗于最暗图像样本的星像数量
+	double wcsmag_lim_;	//< 世界样本的极限星等. 未估计时为0
+	ShapeMatch<float>  engine32_;	//< 匹配引擎: 单精度
+	ShapeMatch<double> engine64_;	//< 匹配引擎: 双精度
+	PtPairMSVec pairs_;		//< 匹配结果: 图像系ID-世界系ID
+	const MatchField* field_;	//< 共享的星表侧模型. 仅在DoMatch(field)期间有效
+	solution solution_;		//< 定位解
+
+	/* 跟踪模式: 图像目标的网格索引 */
+	double grid_cell_;				//< 网格尺寸, 量纲: 像素
+	int grid_nx_, grid_ny_;			//< 网格数量
+	std::vector<int> grid_start_;	//< 网格在grid_ids_中的起始位置
+	std::vector<int> grid_ids_;		//< 按网格排列的图像目标ID
+	std::vector<int> owner_;		//< 图像目标对应的世界目标ID
+	std::vector<double> dist_;		//< 图像目标与世界目标预测位置的距离平方
 
 public:
 	/* 接口 */
+	/*!
+	 * @brief 设置模型构建与匹配约束参数
+	 * @param param  约束参数
+	 */
+	void SetParameter(const ParamMatchShape& param);
 	void SetGuessScale(double low, double high);
 	/*!
 	 * @brief 导入参与匹配的图像和世界坐标
@@ -196,76 +151,174 @@ public:
 	 * 匹配结果
 	 */
 	bool DoMatch();
+	/*!
+	 * @brief 使用共享的星表侧模型执行匹配流程
+	 * @param field  星表侧模型, 由MatchSolver建立
+	 * @return
+	 * 匹配结果
+	 * @note
+	 * 世界目标由星表侧模型复制, 世界系匹配单元直接引用星表侧模型, 不再构建
+	 */
+	bool DoMatch(const MatchField& field);
+	/*!
+	 * @brief 跟踪模式: 以前一帧的解为先验, 由最近邻建立样本对并拟合
+	 * @param prior  先验解
+	 * @return
+	 * 定位结果
+	 * @note
+	 * - 以图像样本与参考星样本的位移投票修正先验指向, 使指向偏差大于搜索半径时仍可跟踪
+	 * - 以先验解预测参考星的图像坐标, 在网格索引中搜索最近的图像目标
+	 * - 亮样本匹配比例或残差超出阈值时, 回退至DoMatch完整匹配
+	 */
+	bool DoTrack(const solution& prior);
+	/*!
+	 * @brief 查看定位解
+	 */
+	const solution& GetSolution() const {
+		return solution_;
+	}
+	/*!
+	 * @brief 查看匹配结果
+	 * @return
+	 * 匹配成功的样本对. id1: 图像系ID; id2: 世界系ID
+	 */
+	const PtPairMSVec& GetMatchedPair() const {
+		return pairs_;
+	}
+	/*!
+	 * @brief 查看图像目标. 样本在前部, 按亮度递增排列
+	 */
+	const ObjImgVec& GetImageObject() const {
+		return objimg_;
+	}
+	/*!
+	 * @brief 查看世界目标. 样本在前部, 按亮度递增排列
+	 */
+	const ObjWcsVec& GetWcsObject() const {
+		return objwcs_;
+	}
+	/*!
+	 * @brief 查看世界目标投影平面的切点
+	 * @return
+	 * 切点的世界坐标, 量纲: 弧度
+	 */
+	const refcenter& GetWcsCenter() const {
+		return refwcs_;
+	}
+	/*!
+	 * @brief 查看世界样本数量与极限星等
+	 * @param maglim  极限星等. 未依据图像样本深度估计时为0
+	 */
+	int GetWcsSample(double& maglim) {
+		maglim = wcsmag_lim_;
+		return wcssample_;
+	}
 
 protected:
 	/* 功能 */
 	void sphere2plane(double l, double b, double &xi, double &eta);
+	void plane2sphere(double xi, double eta, double &l, double &b);
 
 	/*!
-	 * @brief 计算图像坐标系两点线段的距离和倾角
-	 * @param idc  中心ID
-	 * @param id   指向ID
-	 * @param len  线段长度
-	 * @param incl 倾角, 量纲: 角度
+	 * @brief 由样本对拟合定位解
+	 * @param sol  拟合结果. 拟合失败时内容不确定
+	 * @return
+	 * 拟合结果
+	 * @note
+	 * 分别尝试两种镜像关系, 选择残差较小者
 	 */
-	void calc_image_points(const int idc, const int id, double &len, double &incl);
+	bool fit_solution(solution& sol);
 	/*!
-	 * @brief 计算世界坐标系两点线段的距离和倾角
-	 * @param idc  中心ID
-	 * @param id   指向ID
-	 * @param len  线段长度
-	 * @param incl 倾角, 量纲: 角度
+	 * @brief 以样本位移投票修正定位解的指向
+	 * @param sol   定位解. 比例尺视为准确
+	 * @param cell  投票网格尺寸, 量纲: 像素
+	 * @return
+	 * 得票最多的位移的票数
+	 * @note
+	 * - 以定位解预测参考星样本的图像坐标, 图像样本与预测坐标两两相减, 在网格中投票
+	 * - 旋转角在先验附近分步搜索, 步长使图像边缘的位移偏差不超过网格尺寸
+	 * - 得票不少于3时, 以得票最多的旋转角和位移修正定位解
 	 */
-	void calc_wcs_points(const int idc, const int id, double &len, double &incl);
-
+	int estimate_shift(solution& sol, double cell);
 	/*!
-	 * @brief 依据参数尝试建立一个匹配单元
-	 * @param idc    中心ID
-	 * @param ido    指向ID
-	 * @param angle  楔形夹角
-	 * @param shape  建立的匹配单元
+	 * @brief 以定位解预测世界目标的图像坐标, 与最近的图像目标组成样本对
+	 * @param sol  定位解
+	 * @param r    搜索半径, 量纲: 像素. 不大于网格尺寸
 	 * @return
-	 * 建立结果
-	 * - true:  成功, 信息写入shape
-	 * - false: 失败
+	 * 亮样本中建立对应关系的数量
+	 */
+	int match_nearest(const solution& sol, double r);
+	/*!
+	 * @brief 建立图像目标的网格索引
+	 * @param cell  网格尺寸, 量纲: 像素
 	 */
-	bool build_wedge_image(const int idc, const int ido, double angle, wedge_shape &shape);
+	void build_grid(double cell);
 	/*!
-	 * @brief 以id为中心构建所有可能的匹配单元
-	 * @param angle 匹配单元夹角, 量纲: 角度
+	 * @brief 查找与图像坐标最近的图像目标
+	 * @param x  图像坐标
+	 * @param y  图像坐标
+	 * @param r  搜索半径, 不大于网格尺寸
 	 * @return
-	 * 构建结果
+	 * 最近图像目标ID. 搜索半径内没有目标时返回-1
 	 */
-	bool build_wedge_image(double angle);
+	int find_nearest(double x, double y, double r);
 
 	/*!
-	 * @brief 依据参数尝试建立一个匹配单元
-	 * @param idc    中心ID
-	 * @param ido    指向ID
-	 * @param angle  楔形夹角
-	 * @param shape  建立的匹配单元
+	 * @brief 依据图像样本深度选取世界系候选星
+	 * @param n  候选参考星数量. 前n颗参考星分布在以投影中心为圆心的圆形天区内
 	 * @return
-	 * 建立结果
-	 * - true:  成功, 匹配单元信息写入shape
-	 * - false: 失败
+	 * 极限星等以内的参考星数量. 这些参考星被移至前部
+	 * @note
+	 * 图像样本深度按天区面积换算为星表星数. 比例尺取下限, 图像天区面积最小, 换算的星数偏多,
+	 * 使图像中的对应星不被遗漏
 	 */
-	bool build_wedge_wcs(const int idc, const int ido, double angle, wedge_shape &shape);
+	int select_depth(int n);
 	/*!
-	 * @brief 以id为中心构建所有可能的匹配单元
-	 * @param angle 匹配单元夹角, 量纲: 角度
+	 * @brief 空间均匀选样的网格尺寸
 	 * @return
-	 * 构建结果
+	 * 图像网格尺寸, 量纲: 像素. 网格数量依据图像样本数量和每个网格的平均样本数.
+	 * 不划分网格时返回0
 	 */
-	bool build_wedge_wcs(double angle);
-
+	double sample_cell();
 	/*!
-	 * @brief 匹配图像系和世界系
-	 * @param shapeImg  图像系匹配单元
-	 * @param shapeWcs  世界系匹配单元
+	 * @brief 空间均匀选样: 从前n个目标中选取样本, 移至前部并按亮度递增排列
+	 * @param objs     目标集合
+	 * @param n        候选目标数量
+	 * @param nsample  样本数量上限
+	 * @param cell     网格尺寸, 与目标坐标量纲一致. 0: 不划分网格, 选取最亮的目标
 	 * @return
-	 * 匹配结果
+	 * 样本数量
+	 * @note
+	 * - 候选目标的包围盒划分为网格, 逐轮选取各网格中第1、2...亮的目标.
+	 *   最后一轮仅选取其中最亮的目标, 使样本数量不超过上限
+	 * - 以部分排序选取, 其余候选目标不排序
+	 * - 世界系网格以比例尺下限换算图像网格, 不大于图像网格对应的天区,
+	 *   图像样本对应的参考星在其网格中的亮度排序不低于图像样本
+	 */
+	template <class Obj>
+	int select_sample(std::vector<Obj>& objs, int n, int nsample, double cell);
+	/*!
+	 * @brief 使用指定精度的匹配引擎执行匹配
+	 * @param engine  匹配引擎
+	 * @return
+	 * 样本对数量
+	 */
+	template <typename T>
+	int match_engine(ShapeMatch<T>& engine);
+	/*!
+	 * @brief 宽比例尺范围: 在分档投票得到的比例尺附近重选参考星并复核
+	 * @param engine  已完成宽范围匹配的引擎
+	 * @param n       样本对数量
+	 * @param sol     定位解
+	 * @return
+	 * 复核结果
+	 * @note
+	 * - 宽范围的世界样本取自最大视场, 落入图像的样本偏少. 复核时仅保留
+	 *   该比例尺对应视场内的亮星, 比例尺范围收窄为得票最多的相邻三档
+	 * - 复核失败时恢复世界系目标的顺序和样本, 后续匹配仍使用宽范围样本
 	 */
-	bool match_wedge(const wedge_shape &shapeImg, const wedge_shape &shapeWcs);
+	template <typename T>
+	bool match_refine(ShapeMatch<T>& engine, int& n, solution& sol);
 };
 
 #endif /* MATCHREFSYS_H_ */
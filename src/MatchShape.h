@@ -1,13 +1,24 @@
 /**
  * @file MatchShape.h
  * @brief 定义: 用于匹配的模型
+ * @note
+ * 模型内样本特征按分量连续存储(SoA), 便于匹配时向量化比较
+ * MatchShapePool连续存储全部模型的样本特征, 匹配时按缓存尺寸分块读取
+ * MatchShapeQ16以16位定点存储全部模型的样本特征, 可选用于紧凑比较
  */
 
 #ifndef _MATCHSHAPE_H_
 #define _MATCHSHAPE_H_
 
+#include <cmath>
 #include <vector>
 
+/*!
+ * @struct MatchShape
+ * @brief 定义: 楔形匹配模型
+ * @tparam T 坐标精度: float或double
+ */
+template <typename T>
 struct MatchShape {
 	/*!
 	 * @struct Point
@@ -15,22 +26,36 @@ struct MatchShape {
 	 */
 	struct Point {
 		int id;				///< 样本ID
-		double len_normal;	///< 归算长度. |id - idc|/len
-		double incl_normal;	///< 归算倾角, 量纲: 角度. incl(id - idc)-incl
+		T len_normal;		///< 归算长度. |id - idc|/len
+		T incl_normal;		///< 归算倾角, 量纲: 角度. incl(id - idc)-incl
 	};
 
 	int idc;	///< 中心ID
 	int ido;	///< 指向ID
-	double len;	///< 距离: 指向-中心
-	double incl;///< 倾角: 指向-中心相对'X'轴的倾角, 量纲: 角度
-	std::vector<Point> pts;
+	T len;		///< 距离: 指向-中心
+	T incl;		///< 倾角: 指向-中心相对'X'轴的倾角, 量纲: 角度
+	std::vector<int> ids;			///< 样本ID
+	std::vector<T> len_normal;		///< 样本归算长度
+	std::vector<T> incl_normal;		///< 样本归算倾角
 
 public:
 	/*!
 	 * @brief 析构函数
 	 */
 	virtual ~MatchShape() {
-		pts.clear();
+		Reset();
+	}
+
+	/*!
+	 * @brief 将倾角差调整至[-180, +180)
+	 * @param incl  倾角差, 量纲: 角度
+	 * @return
+	 * 调整后倾角差
+	 */
+	static T NormalizeIncl(T incl) {
+		if (incl >= T(180)) incl -= T(360);
+		else if (incl < T(-180)) incl += T(360);
+		return incl;
 	}
 
 	/*!
@@ -39,19 +64,35 @@ public:
 	 * @param len   长度, |id - idc|
 	 * @param incl  倾角, 量纲: 角度. incl(id - idc)
 	 */
-	void AddPoint(int id, double len, double incl) {
+	void AddPoint(int id, T len, T incl) {
+		ids.push_back(id);
+		len_normal.push_back(len / this->len);
+		incl_normal.push_back(NormalizeIncl(incl - this->incl));
+	}
+
+	/*!
+	 * @brief 查看模型内的样本
+	 * @param i  样本在模型内的序号
+	 * @return
+	 * 样本特征
+	 */
+	Point GetPoint(int i) const {
 		Point pt;
-		pt.id = id;
-		pt.len_normal  = len / this->len;
-		pt.incl_normal = incl - this->incl;
-		pts.push_back(pt);
+		pt.id = ids[i];
+		pt.len_normal  = len_normal[i];
+		pt.incl_normal = incl_normal[i];
+		return pt;
 	}
 
 	/*!
 	 * @brief 清空匹配模型内的样本
+	 * @note
+	 * 保留已分配内存, 以便重复使用
 	 */
 	void Reset() {
-		pts.clear();
+		ids.clear();
+		len_normal.clear();
+		incl_normal.clear();
 	}
 
 	/*!
@@ -59,8 +100,8 @@ public:
 	 * @return
 	 * 检查结果
 	 */
-	bool IsEmpty() {
-		return pts.size() == 0;
+	bool IsEmpty() const {
+		return ids.size() == 0;
 	}
 
 	/*!
@@ -70,10 +111,142 @@ public:
 	 * @note
 	 * 不包含中心和指向
 	 */
-	int Count() {
-		return pts.size();
+	int Count() const {
+		return ids.size();
+	}
+};
+
+template <typename T>
+using MatchShapeVec = std::vector<MatchShape<T> >;
+
+/*!
+ * @struct MatchShapePool
+ * @brief 定义: 匹配模型特征池
+ * @tparam T 坐标精度: float或double
+ * @note
+ * - 全部匹配模型的样本特征按分量连续存储. 各模型样本的堆内存分散, 匹配时逐块读取连续特征池,
+ *   避免缓存行浪费和预取失效
+ * - 样本序号与匹配模型内的序号一致, 样本ID仍由匹配模型查看
+ */
+template <typename T>
+struct MatchShapePool {
+	std::vector<int> start;	///< 匹配模型样本在特征池中的起始位置, 共n+1项
+	std::vector<T> incl;	///< 样本归算倾角
+	std::vector<T> len;		///< 样本归算长度
+
+public:
+	/*!
+	 * @brief 检查特征池是否包含n个匹配模型
+	 */
+	bool Compatible(int n) const {
+		return int(start.size()) == n + 1;
+	}
+
+	/*!
+	 * @brief 由匹配模型构建特征池
+	 * @param shapes  匹配模型集合
+	 * @param n       有效匹配模型数量
+	 * @note
+	 * 保留已分配内存, 以便重复使用
+	 */
+	void Build(const MatchShapeVec<T>& shapes, int n) {
+		start.resize(n + 1);
+		incl.clear();
+		len.clear();
+		start[0] = 0;
+		for (int i = 0; i < n; ++i) {
+			const MatchShape<T>& shape = shapes[i];
+			incl.insert(incl.end(), shape.incl_normal.begin(), shape.incl_normal.end());
+			len.insert(len.end(), shape.len_normal.begin(), shape.len_normal.end());
+			start[i + 1] = incl.size();
+		}
+	}
+};
+
+/*!
+ * @struct MatchShapeQ16
+ * @brief 定义: 16位定点匹配模型特征池
+ * @note
+ * - 全部匹配模型的样本特征按分量连续存储, 每个样本4字节
+ * - 量化步长为容差的1/8. 倾角偏置32768, 归算长度无偏置, 均为无符号数
+ * - 特征差的绝对值由两次无符号饱和减法求得, 不溢出
+ * - 超出量化范围的特征记为哨兵值: 集合1为0, 集合2为65535, 与任何特征都不一致
+ */
+struct MatchShapeQ16 {
+	double qincl;	///< 倾角量化步长, 量纲: 角度
+	double qlen;	///< 归算长度量化步长
+	unsigned short tincl;	///< 倾角容差, 量纲: 量化步长
+	unsigned short tlen;	///< 归算长度容差, 量纲: 量化步长
+	std::vector<int> start;	///< 匹配模型样本在特征池中的起始位置, 共n+1项
+	std::vector<unsigned short> incl;	///< 样本归算倾角
+	std::vector<unsigned short> len;	///< 样本归算长度
+
+public:
+	MatchShapeQ16() {
+		qincl = qlen = 0.0;
+		tincl = tlen = 0;
+	}
+
+	/*!
+	 * @brief 由容差设置量化步长
+	 * @param dincl  倾角容差, 量纲: 角度
+	 * @param dlen   归算长度容差
+	 */
+	void SetTolerance(double dincl, double dlen) {
+		tincl = tlen = 8;
+		qincl = dincl / tincl;
+		qlen  = dlen / tlen;
+		// 倾角范围[-180, 180)须在量化范围内
+		if (qincl < 360.0 / 60000.0) {
+			qincl = 360.0 / 60000.0;
+			tincl = (unsigned short) (dincl / qincl + 0.5);
+		}
+	}
+
+	/*!
+	 * @brief 检查量化步长是否一致, 且特征池包含n个匹配模型
+	 */
+	bool Compatible(const MatchShapeQ16& other, int n) const {
+		return qincl == other.qincl && qlen == other.qlen && int(start.size()) == n + 1;
+	}
+
+	/*!
+	 * @brief 量化一个特征
+	 * @param x     特征
+	 * @param q     量化步长
+	 * @param bias  偏置
+	 * @param tol   容差, 量纲: 量化步长
+	 * @param set1  特征属于集合1
+	 */
+	static unsigned short Quantize(double x, double q, long bias, unsigned short tol, bool set1) {
+		long v = lround(x / q) + bias;
+		if (v < 2L * tol || v > 65535L - 2L * tol) return set1 ? 0 : 65535;
+		return (unsigned short) v;
+	}
+
+	/*!
+	 * @brief 由匹配模型构建特征池
+	 * @param shapes  匹配模型集合
+	 * @param n       有效匹配模型数量
+	 * @param set1    匹配模型属于集合1
+	 * @note
+	 * 保留已分配内存, 以便重复使用
+	 */
+	template <typename T>
+	void Build(const MatchShapeVec<T>& shapes, int n, bool set1) {
+		int i, j, m;
+		start.resize(n + 1);
+		incl.clear();
+		len.clear();
+		for (i = 0, start[0] = 0; i < n; ++i) {
+			const MatchShape<T>& shape = shapes[i];
+			for (j = 0, m = shape.Count(); j < m; ++j) {
+				incl.push_back(Quantize(shape.incl_normal[j], qincl, 32768, tincl, set1));
+				len.push_back(Quantize(shape.len_normal[j], qlen, 0, tlen, set1));
+			}
+			start[i + 1] = incl.size();
+		}
 	}
 };
-typedef std::vector<MatchShape> MatchShapeVec;
 
 #endif
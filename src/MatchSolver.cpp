@@ -0,0 +1,109 @@
+/**
+ * @file MatchSolver.cpp
+ * @brief 多帧并发解算: 共享只读的配置与星表侧模型, 每帧使用独立的会话
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include "ADefine.h"
+#include "BuildMatchShape.h"
+#include "MatchSolver.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+MatchSolver::MatchSolver(const ParamMatchShape& param, int w, int h, double scale_low, double scale_high)
+	: param_(param) {
+	wimg_ = w;
+	himg_ = h;
+	scale_low_  = scale_low;
+	scale_high_ = scale_high;
+	// 与MatchRefsys::BeginImportImageObject和DoMatch的阈值一致
+	double aimg_low = sqrt(double(w) * w + double(h) * h) * 0.126;
+	if (aimg_low < param.aimg_min) aimg_low = param.aimg_min;
+	awcs_low_ = scale_low * AS2R * aimg_low;
+}
+
+MatchSolver::~MatchSolver() {
+
+}
+
+MatchFieldPtr MatchSolver::BuildField(double ra, double dec, const CatStarVec& stars) const {
+	if (stars.size() < 5) return MatchFieldPtr();
+
+	/* 投影与选样复用MatchRefsys的世界系导入流程 */
+	MatchRefsys proj;
+	proj.SetParameter(param_);
+	proj.SetGuessScale(scale_low_, scale_high_);
+	proj.BeginImportImageObject(wimg_, himg_);	// 图像尺寸决定世界系选样网格
+	proj.BeginImportWcsObject(ra, dec);
+	for (CatStarVec::const_iterator it = stars.begin(); it != stars.end(); ++it)
+		proj.ImportWcsObject(it->ra, it->dec, it->mag);
+	proj.CompleteImportWcsObjectr();
+
+	shared_ptr<MatchField> field = make_shared<MatchField>();
+	field->refwcs.x  = ra * D2R;
+	field->refwcs.y  = dec * D2R;
+	field->objwcs    = proj.GetWcsObject();
+	double maglim;
+	field->wcssample = proj.GetWcsSample(maglim);
+	field->awcs_low  = awcs_low_;
+	field->use_float = param_.use_float;
+	field->quant.SetTolerance(param_.diff_incl_max, param_.diff_lnormal_max);
+	field->ids.resize(field->wcssample);
+	for (int i = 0; i < field->wcssample; ++i) field->ids[i] = i;
+
+	/* 世界系匹配单元 */
+	if (field->use_float) {
+		BuildMatchShape<float> builder;
+		PtMSVec<float> pts;
+		builder.SetAngle(float(param_.angle));
+		for (int i = 0; i < field->wcssample; ++i)
+			pts.push_back(PointMS<float>(i, float(field->objwcs[i].x), float(field->objwcs[i].y)));
+		field->nshape = builder.Build(pts, float(awcs_low_), field->shapes32);
+		if (param_.use_quant16) field->quant.Build(field->shapes32, field->nshape, false);
+		else field->pool32.Build(field->shapes32, field->nshape);
+	}
+	else {
+		BuildMatchShape<double> builder;
+		PtMSVec<double> pts;
+		builder.SetAngle(param_.angle);
+		for (int i = 0; i < field->wcssample; ++i)
+			pts.push_back(PointMS<double>(i, field->objwcs[i].x, field->objwcs[i].y));
+		field->nshape = builder.Build(pts, awcs_low_, field->shapes64);
+		if (param_.use_quant16) field->quant.Build(field->shapes64, field->nshape, false);
+		else field->pool64.Build(field->shapes64, field->nshape);
+	}
+	if (field->nshape < param_.shape_count_min) return MatchFieldPtr();
+
+	return field;
+}
+
+MatchSolver::SessionPtr MatchSolver::Acquire() {
+	MatchRefsys* session(NULL);
+	{
+		lock_guard<mutex> lck(mtx_pool_);
+		if (!idle_.empty()) {
+			session = idle_.back();
+			idle_.pop_back();
+		}
+		else {
+			sessions_.push_back(unique_ptr<MatchRefsys>(new MatchRefsys));
+			session = sessions_.back().get();
+			session->SetParameter(param_);
+			session->SetGuessScale(scale_low_, scale_high_);
+		}
+	}
+	return SessionPtr(session, [this](MatchRefsys* x) { release(x); });
+}
+
+int MatchSolver::SessionCount() {
+	lock_guard<mutex> lck(mtx_pool_);
+	return sessions_.size();
+}
+
+void MatchSolver::release(MatchRefsys* session) {
+	lock_guard<mutex> lck(mtx_pool_);
+	idle_.push_back(session);
+}
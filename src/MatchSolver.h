@@ -0,0 +1,126 @@
+/**
+ * @file MatchSolver.h
+ * @brief 多帧并发解算: 共享只读的配置与星表侧模型, 每帧使用独立的会话
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 函数调用流程:
+ * - MatchSolver: 由参数、图像尺寸和比例尺范围创建, 此后只读
+ * - BuildField: 由参考星建立星表侧模型, 可被任意数量的会话共享
+ * - Acquire: 从会话池获取会话. 会话是已配置的MatchRefsys, 其内存在复用时保留
+ * - 会话: BeginImportImageObject ... CompleteImportImageObject, DoMatch(field)
+ * - 会话释放时自动归还会话池
+ * @note
+ * 星表侧模型建立时尚无图像, 且被多帧共享, 不按图像样本深度选取参考星(Sample.depth不适用).
+ * 世界样本为空间均匀选取的亮星
+ */
+
+#ifndef MATCHSOLVER_H_
+#define MATCHSOLVER_H_
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include "ACatalog.h"
+#include "MatchRefsys.h"
+
+/*!
+ * @struct MatchField
+ * @brief 星表侧模型: 一个指向的参考星投影及其楔形匹配单元
+ * @note
+ * 建立后只读, 可被多个会话并发使用
+ */
+struct MatchField {
+	MatchRefsys::refcenter refwcs;	///< 投影中心, 量纲: 弧度
+	MatchRefsys::ObjWcsVec objwcs;	///< 参考星, 按星等递增排列
+	int wcssample;					///< 参与匹配的参考星数量
+	double awcs_low;				///< 构建匹配单元时定向点的最小中心距
+	bool use_float;					///< 匹配单元精度
+	std::vector<int> ids;			///< 匹配单元中样本ID对应的参考星
+	MatchShapeVec<float>  shapes32;	///< 单精度匹配单元
+	MatchShapeVec<double> shapes64;	///< 双精度匹配单元
+	int nshape;						///< 有效匹配单元数量
+	MatchShapePool<float>  pool32;	///< 单精度特征池
+	MatchShapePool<double> pool64;	///< 双精度特征池
+	MatchShapeQ16 quant;			///< 16位定点特征池. 仅在启用定点特征时建立
+
+public:
+	const MatchShapeVec<float>& Shapes(float) const {
+		return shapes32;
+	}
+
+	const MatchShapeVec<double>& Shapes(double) const {
+		return shapes64;
+	}
+
+	const MatchShapePool<float>& Pool(float) const {
+		return pool32;
+	}
+
+	const MatchShapePool<double>& Pool(double) const {
+		return pool64;
+	}
+};
+typedef std::shared_ptr<const MatchField> MatchFieldPtr;
+
+class MatchSolver {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param param       参数
+	 * @param w           图像宽度
+	 * @param h           图像高度
+	 * @param scale_low   像元比例尺下限, 量纲: 角秒/像素
+	 * @param scale_high  像元比例尺上限, 量纲: 角秒/像素
+	 */
+	MatchSolver(const ParamMatchShape& param, int w, int h, double scale_low, double scale_high);
+	virtual ~MatchSolver();
+
+public:
+	typedef std::shared_ptr<MatchRefsys> SessionPtr;
+
+protected:
+	/* 只读配置 */
+	ParamMatchShape param_;		//< 参数
+	int wimg_, himg_;			//< 图像宽度和高度
+	double scale_low_;			//< 像元比例尺下限, 量纲: 角秒/像素
+	double scale_high_;			//< 像元比例尺上限, 量纲: 角秒/像素
+	double awcs_low_;			//< 世界系定向点的最小中心距, 量纲: 弧度
+
+	/* 会话池 */
+	std::mutex mtx_pool_;		//< 会话池互斥锁
+	std::vector<std::unique_ptr<MatchRefsys> > sessions_;	//< 全部会话
+	std::vector<MatchRefsys*> idle_;	//< 空闲会话
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 由参考星建立星表侧模型
+	 * @param ra     投影中心赤经, 量纲: 角度
+	 * @param dec    投影中心赤纬, 量纲: 角度
+	 * @param stars  参考星
+	 * @return
+	 * 星表侧模型. 参考星或匹配单元不足时返回空指针
+	 * @note
+	 * 可被多个线程并发调用
+	 */
+	MatchFieldPtr BuildField(double ra, double dec, const AstroUtil::CatStarVec& stars) const;
+	/*!
+	 * @brief 从会话池获取会话
+	 * @return
+	 * 已配置的会话. 会话释放时归还会话池, 会话池应在全部会话释放后销毁
+	 */
+	SessionPtr Acquire();
+	/*!
+	 * @brief 查看已创建的会话数量
+	 */
+	int SessionCount();
+
+protected:
+	/*!
+	 * @brief 归还会话
+	 */
+	void release(MatchRefsys* session);
+};
+
+#endif /* MATCHSOLVER_H_ */
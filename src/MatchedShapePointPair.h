@@ -79,15 +79,17 @@ public:
 	bool GetHitPoint(int &id2, double &ratio) {
 		int n(pts.size());
 		if (!n) return false;
-		int maxhit(pts[0].hit), sechit(1);
+		int maxhit(pts[0].hit), sechit(1), hit;
 
 		id2 = pts[0].id;
 		for (int i = 1; i < n; ++i) {
-			if (maxhit < pts[i].hit) {
-				sechit = maxhit;
-				maxhit = pts[i].hit;
+			if (maxhit < (hit = pts[i].hit)) {
+				if (sechit < maxhit) sechit = maxhit;
+				maxhit = hit;
 				id2    = pts[i].id;
 			}
+			else if (sechit < hit)
+				sechit = hit;
 		}
 		ratio = double(maxhit) / sechit;
 		return true;
@@ -8,64 +8,56 @@
 
 #include <string.h>
 #include <math.h>
+#include <cmath>
 #include <vector>
 #include <algorithm>
 
 /*!
  * @struct MatchingShapePoint
  * @brief 定义: 用于模型匹配的样本
+ * @tparam T 坐标精度: float或double
  */
-typedef struct MatchingShapePoint {
+template <typename T>
+struct MatchingShapePoint {
 	int id;		///< 编号
-	double x, y;///< 坐标
-	double z;	///< 亮度
+	T x, y;		///< 坐标
+	T z;		///< 亮度
 
 public:
 	MatchingShapePoint() {
 		id = 0;
-		x = y = z = 0.0;
+		x = y = z = T(0);
 	}
 
 	MatchingShapePoint(int _id) {
 		id = _id;
-		x = y = z = 0.0;
+		x = y = z = T(0);
 	}
 
-	MatchingShapePoint(int _id, double _x, double _y) {
+	MatchingShapePoint(int _id, T _x, T _y) {
 		id = _id;
 		x  = _x;
 		y  = _y;
-		z  =  0.0;
+		z  = T(0);
 	}
 
-	MatchingShapePoint(int _id, double _x, double _y, double _z) {
+	MatchingShapePoint(int _id, T _x, T _y, T _z) {
 		id = _id;
 		x  = _x;
 		y  = _y;
 		z  = _z;
 	}
 
-	/*!
-	 * @brief 重定义操作符=, 复制对象数据
-	 * @param other 待复制对象
-	 * @return
-	 * 实例对象
-	 */
-	MatchingShapePoint& operator=(const MatchingShapePoint& other) {
-		if (this != &x) memcpy(this, &other, sizeof(MatchingShapePoint));
-		return *this;
-	}
-
 	/*!
 	 * @brief 重定义操作符-, 计算两点之间的距离
 	 * @param other  被减数
 	 * @return
 	 * 两点之间距离
 	 */
-	double operator-(const MatchingShapePoint& other) {
-		double dx = x - other.x;
-		double dy = y - other.y;
-		return sqrt(dx * dx + dy * dy);
+	T operator-(const MatchingShapePoint& other) const {
+		T dx = x - other.x;
+		T dy = y - other.y;
+		return std::sqrt(dx * dx + dy * dy);
 	}
 
 	/*!
@@ -74,20 +66,24 @@ public:
 	 * @return
 	 * 倾角, 量纲: 弧度, 有效范围: \f$[-\pi, +\pi]\f$
 	 */
-	double operator/(const MatchingShapePoint& other) {
-		double dx = x - other.x;
-		double dy = y - other.y;
-		return atan2(dy, dx);
+	T operator/(const MatchingShapePoint& other) const {
+		T dx = x - other.x;
+		T dy = y - other.y;
+		return std::atan2(dy, dx);
 	}
-} PointMS;
-typedef std::vector<PointMS> PtMSVec;
+};
+template <typename T>
+using PointMS = MatchingShapePoint<T>;
+template <typename T>
+using PtMSVec = std::vector<PointMS<T> >;
 
 /*!
  * @struct MatchingShapePointSet
  * @brief 定义: 用于模型匹配的样本集合
  */
-typedef struct MatchingShapePointSet {
-	PtMSVec pts;
+template <typename T>
+struct MatchingShapePointSet {
+	PtMSVec<T> pts;
 
 public:
 	virtual ~MatchingShapePointSet() {
@@ -98,8 +94,8 @@ public:
 	 * @brief 按照数据结构中的z值升序排序
 	 */
 	void SortAscend() {
-		std::stable_sort(pts.begin(), pts.end(), [](const PointMS& pt1, const PointMS& pt2) {
-			return (pt1.z <= pt2.z);
+		std::stable_sort(pts.begin(), pts.end(), [](const PointMS<T>& pt1, const PointMS<T>& pt2) {
+			return (pt1.z < pt2.z);
 		});
 	}
 
@@ -107,8 +103,8 @@ public:
 	 * @brief 按照数据中的z值降序排序
 	 */
 	void SortDescend() {
-		std::stable_sort(pts.begin(), pts.end(), [](const PointMS& pt1, const PointMS& pt2) {
-			return (pt1.z >= pt2.z);
+		std::stable_sort(pts.begin(), pts.end(), [](const PointMS<T>& pt1, const PointMS<T>& pt2) {
+			return (pt1.z > pt2.z);
 		});
 	}
 
@@ -123,7 +119,7 @@ public:
 	 * @brief 新增一个样本
 	 * @param pt  样本
 	 */
-	void AddPoint(PointMS& pt) {
+	void AddPoint(const PointMS<T>& pt) {
 		pts.push_back(pt);
 	}
 
@@ -141,9 +137,11 @@ public:
 	 * @return
 	 * 样本集合实例地址
 	 */
-	PtMSVec& operator()() {
+	PtMSVec<T>& operator()() {
 		return pts;
 	}
-} PointMSSet;
+};
+template <typename T>
+using PointMSSet = MatchingShapePointSet<T>;
 
 #endif
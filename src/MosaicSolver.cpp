@@ -0,0 +1,319 @@
+/**
+ * @file MosaicSolver.cpp
+ * @brief 拼接相机解算: 全部芯片共享一次星表查询, 芯片并发解算, 以联合解检验各芯片
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include "ADefine.h"
+#include "MosaicSolver.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+/* 以(l0, b0)为中心的切平面投影. 量纲: 弧度 */
+static void sphere2plane(double l0, double b0, double l, double b, double &xi, double &eta) {
+	double fract = sin(b0) * sin(b) + cos(b0) * cos(b) * cos(l - l0);
+	xi  = cos(b) * sin(l - l0) / fract;
+	eta = (cos(b0) * sin(b) - sin(b0) * cos(b) * cos(l - l0)) / fract;
+}
+
+static void plane2sphere(double l0, double b0, double xi, double eta, double &l, double &b) {
+	double fract = cos(b0) - eta * sin(b0);
+	l = cyclemod(l0 + atan2(xi, fract), A2PI);
+	b = atan2((eta * cos(b0) + sin(b0)) * cos(l - l0), fract);
+}
+
+MosaicSolver::MosaicSolver(const ParamMatchShape& param, const vector<MosaicChip>& chips,
+		double scale_low, double scale_high)
+	: param_(param), chips_(chips) {
+	param_.use_stdprint = false;	// 避免多个会话的输出交错
+	scale_low_  = scale_low;
+	scale_high_ = scale_high;
+	rotation_   = param.mosaic_rotation * D2R;
+	tolerance_  = param.mosaic_tolerance;
+	ra0_ = dec0_ = 0.0;
+	a_ = b_ = c_ = d_ = 0.0;
+
+	/* 焦面包围盒与包围圆 */
+	double xmin(0.0), xmax(0.0), ymin(0.0), ymax(0.0), x, y;
+	size_t k;
+	int i;
+	xm_ = ym_ = 0.0;
+	for (k = 0; k < chips_.size(); ++k) {
+		const MosaicChip& chip = chips_[k];
+		for (i = 0; i < 4; ++i) {
+			chip2focal(chip, (i & 1) * chip.w, (i >> 1) * chip.h, x, y);
+			if ((!k && !i) || x < xmin) xmin = x;
+			if ((!k && !i) || x > xmax) xmax = x;
+			if ((!k && !i) || y < ymin) ymin = y;
+			if ((!k && !i) || y > ymax) ymax = y;
+		}
+	}
+	xm_ = (xmin + xmax) * 0.5;
+	ym_ = (ymin + ymax) * 0.5;
+	radius_ = 0.0;
+	for (k = 0; k < chips_.size(); ++k) {
+		const MosaicChip& chip = chips_[k];
+		for (i = 0; i < 4; ++i) {
+			chip2focal(chip, (i & 1) * chip.w, (i >> 1) * chip.h, x, y);
+			if (sqrt(x * x + y * y) > radius_) radius_ = sqrt(x * x + y * y);
+		}
+		solvers_.push_back(unique_ptr<MatchSolver>(new MatchSolver(param_, chip.w, chip.h, scale_low, scale_high)));
+	}
+	results_.resize(chips_.size());
+	sessions_.resize(chips_.size());
+}
+
+MosaicSolver::~MosaicSolver() {
+	sessions_.clear();	// 会话先于会话池释放
+}
+
+double MosaicSolver::Radius() const {
+	return radius_ * scale_high_ * 1.02 / 60.0;
+}
+
+void MosaicSolver::Footprint(double ra, double dec, cat_footprint& fp) const {
+	double scale = scale_high_ * 1.02 / 60.0;
+	double cr(cos(rotation_)), sr(sin(rotation_)), u, v;
+	vector<double> x, y;
+
+	for (size_t k = 0; k < chips_.size(); ++k) {
+		const MosaicChip& chip = chips_[k];
+		for (int i = 0; i < 4; ++i) {
+			chip2focal(chip, (i & 1) * chip.w, (i >> 1) * chip.h, u, v);
+			x.push_back(scale * (u * cr - v * sr));
+			y.push_back(scale * (u * sr + v * cr));
+		}
+	}
+	fp.SetPolygon(ra, dec, x.data(), y.data(), x.size(), param_.footprint_margin);
+}
+
+int MosaicSolver::Solve(double ra, double dec, const CatStarVec& stars, const ChipLoader& load, int nthread) {
+	int n(chips_.size()), k, nverified(0);
+
+	ra0_  = ra * D2R;
+	dec0_ = dec * D2R;
+	joint_ = MatchRefsys::solution();
+	for (k = 0; k < n; ++k) results_[k] = MosaicChipResult();
+
+	/* 各芯片独立解算 */
+	parallel(n, nthread, [&](int i) { solve_chip(i, stars, load); });
+	/* 联合解预测不一致芯片的先验, 重新解算 */
+	if (fit_joint()) {
+		parallel(n, nthread, [this](int i) {
+			if (!results_[i].verified) recover_chip(i);
+		});
+	}
+	/* 以全部芯片重新拟合联合解, 检验各芯片 */
+	int njoint = fit_joint();
+	for (k = 0; k < n; ++k) {
+		if (njoint < 2) results_[k].verified = false;	// 单个芯片无法检验
+		if (results_[k].verified) ++nverified;
+	}
+	sessions_.assign(n, MatchSolver::SessionPtr());
+
+	return nverified;
+}
+
+void MosaicSolver::parallel(int n, int nthread, const function<void (int)>& task) {
+	atomic<int> next(0);
+	vector<thread> workers;
+
+	if (nthread > n) nthread = n;
+	if (nthread < 1) nthread = 1;
+	for (int k = 0; k < nthread; ++k) {
+		workers.push_back(thread([&]() {
+			for (int i = next++; i < n; i = next++) task(i);
+		}));
+	}
+	for (size_t k = 0; k < workers.size(); ++k) workers[k].join();
+}
+
+void MosaicSolver::chip2focal(const MosaicChip& chip, double x, double y, double& u, double& v) const {
+	double cr(cos(chip.rotation * D2R)), sr(sin(chip.rotation * D2R));
+	u = chip.x0 + x * cr - y * sr - xm_;
+	v = chip.y0 + x * sr + y * cr - ym_;
+}
+
+void MosaicSolver::solve_chip(int k, const CatStarVec& stars, const ChipLoader& load) {
+	const MosaicChip& chip = chips_[k];
+	MosaicChipResult& rslt = results_[k];
+
+	/* 以标称几何和比例尺几何中心预测芯片中心 */
+	double u, v, xi, eta, ra, dec;
+	double g = sqrt(scale_low_ * scale_high_);
+	double scale = g * AS2R;
+	chip2focal(chip, chip.w * 0.5, chip.h * 0.5, u, v);
+	xi  = scale * (u * cos(rotation_) - v * sin(rotation_));
+	eta = scale * (u * sin(rotation_) + v * cos(rotation_));
+	plane2sphere(ra0_, dec0_, xi, eta, ra, dec);
+
+	/* 芯片视场内的参考星. 半径计入比例尺和旋转角不确定引起的中心偏差:
+	 * 比例尺偏离几何中心, 偏差不超过d*max(high-g, g-low);
+	 * 旋转角偏离标称值不超过footprint_margin, 偏差不超过弦长d*high*2*sin(margin/2)
+	 */
+	double d = sqrt(u * u + v * v);
+	double margin = param_.footprint_margin < 180.0 ? param_.footprint_margin : 180.0;
+	double dscale = scale_high_ - g > g - scale_low_ ? scale_high_ - g : g - scale_low_;
+	double r = (sqrt(double(chip.w) * chip.w + double(chip.h) * chip.h) * 0.5 * scale_high_ * 1.02
+			+ d * dscale + d * scale_high_ * 2.0 * sin(margin * 0.5 * D2R)) * AS2R;
+	double sd0(sin(dec)), cd0(cos(dec)), cosr(cos(r));
+	CatStarVec chipstars;
+	for (CatStarVec::const_iterator it = stars.begin(); it != stars.end(); ++it) {
+		double l(it->ra * D2R), b(it->dec * D2R);
+		if (sin(b) * sd0 + cos(b) * cd0 * cos(l - ra) >= cosr) chipstars.push_back(*it);
+	}
+
+	MatchFieldPtr field = solvers_[k]->BuildField(ra * R2D, dec * R2D, chipstars);
+	if (!field) return;
+	MatchSolver::SessionPtr session = solvers_[k]->Acquire();
+	if (load(chip, *session) < 5) return;
+	if ((rslt.solved = session->DoMatch(*field))) rslt.sol = session->GetSolution();
+	sessions_[k] = session;
+}
+
+void MosaicSolver::recover_chip(int k) {
+	const MosaicChip& chip = chips_[k];
+	MosaicChipResult& rslt = results_[k];
+	MatchSolver::SessionPtr session = sessions_[k];
+	if (!session) return;
+
+	/* 联合解预测芯片中心、比例尺和旋转角 */
+	MatchRefsys::solution prior(joint_);
+	double u, v, ra, dec;
+	chip2focal(chip, chip.w * 0.5, chip.h * 0.5, u, v);
+	u *= joint_.parity;
+	plane2sphere(ra0_, dec0_, a_ * u - b_ * v + c_, b_ * u + a_ * v + d_, ra, dec);
+	prior.ra  = ra * R2D;
+	prior.dec = dec * R2D;
+	prior.rotation = joint_.rotation + joint_.parity * chip.rotation;
+
+	if (session->DoTrack(prior)) {
+		rslt.solved    = true;
+		rslt.recovered = true;
+		rslt.sol       = session->GetSolution();
+	}
+}
+
+int MosaicSolver::fit_joint() {
+	int n(chips_.size()), k, worst, nuse(0);
+	vector<char> use(n, 0);
+	bool fitted(false);
+
+	for (k = 0; k < n; ++k) {
+		if ((use[k] = results_[k].solved)) ++nuse;
+	}
+	while (nuse && (fitted = fit_once(use))) {
+		for (k = 0, worst = -1; k < n; ++k) {
+			if (use[k] && (worst < 0 || results_[k].rms_joint > results_[worst].rms_joint)) worst = k;
+		}
+		if (results_[worst].rms_joint <= tolerance_) break;
+		use[worst] = 0;
+		--nuse;
+	}
+	if (!fitted) nuse = 0;
+	for (k = 0; k < n; ++k) {
+		results_[k].verified = nuse && results_[k].solved && results_[k].rms_joint >= 0.0
+				&& results_[k].rms_joint <= tolerance_;
+	}
+	return nuse;
+}
+
+bool MosaicSolver::fit_once(const vector<char>& use) {
+	/* 样本对: 焦面坐标与投影平面坐标 */
+	struct joint_pair {
+		int chip;
+		double u, v;	// 焦面坐标, 量纲: 像素
+		double p, q;	// 投影平面坐标, 量纲: 弧度
+	};
+	vector<joint_pair> pairs;
+	joint_pair pair;
+	int nchip(chips_.size()), k, i;
+
+	for (k = 0; k < nchip; ++k) {
+		results_[k].rms_joint = -1.0;
+		if (!results_[k].solved || !sessions_[k]) continue;
+		const PtPairMSVec& matched = sessions_[k]->GetMatchedPair();
+		const MatchRefsys::ObjImgVec& objimg = sessions_[k]->GetImageObject();
+		const MatchRefsys::ObjWcsVec& objwcs = sessions_[k]->GetWcsObject();
+		pair.chip = k;
+		for (i = 0; i < int(matched.size()); ++i) {
+			chip2focal(chips_[k], objimg[matched[i].id1].x, objimg[matched[i].id1].y, pair.u, pair.v);
+			sphere2plane(ra0_, dec0_, objwcs[matched[i].id2].l, objwcs[matched[i].id2].b, pair.p, pair.q);
+			pairs.push_back(pair);
+		}
+	}
+
+	/* 最小二乘: 与MatchRefsys::fit_solution相同, 去均值后求解相似变换 */
+	int n(0), parity;
+	double best(-1.0);
+	for (parity = 1; parity >= -1; parity -= 2) {
+		double mx(0.0), my(0.0), mp(0.0), mq(0.0);
+		double suu(0.0), sa(0.0), sb(0.0), u, v, p, q;
+		for (i = 0, n = 0; i < int(pairs.size()); ++i) {
+			if (!use[pairs[i].chip]) continue;
+			mx += parity * pairs[i].u;
+			my += pairs[i].v;
+			mp += pairs[i].p;
+			mq += pairs[i].q;
+			++n;
+		}
+		if (n < 3) return false;
+		mx /= n, my /= n, mp /= n, mq /= n;
+		for (i = 0; i < int(pairs.size()); ++i) {
+			if (!use[pairs[i].chip]) continue;
+			u = parity * pairs[i].u - mx;
+			v = pairs[i].v - my;
+			p = pairs[i].p - mp;
+			q = pairs[i].q - mq;
+			suu += u * u + v * v;
+			sa  += u * p + v * q;
+			sb  += u * q - v * p;
+		}
+		if (suu <= 0.0) return false;
+		double a(sa / suu), b(sb / suu);
+		double c(mp - a * mx + b * my), d(mq - b * mx - a * my);
+		double s(sqrt(a * a + b * b)), res(0.0);
+		for (i = 0; i < int(pairs.size()); ++i) {
+			if (!use[pairs[i].chip]) continue;
+			u = parity * pairs[i].u;
+			p = a * u - b * pairs[i].v + c - pairs[i].p;
+			q = b * u + a * pairs[i].v + d - pairs[i].q;
+			res += p * p + q * q;
+		}
+		res = sqrt(res / n) / s;
+		if (best < 0.0 || res < best) {
+			best = res;
+			a_ = a, b_ = b, c_ = c, d_ = d;
+			plane2sphere(ra0_, dec0_, c, d, joint_.ra, joint_.dec);
+			joint_.ra      *= R2D;
+			joint_.dec     *= R2D;
+			joint_.scale    = s * R2AS;
+			joint_.rotation = atan2(b, a) * R2D;
+			joint_.parity   = parity;
+			joint_.rms      = res;
+			joint_.matched  = n;
+		}
+	}
+
+	/* 各芯片在联合解下的残差 */
+	vector<double> res(nchip, 0.0);
+	vector<int> cnt(nchip, 0);
+	double s = sqrt(a_ * a_ + b_ * b_), u, p, q;
+	for (i = 0; i < int(pairs.size()); ++i) {
+		const joint_pair& x = pairs[i];
+		u = joint_.parity * x.u;
+		p = a_ * u - b_ * x.v + c_ - x.p;
+		q = b_ * u + a_ * x.v + d_ - x.q;
+		res[x.chip] += p * p + q * q;
+		++cnt[x.chip];
+	}
+	for (k = 0; k < nchip; ++k) {
+		if (cnt[k]) results_[k].rms_joint = sqrt(res[k] / cnt[k]) / s;
+	}
+	return true;
+}
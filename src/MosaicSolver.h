@@ -0,0 +1,182 @@
+/**
+ * @file MosaicSolver.h
+ * @brief 拼接相机解算: 全部芯片共享一次星表查询, 芯片并发解算, 以联合解检验各芯片
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 函数调用流程:
+ * - MosaicSolver: 由参数、芯片标称几何和比例尺范围创建
+ * - Radius: 拼接视场半径. 以该半径查询一次星表, 得到全部芯片共享的参考星
+ * - Footprint: 拼接视场的查询区域. 焦面旋转角已知时代替Radius, 仅查询芯片所在范围
+ * - Solve: 各芯片在线程池中并发解算, 拟合联合解, 以联合解检验各芯片并重新解算不一致的芯片
+ * - GetJoint, GetChip: 查看联合解和各芯片的结果
+ * @note
+ * 焦面坐标以像素为量纲, 芯片像素(x, y)在焦面中的位置为:
+ *   X = x0 + x * cos(rotation) - y * sin(rotation)
+ *   Y = y0 + x * sin(rotation) + y * cos(rotation)
+ * 联合解以焦面包围盒中心为参考点, 其定义与MatchRefsys::solution相同
+ */
+
+#ifndef MOSAICSOLVER_H_
+#define MOSAICSOLVER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "MatchSolver.h"
+
+/*!
+ * @struct MosaicChip
+ * @brief 芯片标称几何
+ */
+struct MosaicChip {
+	std::string filepath;	///< 星像列表文件路径
+	int w, h;				///< 图像宽度和高度
+	double x0, y0;			///< 芯片像素(0, 0)在焦面中的位置, 量纲: 像素
+	double rotation;		///< 芯片相对焦面的旋转角, 量纲: 角度
+};
+
+/*!
+ * @struct MosaicChipResult
+ * @brief 芯片解算结果
+ */
+struct MosaicChipResult {
+	bool solved;		///< 芯片已解算
+	bool recovered;		///< 以联合解预测的先验重新解算
+	bool verified;		///< 芯片解与联合解一致
+	double rms_joint;	///< 芯片样本对在联合解下的残差, 量纲: 像素
+	MatchRefsys::solution sol;	///< 芯片定位解
+
+public:
+	MosaicChipResult() {
+		solved = recovered = verified = false;
+		rms_joint = -1.0;
+	}
+};
+
+class MosaicSolver {
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param param       参数. 使用Mosaic段的标称旋转角和一致性阈值
+	 * @param chips       芯片标称几何
+	 * @param scale_low   像元比例尺下限, 量纲: 角秒/像素
+	 * @param scale_high  像元比例尺上限, 量纲: 角秒/像素
+	 */
+	MosaicSolver(const ParamMatchShape& param, const std::vector<MosaicChip>& chips,
+			double scale_low, double scale_high);
+	virtual ~MosaicSolver();
+
+public:
+	/*!
+	 * @brief 加载芯片星像
+	 * @param chip     芯片标称几何
+	 * @param session  会话. 由BeginImportImageObject ... CompleteImportImageObject导入星像
+	 * @return
+	 * 星像数量
+	 */
+	typedef std::function<int (const MosaicChip& chip, MatchRefsys& session)> ChipLoader;
+
+protected:
+	/* 配置 */
+	ParamMatchShape param_;			//< 参数
+	std::vector<MosaicChip> chips_;	//< 芯片标称几何
+	double scale_low_;				//< 像元比例尺下限, 量纲: 角秒/像素
+	double scale_high_;				//< 像元比例尺上限, 量纲: 角秒/像素
+	double rotation_;				//< 焦面标称旋转角, 量纲: 弧度
+	double tolerance_;				//< 芯片与联合解一致的残差阈值, 量纲: 像素
+	double xm_, ym_;				//< 焦面包围盒中心, 量纲: 像素
+	double radius_;					//< 焦面包围圆半径, 量纲: 像素
+	std::vector<std::unique_ptr<MatchSolver> > solvers_;	//< 各芯片的会话池
+
+	/* 解算 */
+	double ra0_, dec0_;				//< 投影中心, 量纲: 弧度
+	std::vector<MatchSolver::SessionPtr> sessions_;	//< 各芯片的会话, 解算期间保留
+	std::vector<MosaicChipResult> results_;			//< 各芯片的解算结果
+	MatchRefsys::solution joint_;	//< 联合解
+	double a_, b_, c_, d_;			//< 联合解的相似变换系数
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 查看拼接视场半径
+	 * @return
+	 * 以比例尺上限计算的焦面包围圆半径, 量纲: 角分
+	 */
+	double Radius() const;
+	/*!
+	 * @brief 查看拼接视场的查询区域
+	 * @param ra   焦面中心赤经, 估计值, 量纲: 角度
+	 * @param dec  焦面中心赤纬, 估计值, 量纲: 角度
+	 * @param fp   查询区域
+	 * @note
+	 * 区域为全部芯片角点的凸包, 以比例尺上限和焦面标称旋转角投影, 旋转角不确定度取参数
+	 * footprint_margin. 不确定度不小于90度时为包围圆
+	 */
+	void Footprint(double ra, double dec, AstroUtil::cat_footprint& fp) const;
+	/*!
+	 * @brief 解算全部芯片
+	 * @param ra       焦面中心赤经, 估计值, 量纲: 角度
+	 * @param dec      焦面中心赤纬, 估计值, 量纲: 角度
+	 * @param stars    拼接视场内的参考星
+	 * @param load     芯片星像加载接口, 在工作线程中调用
+	 * @param nthread  线程数
+	 * @return
+	 * 与联合解一致的芯片数量
+	 */
+	int Solve(double ra, double dec, const AstroUtil::CatStarVec& stars, const ChipLoader& load, int nthread);
+	/*!
+	 * @brief 查看联合解
+	 */
+	const MatchRefsys::solution& GetJoint() const {
+		return joint_;
+	}
+	/*!
+	 * @brief 查看芯片数量
+	 */
+	int ChipCount() const {
+		return chips_.size();
+	}
+	/*!
+	 * @brief 查看芯片解算结果
+	 */
+	const MosaicChipResult& GetChip(int k) const {
+		return results_[k];
+	}
+
+protected:
+	/*!
+	 * @brief 在线程池中为[0, n)的每个编号执行任务
+	 */
+	void parallel(int n, int nthread, const std::function<void (int)>& task);
+	/*!
+	 * @brief 计算芯片像素在焦面中相对包围盒中心的位置
+	 */
+	void chip2focal(const MosaicChip& chip, double x, double y, double& u, double& v) const;
+	/*!
+	 * @brief 以标称几何独立解算芯片
+	 */
+	void solve_chip(int k, const AstroUtil::CatStarVec& stars, const ChipLoader& load);
+	/*!
+	 * @brief 以联合解预测的先验重新解算芯片
+	 */
+	void recover_chip(int k);
+	/*!
+	 * @brief 以已解算芯片的样本对拟合联合解
+	 * @return
+	 * 参与拟合的芯片数量
+	 * @note
+	 * 逐次剔除残差最大且超过阈值的芯片, 直至其余芯片均与联合解一致
+	 */
+	int fit_joint();
+	/*!
+	 * @brief 拟合联合解, 并计算各芯片在联合解下的残差
+	 * @param use  参与拟合的芯片
+	 * @return
+	 * 拟合结果
+	 */
+	bool fit_once(const std::vector<char>& use);
+};
+
+#endif /* MOSAICSOLVER_H_ */
@@ -53,10 +53,230 @@ struct ParamMatchShape {
 	  \endverbatim
 	 */
 	double scale_high;
+	/*!
+	 * @brief 比例尺分档宽度, 即ln(比例尺)的档宽
+	 * - 候选匹配单元对按比例尺分档计分, 仅得分最高的相邻三档参与投票
+	 * - 宽范围匹配失败时, 在得分最高的比例尺附近重选参考星复核
+	 * - 比例尺范围不超过三档时, 全部候选参与投票
+	 */
+	double scale_bucket;
 	/*!
 	 * @brief 星表文件路径
 	 */
 	std::string pathcat;
+	/*!
+	 * @brief 内存映射星表的常驻内存预算, 量纲: MB. 0表示不限制
+	 */
+	int cat_budget;
+	/*!
+	 * @brief 内存映射星表的星等上限
+	 * - 子天区内按星等排列, 查找遇到更暗的恒星即停止该子天区, 减少深星表的访问量
+	 * - 其它格式的星表不使用该参数
+	 */
+	double cat_maglim;
+	/*!
+	 * @brief 盲匹配时后台预取参考星的天区数量
+	 */
+	int cat_prefetch;
+	/*!
+	 * @brief 图像X轴相对投影平面xi轴的旋转角, 估计值, 量纲: 角度
+	 * - 以视场矩形代替外接圆查询参考星
+	 */
+	double footprint_rotation;
+	/*!
+	 * @brief 旋转角估计值的不确定度, 量纲: 角度
+	 * - 查询区域为矩形在±margin内旋转扫过区域的凸包
+	 * - 不小于90: 旋转角未知, 以外接圆查询
+	 */
+	double footprint_margin;
+
+	/*------------- 参数: 模型构建与匹配约束 -------------*/
+	/*!
+	 * @brief 楔形匹配单元夹角, 量纲: 角度
+	 */
+	double angle;
+	/*!
+	 * @brief 定向点与中心的最小距离, 量纲: 像素
+	 * - 实际阈值取图像对角线长度的1/8与该值中的较大者
+	 */
+	double aimg_min;
+	/*!
+	 * @brief 图像系构建反向匹配单元的亮度差阈值, 量纲: 星等
+	 * - 匹配单元以样本对中较亮者为中心. 图像流量与星表星等的排序不一致时, 对应样本对定向相反
+	 * - 亮度差不超过该值的图像样本对另以较暗者为中心构建反向匹配单元, 星表侧不变
+	 * - 0: 不构建反向匹配单元
+	 */
+	double rank_margin;
+	/*!
+	 * @brief 匹配元素倾角最大偏差, 量纲: 角度
+	 */
+	double diff_incl_max;
+	/*!
+	 * @brief 匹配元素归一化距离最大偏差
+	 */
+	double diff_lnormal_max;
+	/*!
+	 * @brief 参与匹配的最少匹配单元数量
+	 */
+	int shape_count_min;
+	/*!
+	 * @brief 图像系参与匹配的最大目标数
+	 */
+	int count_img_max;
+	/*!
+	 * @brief 世界系参与匹配的最大目标数
+	 */
+	int count_wcs_max;
+	/*!
+	 * @brief 空间均匀选样: 每个网格的平均样本数
+	 * - 样本所在区域划分为网格, 逐轮选取各网格中最亮、次亮...的目标, 直至样本数量
+	 * - 0: 不划分网格, 选取最亮的目标
+	 */
+	double sample_cell;
+	/*!
+	 * @brief 星表样本深度与图像样本深度之比
+	 * - 图像样本中最暗目标在全部星像中的亮度排序, 按天区面积换算为星表星数, 乘以该比值确定极限星等
+	 * - 世界系样本取自极限星等以内的参考星, 数量不超过count_wcs_max
+	 * - 0: 不估计极限星等, 世界系样本数量为count_wcs_max
+	 */
+	double sample_depth;
+	/*!
+	 * @brief 判定样本对有效的命中率阈值: 最高与次高命中次数的比值
+	 */
+	double hit_ratio_min;
+	/*!
+	 * @brief 匹配成功阈值: 有效样本对占图像样本的比例
+	 */
+	double good_match;
+	/*!
+	 * @brief 使用单精度匹配引擎
+	 */
+	bool use_float;
+	/*!
+	 * @brief 以16位定点特征比较样本
+	 * - 倾角和归算长度以容差的1/8量化, 每个样本4字节
+	 * - 处理器支持AVX2时每次比较16个样本
+	 */
+	bool use_quant16;
+	/*!
+	 * @brief 流式匹配时世界系匹配单元的内存预算, 量纲: KB
+	 * - 世界系匹配单元分块生成, 逐块与图像系匹配单元比较后丢弃, 峰值内存与世界系样本数量无关
+	 * - 0: 一次生成全部世界系匹配单元
+	 * - 共享星表侧模型(MatchSolver)已预先生成, 不使用流式匹配
+	 */
+	int stream_budget;
+	/*!
+	 * @brief 分块匹配的缓存预算, 量纲: KB
+	 * - 匹配单元对按图像系和世界系特征块分块遍历, 两个特征块各占预算的一半. 宜取二级缓存容量
+	 * - 0: 不分块
+	 */
+	int block_size;
+	/*!
+	 * @brief 使用定长匹配核
+	 * - 样本数量不超过16/48、32/96或40/120且楔形夹角为60度时, 以编译期定长的实例匹配
+	 * - 投票矩阵驻留栈上, 比较循环按向量宽度展开. 启用16位定点特征时不使用
+	 */
+	bool use_kernel;
+
+	/*------------- 参数: 跟踪模式 -------------*/
+	/*!
+	 * @brief 最近邻搜索半径, 量纲: 像素
+	 */
+	double track_radius;
+	/*!
+	 * @brief 亮样本最小匹配比例. 低于该值时回退至完整匹配
+	 */
+	double track_ratio_min;
+	/*!
+	 * @brief 最大拟合残差, 量纲: 像素. 高于该值时回退至完整匹配
+	 */
+	double track_rms_max;
+
+	/*------------- 参数: 拼接相机 -------------*/
+	/*!
+	 * @brief 焦面标称旋转角, 量纲: 角度
+	 * - 焦面X轴相对投影平面xi轴的旋转角, 用于预测各芯片中心
+	 * - 不确定度取footprint_margin. 芯片参考星的范围计入旋转角偏差, 不确定度过大时芯片独立解算可能失败
+	 */
+	double mosaic_rotation;
+	/*!
+	 * @brief 芯片解与联合解一致的残差阈值, 量纲: 像素
+	 * - 芯片样本对在联合解下的残差超过该值时, 以联合解预测的先验重新解算该芯片
+	 */
+	double mosaic_tolerance;
+
+	/*------------- 参数: 全视场WCS拟合 -------------*/
+	/*!
+	 * @brief 匹配成功后拟合全视场WCS
+	 * - 以匹配的样本对为初值, 交叉匹配全部星像与参考星, 拟合TAN投影和SIP畸变多项式
+	 */
+	bool use_wcsfit;
+	/*!
+	 * @brief 多项式阶数
+	 * - 有效范围: [1, 5]. 1: 仅线性TAN解; 不小于2时拟合SIP畸变项
+	 * - 样本对数量少于项数的3倍时自动降低阶数
+	 */
+	int wcsfit_order;
+	/*!
+	 * @brief 交叉匹配的初始搜索半径, 量纲: 像素
+	 * - 应覆盖线性解在视场边缘的畸变残差
+	 */
+	double wcsfit_radius;
+	/*!
+	 * @brief 最大迭代次数
+	 * - 阶数逐次增加至设定阶数, 此后以残差收紧搜索半径, 样本对和残差不再变化时提前结束
+	 * - 宜不少于阶数加2
+	 */
+	int wcsfit_iteration;
+	/*!
+	 * @brief 剔除阈值: 样本对残差与均方根之比
+	 */
+	double wcsfit_clip;
+
+	/*------------- 参数: 全天盲匹配 -------------*/
+	/*!
+	 * @brief 相邻天区视场的最小重叠比例, 有效范围: [0, 1)
+	 * - 天球划分为等面积天区, 天区外接圆半径不大于视场内切圆半径的(1 - overlap)倍
+	 * - 视场取图像短边和比例尺下限
+	 */
+	double blind_overlap;
+	/*!
+	 * @brief 测站信息可用
+	 * - 启用时, 依据测站和曝光时间剔除不可见的天区
+	 */
+	bool use_site;
+	/*!
+	 * @brief 测站地理经度, 量纲: 角度. 东经为正
+	 */
+	double site_lon;
+	/*!
+	 * @brief 测站地理纬度, 量纲: 角度. 北纬为正
+	 */
+	double site_lat;
+	/*!
+	 * @brief 最低可观测高度角, 量纲: 角度
+	 */
+	double site_alt_min;
+
+	/*------------- 参数: 星场缓存 -------------*/
+	/*!
+	 * @brief 使用已解算星场的持久缓存
+	 * - 完整解算前以图像编码查找缓存, 候选星场以一次DoMatch复核
+	 * - 完整解算成功后, 星场加入缓存
+	 */
+	bool use_cache;
+	/*!
+	 * @brief 缓存文件路径
+	 */
+	std::string pathcache;
+	/*!
+	 * @brief 参与编码的最亮星像数量. 编码数量为其三元组合数
+	 */
+	int cache_stars;
+	/*!
+	 * @brief 候选星场的最少得票
+	 */
+	int cache_vote;
 
 	/*------------- 参数: 输出结果 -------------*/
 	/*!
@@ -77,6 +297,66 @@ struct ParamMatchShape {
 protected:
 	char errmsg[256];
 
+public:
+	ParamMatchShape() {
+		parity     = 0;
+		scale_low  = 11.0;
+		scale_high = 12.0;
+		scale_bucket = 0.05;
+		pathcat    = "/data/catalog/tycho2.dat";
+		cat_budget = 256;
+		cat_maglim = 99.0;
+		cat_prefetch = 4;
+		footprint_rotation = 0.0;
+		footprint_margin   = 180.0;
+
+		angle            = 60.0;
+		aimg_min         = 50.0;
+		rank_margin      = 0.5;
+		diff_incl_max    = 0.1;
+		diff_lnormal_max = 0.002;
+		shape_count_min  = 10;
+		count_img_max    = 40;
+		count_wcs_max    = 120;
+		sample_cell      = 3.0;
+		sample_depth     = 1.5;
+		hit_ratio_min    = 3.0;
+		good_match       = 0.5;
+		use_float        = false;
+		use_quant16      = false;
+		stream_budget    = 0;
+		block_size       = 256;
+		use_kernel       = true;
+
+		track_radius     = 10.0;
+		track_ratio_min  = 0.5;
+		track_rms_max    = 2.0;
+
+		mosaic_rotation  = 0.0;
+		mosaic_tolerance = 3.0;
+
+		use_wcsfit       = false;
+		wcsfit_order     = 3;
+		wcsfit_radius    = 10.0;
+		wcsfit_iteration = 6;
+		wcsfit_clip      = 3.0;
+
+		blind_overlap    = 0.1;
+		use_site         = false;
+		site_lon         = 0.0;
+		site_lat         = 0.0;
+		site_alt_min     = 0.0;
+
+		use_cache        = false;
+		pathcache        = "fovmatch.cache";
+		cache_stars      = 12;
+		cache_vote       = 5;
+
+		use_stdprint   = true;
+		use_output_dir = false;
+		memset(errmsg, 0, sizeof(errmsg));
+	}
+
 protected:
 	/*!
 	 * @brief 创建缺省值文件
@@ -88,15 +368,69 @@ protected:
 		ptree pt;
 
 		/* 参数: 模型匹配 */
-		pt.add("ShapeMatch.<xmlattr>.parity", 0);
-		pt.add("Scale.<xmlattr>.low",  8.3);
-		pt.add("Scale.<xmlattr>.high", 8.5);
-		pt.add("Catalog.<xmlattr>.pathname", "/data/catalog");
+		pt.add("ShapeMatch.<xmlattr>.parity", parity);
+		pt.add("Scale.<xmlattr>.low",  scale_low);
+		pt.add("Scale.<xmlattr>.high", scale_high);
+		pt.add("Scale.<xmlattr>.bucket", scale_bucket);
+		pt.add("Catalog.<xmlattr>.pathname", pathcat);
+		pt.add("Catalog.<xmlattr>.budget",   cat_budget);
+		pt.add("Catalog.<xmlattr>.maglim",   cat_maglim);
+		pt.add("Catalog.<xmlattr>.prefetch", cat_prefetch);
+		pt.add("Footprint.<xmlattr>.rotation", footprint_rotation);
+		pt.add("Footprint.<xmlattr>.margin",   footprint_margin);
+
+		/* 参数: 模型构建与匹配约束 */
+		pt.add("Wedge.<xmlattr>.angle",          angle);
+		pt.add("Wedge.<xmlattr>.aimg_min",       aimg_min);
+		pt.add("Wedge.<xmlattr>.count_min",      shape_count_min);
+		pt.add("Wedge.<xmlattr>.rank_margin",    rank_margin);
+		pt.add("Tolerance.<xmlattr>.incl",       diff_incl_max);
+		pt.add("Tolerance.<xmlattr>.lnormal",    diff_lnormal_max);
+		pt.add("Sample.<xmlattr>.image",         count_img_max);
+		pt.add("Sample.<xmlattr>.wcs",           count_wcs_max);
+		pt.add("Sample.<xmlattr>.cell",          sample_cell);
+		pt.add("Sample.<xmlattr>.depth",         sample_depth);
+		pt.add("Success.<xmlattr>.hit_ratio",    hit_ratio_min);
+		pt.add("Success.<xmlattr>.good_match",   good_match);
+		pt.add("Engine.<xmlattr>.float32",       use_float);
+		pt.add("Engine.<xmlattr>.quant16",       use_quant16);
+		pt.add("Engine.<xmlattr>.stream",        stream_budget);
+		pt.add("Engine.<xmlattr>.block",         block_size);
+		pt.add("Engine.<xmlattr>.kernel",        use_kernel);
+
+		/* 参数: 跟踪模式 */
+		pt.add("Track.<xmlattr>.radius",    track_radius);
+		pt.add("Track.<xmlattr>.ratio_min", track_ratio_min);
+		pt.add("Track.<xmlattr>.rms_max",   track_rms_max);
+
+		/* 参数: 拼接相机 */
+		pt.add("Mosaic.<xmlattr>.rotation",  mosaic_rotation);
+		pt.add("Mosaic.<xmlattr>.tolerance", mosaic_tolerance);
+
+		/* 参数: 全视场WCS拟合 */
+		pt.add("WcsFit.<xmlattr>.use",       use_wcsfit);
+		pt.add("WcsFit.<xmlattr>.order",     wcsfit_order);
+		pt.add("WcsFit.<xmlattr>.radius",    wcsfit_radius);
+		pt.add("WcsFit.<xmlattr>.iteration", wcsfit_iteration);
+		pt.add("WcsFit.<xmlattr>.clip",      wcsfit_clip);
+
+		/* 参数: 全天盲匹配 */
+		pt.add("Blind.<xmlattr>.overlap", blind_overlap);
+		pt.add("Site.<xmlattr>.use",      use_site);
+		pt.add("Site.<xmlattr>.lon",      site_lon);
+		pt.add("Site.<xmlattr>.lat",      site_lat);
+		pt.add("Site.<xmlattr>.alt_min",  site_alt_min);
+
+		/* 参数: 星场缓存 */
+		pt.add("Cache.<xmlattr>.use",      use_cache);
+		pt.add("Cache.<xmlattr>.pathname", pathcache);
+		pt.add("Cache.<xmlattr>.stars",    cache_stars);
+		pt.add("Cache.<xmlattr>.vote",     cache_vote);
 
 		/* 参数: 输出结果*/
-		pt.add("StdPrint.<xmlattr>.use",    true);
-		pt.add("Output.<xmlattr>.use",      false);
-		pt.add("Output.<xmlattr>.pathname", "");
+		pt.add("StdPrint.<xmlattr>.use",    use_stdprint);
+		pt.add("Output.<xmlattr>.use",      use_output_dir);
+		pt.add("Output.<xmlattr>.pathname", output_dir);
 
 		try {
 			xml_writer_settings<std::string> settings(' ', 4);
@@ -123,9 +457,63 @@ public:
 
 			/* 参数: 模型匹配 */
 			parity     = pt.get("ShapeMatch.<xmlattr>.parity", 0);
-			scale_low  = pt.get("Scale.<xmlattr>.low",         0.1);
-			scale_high = pt.get("Scale.<xmlattr>.high",        324.0);
-			pathcat    = pt.get("Catalog.<xmlattr>.pathname",  "");
+			scale_low  = pt.get("Scale.<xmlattr>.low",         11.0);
+			scale_high = pt.get("Scale.<xmlattr>.high",        12.0);
+			scale_bucket = pt.get("Scale.<xmlattr>.bucket",    0.05);
+			pathcat    = pt.get("Catalog.<xmlattr>.pathname",  "/data/catalog/tycho2.dat");
+			cat_budget = pt.get("Catalog.<xmlattr>.budget",    256);
+			cat_maglim = pt.get("Catalog.<xmlattr>.maglim",    99.0);
+			cat_prefetch = pt.get("Catalog.<xmlattr>.prefetch", 4);
+			footprint_rotation = pt.get("Footprint.<xmlattr>.rotation", 0.0);
+			footprint_margin   = pt.get("Footprint.<xmlattr>.margin",   180.0);
+
+			/* 参数: 模型构建与匹配约束 */
+			angle            = pt.get("Wedge.<xmlattr>.angle",        60.0);
+			aimg_min         = pt.get("Wedge.<xmlattr>.aimg_min",     50.0);
+			shape_count_min  = pt.get("Wedge.<xmlattr>.count_min",    10);
+			rank_margin      = pt.get("Wedge.<xmlattr>.rank_margin",  0.5);
+			diff_incl_max    = pt.get("Tolerance.<xmlattr>.incl",     0.1);
+			diff_lnormal_max = pt.get("Tolerance.<xmlattr>.lnormal",  0.002);
+			count_img_max    = pt.get("Sample.<xmlattr>.image",       40);
+			count_wcs_max    = pt.get("Sample.<xmlattr>.wcs",         120);
+			sample_cell      = pt.get("Sample.<xmlattr>.cell",        3.0);
+			sample_depth     = pt.get("Sample.<xmlattr>.depth",       1.5);
+			hit_ratio_min    = pt.get("Success.<xmlattr>.hit_ratio",  3.0);
+			good_match       = pt.get("Success.<xmlattr>.good_match", 0.5);
+			use_float        = pt.get("Engine.<xmlattr>.float32",     false);
+			use_quant16      = pt.get("Engine.<xmlattr>.quant16",     false);
+			stream_budget    = pt.get("Engine.<xmlattr>.stream",      0);
+			block_size       = pt.get("Engine.<xmlattr>.block",       256);
+			use_kernel       = pt.get("Engine.<xmlattr>.kernel",      true);
+
+			/* 参数: 跟踪模式 */
+			track_radius    = pt.get("Track.<xmlattr>.radius",    10.0);
+			track_ratio_min = pt.get("Track.<xmlattr>.ratio_min", 0.5);
+			track_rms_max   = pt.get("Track.<xmlattr>.rms_max",   2.0);
+
+			/* 参数: 拼接相机 */
+			mosaic_rotation  = pt.get("Mosaic.<xmlattr>.rotation",  0.0);
+			mosaic_tolerance = pt.get("Mosaic.<xmlattr>.tolerance", 3.0);
+
+			/* 参数: 全视场WCS拟合 */
+			use_wcsfit       = pt.get("WcsFit.<xmlattr>.use",       false);
+			wcsfit_order     = pt.get("WcsFit.<xmlattr>.order",     3);
+			wcsfit_radius    = pt.get("WcsFit.<xmlattr>.radius",    10.0);
+			wcsfit_iteration = pt.get("WcsFit.<xmlattr>.iteration", 6);
+			wcsfit_clip      = pt.get("WcsFit.<xmlattr>.clip",      3.0);
+
+			/* 参数: 全天盲匹配 */
+			blind_overlap = pt.get("Blind.<xmlattr>.overlap", 0.1);
+			use_site      = pt.get("Site.<xmlattr>.use",      false);
+			site_lon      = pt.get("Site.<xmlattr>.lon",      0.0);
+			site_lat      = pt.get("Site.<xmlattr>.lat",      0.0);
+			site_alt_min  = pt.get("Site.<xmlattr>.alt_min",  0.0);
+
+			/* 参数: 星场缓存 */
+			use_cache   = pt.get("Cache.<xmlattr>.use",      false);
+			pathcache   = pt.get("Cache.<xmlattr>.pathname", "fovmatch.cache");
+			cache_stars = pt.get("Cache.<xmlattr>.stars",    12);
+			cache_vote  = pt.get("Cache.<xmlattr>.vote",     5);
 
 			/* 参数: 输出结果*/
 			use_stdprint   = pt.get("StdPrint.<xmlattr>.use",    true);
@@ -139,6 +527,16 @@ public:
 		}
 	}
 
+	/*!
+	 * @brief 保存约束参数
+	 * @param filepath  文件路径
+	 * @return
+	 * 文件保存结果
+	 */
+	bool Save(const char* filepath) {
+		return init_file(filepath);
+	}
+
 	/*!
 	 * @brief 查看错误提示
 	 * @return
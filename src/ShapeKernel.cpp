@@ -0,0 +1,196 @@
+/**
+ * @file ShapeKernel.cpp
+ * @brief 定长匹配核: 样本数量和楔形夹角为编译期常量的匹配实例
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include "ShapeKernel.h"
+
+template <typename T, int NIMG, int NWCS, int ANGLE>
+bool ShapeKernel<T, NIMG, NWCS, ANGLE>::Fit(const ShapeMatch<T>& engine) {
+	return !engine.use_quant_
+			&& int(engine.id1_.size()) <= NIMG
+			&& int(engine.refid2_->size()) <= NWCS
+			&& std::fabs(engine.builder_.Angle() - T(ANGLE)) < T(1E-3);
+}
+
+template <typename T, int NIMG, int NWCS, int ANGLE>
+int ShapeKernel<T, NIMG, NWCS, ANGLE>::load_shape2(const ShapeMatch<T>& engine, int i2, T* incl2, T* len2) {
+	const MatchShapePool<T>& pool2 = *engine.pref2_;
+	int start(pool2.start[i2]), n2(pool2.start[i2 + 1] - start);
+	int npad = (n2 + kLane - 1) / kLane * kLane;
+	int j;
+
+	for (j = 0; j < n2; ++j) {
+		incl2[j] = pool2.incl[start + j];
+		len2[j]  = pool2.len[start + j];
+	}
+	// 哨兵值与任何特征都不一致
+	for (; j < npad; ++j) incl2[j] = len2[j] = T(1E6);
+	return npad;
+}
+
+template <typename T, int NIMG, int NWCS, int ANGLE>
+template <bool VOTE>
+int ShapeKernel<T, NIMG, NWCS, ANGLE>::match_shape(const ShapeMatch<T>& engine, int i1, int i2,
+		const T* incl2, const T* len2, int npad, int (*votes)[NWCS]) {
+	const MatchShape<T>& shape1 = engine.shapes1_[i1];
+	const MatchShape<T>& shape2 = (*engine.ref2_)[i2];
+	const T* incl1 = engine.pool1_.incl.data() + engine.pool1_.start[i1];
+	const T* len1  = engine.pool1_.len.data() + engine.pool1_.start[i1];
+	const int* ids2 = shape2.ids.data();
+	const T dincl(engine.diff_incl_max_), dlen(engine.diff_lnormal_max_);
+	int n1(shape1.Count()), n2(shape2.Count()), n0(0);
+	int i, j, u, hit, j0(0), j1;
+
+	for (i = 0; i < n1; ++i) {
+		const T incl(incl1[i]), lnormal(len1[i]);
+		int acc[kLane] = { 0 };
+		/* 楔形内样本按归算倾角递增排列, 两个匹配单元的倾角窗口同向滑动: 仅比较窗口所在的向量块 */
+		while (j0 < npad && incl - incl2[j0 + kLane - 1] > dincl) j0 += kLane;
+		for (j1 = j0; j1 < npad && incl2[j1] - incl <= dincl; j1 += kLane) {
+			for (u = 0; u < kLane; ++u) {// 向量宽度内完全展开
+				acc[u] += (std::fabs(incl2[j1 + u] - incl) <= dincl) & (std::fabs(len2[j1 + u] - lnormal) <= dlen);
+			}
+		}
+		for (u = 0, hit = 0; u < kLane; ++u) hit += acc[u];
+		if (!hit) continue;
+		n0 += hit;
+		if (!VOTE) continue;
+		// 特征一致的样本很少, 投票时重新比较
+		int* row = votes[shape1.ids[i]];
+		for (j = j0, j1 = j1 < n2 ? j1 : n2; j < j1; ++j) {
+			if (std::fabs(incl2[j] - incl) <= dincl && std::fabs(len2[j] - lnormal) <= dlen) ++row[ids2[j]];
+		}
+	}
+	// 中心点和定向点
+	if (VOTE && n0) {
+		++votes[shape1.idc][shape2.idc];
+		++votes[shape1.ido][shape2.ido];
+	}
+	return n0;
+}
+
+template <typename T, int NIMG, int NWCS, int ANGLE>
+int ShapeKernel<T, NIMG, NWCS, ANGLE>::Match(ShapeMatch<T>& engine, double ratio_min, PtPairMSVec& pairs) {
+	const MatchShapeVec<T>& shapes1 = engine.shapes1_;
+	const MatchShapeVec<T>& shapes2 = *engine.ref2_;
+	const std::vector<int>& ids2 = *engine.refid2_;
+	const T low(engine.scale_low_), high(engine.scale_high_);
+	bool bucketed = engine.nbucket_ > 3;
+	int nimg(engine.id1_.size()), nwcs(ids2.size());
+	int i, j, k, hit, npad(0), loaded(-1), n(0);
+	typename std::vector<T>::const_iterator first, last;
+	int votes[NIMG][NWCS];
+	T incl2[kPad], len2[kPad];
+
+	memset(votes, 0, sizeof(votes));
+	engine.index_shape1();
+	engine.best_bucket_ = -1;
+	if (bucketed) {
+		engine.cands_.clear();
+		engine.score_.assign(engine.nbucket_, 0);
+	}
+	/* 集合2匹配单元的特征驻留栈上, 与比例尺范围内的集合1匹配单元逐个比较 */
+	for (j = 0; j < engine.nshape2_; ++j) {
+		const MatchShape<T>& shape2 = shapes2[j];
+		first = std::lower_bound(engine.len1_.cbegin(), engine.len1_.cend(), shape2.len / high);
+		last  = std::upper_bound(first, engine.len1_.cend(), shape2.len / low);
+		if (first == last) continue;
+		npad = load_shape2(engine, j, incl2, len2);
+		loaded = j;
+		for (k = first - engine.len1_.cbegin(); k < last - engine.len1_.cbegin(); ++k) {
+			i = engine.order1_[k];
+			if (!bucketed) {
+				if (match_shape<true>(engine, i, j, incl2, len2, npad, votes)) ++n;
+				continue;
+			}
+			if (!(hit = match_shape<false>(engine, i, j, incl2, len2, npad, votes))) continue;
+			typename ShapeMatch<T>::candidate cand;
+			cand.i1 = i;
+			cand.i2 = j;
+			cand.bucket = engine.scale_bucket(shape2.len / shapes1[i].len);
+			engine.cands_.push_back(cand);
+			if (hit * 2 >= shapes1[i].Count()) ++engine.score_[cand.bucket];
+		}
+	}
+	if (bucketed) {
+		engine.select_bucket();
+		/* 仅得分最高的相邻三档的候选投票. 候选按集合2匹配单元递增排列 */
+		for (k = 0; k < int(engine.cands_.size()); ++k) {
+			const typename ShapeMatch<T>::candidate& cand = engine.cands_[k];
+			if (std::abs(cand.bucket - engine.best_bucket_) > 1) continue;
+			if (cand.i2 != loaded) {
+				npad = load_shape2(engine, cand.i2, incl2, len2);
+				loaded = cand.i2;
+			}
+			match_shape<true>(engine, cand.i1, cand.i2, incl2, len2, npad, votes);
+			++n;
+		}
+	}
+
+	/* 提取样本对: 命中率最高与次高的比值 */
+	pairs.clear();
+	for (i = 0; n && i < nimg; ++i) {
+		const int* row = votes[i];
+		int maxhit(0), sechit(1), id2(-1);
+		for (j = 0; j < nwcs; ++j) {
+			if (row[j] > maxhit) {
+				if (sechit < maxhit) sechit = maxhit;
+				maxhit = row[j];
+				id2    = j;
+			}
+			else if (row[j] > sechit)
+				sechit = row[j];
+		}
+		if (id2 >= 0 && double(maxhit) / sechit > ratio_min)
+			pairs.push_back(PointPairMS(engine.id1_[i], ids2[id2]));
+	}
+	return pairs.size();
+}
+
+/*------------------------------------------------------------------------*/
+/* 实例表: 按样本容量递增排列 */
+template <typename T>
+struct shape_kernel_entry {
+	const char* name;
+	bool (*fit)(const ShapeMatch<T>&);
+	int (*match)(ShapeMatch<T>&, double, PtPairMSVec&);
+};
+
+#define SHAPE_KERNEL_ENTRY(T, NIMG, NWCS, ANGLE) \
+	{ #NIMG "/" #NWCS, &ShapeKernel<T, NIMG, NWCS, ANGLE>::Fit, &ShapeKernel<T, NIMG, NWCS, ANGLE>::Match }
+
+template <typename T>
+static const shape_kernel_entry<T>* select_kernel(const ShapeMatch<T>& engine) {
+	static const shape_kernel_entry<T> kernels[] = {
+		SHAPE_KERNEL_ENTRY(T, 16, 48, 60),
+		SHAPE_KERNEL_ENTRY(T, 32, 96, 60),
+		SHAPE_KERNEL_ENTRY(T, 40, 120, 60)
+	};
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+		if (kernels[k].fit(engine)) return &kernels[k];
+	}
+	return NULL;
+}
+
+template <typename T>
+const char* ShapeKernelSet<T>::Select(const ShapeMatch<T>& engine) {
+	const shape_kernel_entry<T>* kernel = select_kernel(engine);
+	return kernel ? kernel->name : NULL;
+}
+
+template <typename T>
+int ShapeKernelSet<T>::Match(ShapeMatch<T>& engine, double ratio_min, PtPairMSVec& pairs) {
+	const shape_kernel_entry<T>* kernel = select_kernel(engine);
+	return kernel ? kernel->match(engine, ratio_min, pairs) : -1;
+}
+
+/* 实例: 单精度与双精度 */
+template class ShapeKernelSet<float>;
+template class ShapeKernelSet<double>;
@@ -0,0 +1,105 @@
+/**
+ * @file ShapeKernel.h
+ * @brief 定长匹配核: 样本数量和楔形夹角为编译期常量的匹配实例
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 函数调用流程:
+ * - ShapeMatch::BuildShape1
+ * - ShapeMatch::BuildShape2, 或ShapeMatch::UseShape2
+ * - ShapeKernelSet::Match: 替代ShapeMatch::Match和ShapeMatch::GetMatchedPair
+ * @note
+ * 与ShapeMatch::Match的区别:
+ * - 投票矩阵为栈上的定长数组, 行为集合1样本, 列为集合2样本. 投票即数组元素加1, 不查找候选列表
+ * - 集合2匹配单元的特征复制至栈上的定长缓存区, 补齐为向量宽度的整数倍, 比较循环无尾部处理,
+ *   向量宽度内完全展开
+ * - 楔形夹角小于360度时, 匹配单元内样本按归算倾角递增排列. 集合1样本的倾角窗口在集合2特征中
+ *   单调滑动, 仅比较窗口所在的向量块
+ * - 集合1匹配单元按长度建立索引, 集合2匹配单元仅与比例尺范围内的集合1匹配单元比较
+ * - 投票结果与ShapeMatch::Match一致. 命中率最高的候选不唯一时, 取集合2样本ID最小者
+ * @note
+ * 实例: 图像样本/世界样本为16/48、32/96和40/120, 楔形夹角60度. 选用样本容量不小于实际样本数量的
+ * 最小实例; 无对应实例、启用16位定点特征时, 调用者使用ShapeMatch::Match
+ */
+
+#ifndef SHAPEKERNEL_H_
+#define SHAPEKERNEL_H_
+
+#include "ShapeMatch.h"
+
+/*!
+ * @class ShapeKernel
+ * @brief 定长匹配核
+ * @tparam T      坐标精度
+ * @tparam NIMG   集合1样本容量
+ * @tparam NWCS   集合2样本容量
+ * @tparam ANGLE  楔形夹角, 量纲: 角度
+ */
+template <typename T, int NIMG, int NWCS, int ANGLE>
+class ShapeKernel {
+	static_assert(ANGLE > 0 && ANGLE < 360, "wedge angle must be in (0, 360)");
+
+public:
+	static const int kLane = 32 / sizeof(T);	///< 向量宽度: 32字节
+	static const int kPad  = (NWCS + kLane - 1) / kLane * kLane;	///< 集合2特征缓存区长度
+
+public:
+	/*!
+	 * @brief 检查引擎的样本数量和楔形夹角是否适用本实例
+	 */
+	static bool Fit(const ShapeMatch<T>& engine);
+	/*!
+	 * @brief 匹配两个集合的匹配单元, 投票并提取样本对
+	 * @param engine     匹配引擎. 已构建两个集合的匹配单元
+	 * @param ratio_min  命中率最高与次高的比值阈值
+	 * @param pairs      样本对. id1: 集合1样本ID; id2: 集合2样本ID
+	 * @return
+	 * 样本对数量
+	 */
+	static int Match(ShapeMatch<T>& engine, double ratio_min, PtPairMSVec& pairs);
+
+protected:
+	/*!
+	 * @brief 复制集合2匹配单元的特征, 以哨兵值补齐
+	 * @return
+	 * 补齐后的长度
+	 */
+	static int load_shape2(const ShapeMatch<T>& engine, int i2, T* incl2, T* len2);
+	/*!
+	 * @brief 匹配两个匹配单元
+	 * @tparam VOTE   是否投票. false: 仅计数
+	 * @param npad    集合2特征补齐后的长度
+	 * @param votes   投票矩阵
+	 * @return
+	 * 特征一致的样本对数量
+	 */
+	template <bool VOTE>
+	static int match_shape(const ShapeMatch<T>& engine, int i1, int i2, const T* incl2, const T* len2, int npad,
+			int (*votes)[NWCS]);
+};
+
+/*!
+ * @class ShapeKernelSet
+ * @brief 定长匹配核的运行时选择
+ */
+template <typename T>
+class ShapeKernelSet {
+public:
+	/*!
+	 * @brief 选择适用的定长匹配核
+	 * @return
+	 * 实例名称, 格式: 集合1样本容量/集合2样本容量. 无适用实例时返回NULL
+	 */
+	static const char* Select(const ShapeMatch<T>& engine);
+	/*!
+	 * @brief 以适用的定长匹配核匹配
+	 * @param engine     匹配引擎. 已构建两个集合的匹配单元
+	 * @param ratio_min  命中率最高与次高的比值阈值
+	 * @param pairs      样本对
+	 * @return
+	 * 样本对数量. 无适用实例时返回-1
+	 */
+	static int Match(ShapeMatch<T>& engine, double ratio_min, PtPairMSVec& pairs);
+};
+
+#endif /* SHAPEKERNEL_H_ */
@@ -6,12 +6,426 @@
  * @author 卢晓猛
  */
 
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "ADefine.h"
 #include "ShapeMatch.h"
 
-ShapeMatch::ShapeMatch() {
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHAPEMATCH_AVX2
+#endif
 
+/*------------------------------------------------------------------------*/
+/* 定点特征比较: 集合2的n个样本与集合1的一个样本 */
+/*!
+ * @brief 标量实现
+ * @param incl2  集合2样本倾角
+ * @param len2   集合2样本归算长度
+ * @param n      集合2样本数量
+ * @param incl   集合1样本倾角
+ * @param len    集合1样本归算长度
+ * @param tincl  倾角容差
+ * @param tlen   归算长度容差
+ * @param mask   比较结果: 1, 一致; 0, 不一致
+ * @return
+ * 一致的样本数量
+ */
+static int compare_q16_scalar(const unsigned short* incl2, const unsigned short* len2, int n,
+		unsigned short incl, unsigned short len, unsigned short tincl, unsigned short tlen, unsigned char* mask) {
+	int j, hit(0);
+	for (j = 0; j < n; ++j) {
+		unsigned short di = incl2[j] > incl ? incl2[j] - incl : incl - incl2[j];
+		unsigned short dl = len2[j] > len ? len2[j] - len : len - len2[j];
+		mask[j] = (di <= tincl) & (dl <= tlen);
+		hit += mask[j];
+	}
+	return hit;
+}
+
+#ifdef SHAPEMATCH_AVX2
+/*!
+ * @brief AVX2实现: 每次比较16个样本
+ */
+__attribute__((target("avx2")))
+static int compare_q16_avx2(const unsigned short* incl2, const unsigned short* len2, int n,
+		unsigned short incl, unsigned short len, unsigned short tincl, unsigned short tlen, unsigned char* mask) {
+	const __m256i vincl = _mm256_set1_epi16(short(incl)), vlen = _mm256_set1_epi16(short(len));
+	const __m256i vti = _mm256_set1_epi16(short(tincl)), vtl = _mm256_set1_epi16(short(tlen));
+	const __m256i one = _mm256_set1_epi8(1);
+	int j, hit(0);
+
+	for (j = 0; j + 16 <= n; j += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*) (incl2 + j));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (len2 + j));
+		// |a - b| = sat(a - b) | sat(b - a), 无符号
+		__m256i di = _mm256_or_si256(_mm256_subs_epu16(a, vincl), _mm256_subs_epu16(vincl, a));
+		__m256i dl = _mm256_or_si256(_mm256_subs_epu16(b, vlen), _mm256_subs_epu16(vlen, b));
+		// d <= t 等价于 min(d, t) == d
+		__m256i m = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_min_epu16(di, vti), di),
+				_mm256_cmpeq_epi16(_mm256_min_epu16(dl, vtl), dl));
+		// 16位比较结果压缩为16个字节
+		__m128i m8 = _mm_packs_epi16(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+		_mm_storeu_si128((__m128i*) (mask + j), _mm_and_si128(m8, _mm256_castsi256_si128(one)));
+		hit += __builtin_popcount(_mm_movemask_epi8(m8));
+	}
+	return hit + compare_q16_scalar(incl2 + j, len2 + j, n - j, incl, len, tincl, tlen, mask + j);
+}
+#endif
+
+typedef int (*compare_q16_func)(const unsigned short*, const unsigned short*, int,
+		unsigned short, unsigned short, unsigned short, unsigned short, unsigned char*);
+
+/*!
+ * @brief 依据处理器特性选择实现, 仅选择一次
+ */
+static compare_q16_func select_compare_q16() {
+#ifdef SHAPEMATCH_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return compare_q16_avx2;
+#endif
+	return compare_q16_scalar;
+}
+
+static const compare_q16_func compare_q16 = select_compare_q16();
+
+/*------------------------------------------------------------------------*/
+
+template <typename T>
+ShapeMatch<T>::ShapeMatch() {
+	diff_incl_max_ = T(0.1);
+	diff_lnormal_max_ = T(0.002);
+	shape_count_min_ = 10;
+	scale_low_ = scale_high_ = T(0);
+	bucket_width_ = T(0.05);
+	nbucket_ = 1;
+	best_bucket_ = -1;
+	use_quant_ = false;
+	stream_budget_ = 0;
+	block_size_ = 256 << 10;
+	rank_margin_ = T(0);
+	nshape1_ = nshape2_ = 0;
+	ref2_   = &shapes2_;
+	refid2_ = &id2_;
+	qref2_  = &quant2_;
+	pref2_  = &pool2_;
+	quant1_.SetTolerance(diff_incl_max_, diff_lnormal_max_);
+	quant2_.SetTolerance(diff_incl_max_, diff_lnormal_max_);
+}
+
+template <typename T>
+ShapeMatch<T>::~ShapeMatch() {
+
+}
+
+template <typename T>
+void ShapeMatch<T>::SetParameter(const ParamMatchShape& param) {
+	builder_.SetAngle(T(param.angle));
+	diff_incl_max_    = T(param.diff_incl_max);
+	diff_lnormal_max_ = T(param.diff_lnormal_max);
+	shape_count_min_  = param.shape_count_min;
+	if (param.scale_bucket > 0.0) bucket_width_ = T(param.scale_bucket);
+	use_quant_ = param.use_quant16;
+	stream_budget_ = param.stream_budget > 0 ? size_t(param.stream_budget) << 10 : 0;
+	block_size_    = param.block_size > 0 ? size_t(param.block_size) << 10 : 0;
+	rank_margin_   = T(param.rank_margin);
+	quant1_.SetTolerance(param.diff_incl_max, param.diff_lnormal_max);
+	quant2_.SetTolerance(param.diff_incl_max, param.diff_lnormal_max);
+}
+
+template <typename T>
+void ShapeMatch<T>::SetScale(T low, T high) {
+	scale_low_  = low;
+	scale_high_ = high;
+	nbucket_    = low > T(0) && high > low ? int(std::log(high / low) / bucket_width_) + 1 : 1;
+}
+
+template <typename T>
+bool ShapeMatch<T>::BuildShape1(const PtMSVec<T>& pts, T len_low) {
+	int n(pts.size());
+
+	id1_.resize(n);
+	for (int i = 0; i < n; ++i) id1_[i] = pts[i].id;
+	// 初始化候选匹配项
+	if (int(votes_.size()) < n) votes_.resize(n);
+	for (int i = 0; i < n; ++i) votes_[i].Reset();
+
+	nshape1_ = builder_.Build(pts, len_low, shapes1_, rank_margin_);
+	if (use_quant_) quant1_.Build(shapes1_, nshape1_, true);
+	else pool1_.Build(shapes1_, nshape1_);
+	return nshape1_ >= shape_count_min_;
+}
+
+template <typename T>
+bool ShapeMatch<T>::BuildShape2(const PtMSVec<T>& pts, T len_low) {
+	int n(pts.size());
+
+	id2_.resize(n);
+	for (int i = 0; i < n; ++i) id2_[i] = pts[i].id;
+	nshape2_ = builder_.Build(pts, len_low, shapes2_);
+	ref2_    = &shapes2_;
+	refid2_  = &id2_;
+	if (use_quant_) {
+		quant2_.Build(shapes2_, nshape2_, false);
+		qref2_ = &quant2_;
+	}
+	else {
+		pool2_.Build(shapes2_, nshape2_);
+		pref2_ = &pool2_;
+	}
+	return nshape2_ >= shape_count_min_;
+}
+
+template <typename T>
+bool ShapeMatch<T>::UseShape2(const MatchShapeVec<T>& shapes, int n, const std::vector<int>& ids,
+		const MatchShapePool<T>* pool, const MatchShapeQ16* quant) {
+	nshape2_ = n;
+	ref2_    = &shapes;
+	refid2_  = &ids;
+	if (use_quant_) {
+		if (quant && quant->Compatible(quant1_, n)) qref2_ = quant;
+		else {
+			quant2_.Build(shapes, n, false);
+			qref2_ = &quant2_;
+		}
+	}
+	else if (pool && pool->Compatible(n)) pref2_ = pool;
+	else {
+		pool2_.Build(shapes, n);
+		pref2_ = &pool2_;
+	}
+	return nshape2_ >= shape_count_min_;
+}
+
+template <typename T>
+int ShapeMatch<T>::Match() {
+	const MatchShapeVec<T>& shapes2 = *ref2_;
+	const std::vector<int>& start1 = use_quant_ ? quant1_.start : pool1_.start;
+	const std::vector<int>& start2 = use_quant_ ? qref2_->start : pref2_->start;
+	bool bucketed = nbucket_ > 3;
+	int i, j, k, i0, i1, j0, j1, hit, n(0);
+	// 两个集合的特征块各占缓存预算的一半
+	size_t items = block_size_ / 2 / (use_quant_ ? 2 * sizeof(unsigned short) : 2 * sizeof(T));
+
+	best_bucket_ = -1;
+	if (bucketed) {
+		cands_.clear();
+		score_.assign(nbucket_, 0);
+	}
+	/* 分块遍历: 集合2的一块特征驻留缓存, 被集合1的各块重复使用 */
+	for (j0 = 0; j0 < nshape2_; j0 = j1) {
+		j1 = block_end(start2, j0, nshape2_, items);
+		for (i0 = 0; i0 < nshape1_; i0 = i1) {
+			i1 = block_end(start1, i0, nshape1_, items);
+			for (i = i0; i < i1; ++i) {
+				const MatchShape<T>& shape1 = shapes1_[i];
+				for (j = j0; j < j1; ++j) {
+					if (!bucketed) {// 比例尺范围窄: 全部候选直接投票
+						if (match_shape(i, j, true)) ++n;
+						continue;
+					}
+					/* 比例尺范围宽: 按比例尺分档计分 */
+					if (!(hit = match_shape(i, j, false))) continue;
+					candidate cand;
+					cand.i1 = i;
+					cand.i2 = j;
+					cand.bucket = scale_bucket(shapes2[j].len / shape1.len);
+					cands_.push_back(cand);
+					// 偶然相似的匹配单元仅少数样本一致, 其数量随比例尺变化. 以多数样本一致的匹配单元对计分
+					if (hit * 2 >= shape1.Count()) ++score_[cand.bucket];
+				}
+			}
+		}
+	}
+	if (!bucketed) return n;
+
+	select_bucket();
+	/* 仅得分最高的相邻三档的候选投票 */
+	for (k = 0; k < int(cands_.size()); ++k) {
+		const candidate& cand = cands_[k];
+		if (std::abs(cand.bucket - best_bucket_) > 1) continue;
+		match_shape(cand.i1, cand.i2, true);
+		++n;
+	}
+	return n;
+}
+
+template <typename T>
+int ShapeMatch<T>::MatchStream(const PtMSVec<T>& pts, T len_low) {
+	int n(pts.size()), i, j, k, nblock, count(0);
+	bool bucketed = nbucket_ > 3;
+	typename std::vector<T>::const_iterator first, last;
+
+	id2_.resize(n);
+	for (i = 0; i < n; ++i) id2_[i] = pts[i].id;
+	ref2_    = &shapes2_;
+	refid2_  = &id2_;
+	qref2_   = &quant2_;
+	pref2_   = &pool2_;
+	nshape2_ = 0;
+	best_bucket_ = -1;
+	if (bucketed) score_.assign(nbucket_, 0);
+	index_shape1();
+
+	// 定点特征池每个样本另需4字节, 按比例缩减匹配单元的预算
+	size_t budget = stream_budget_, item = sizeof(int) + 2 * sizeof(T);
+	if (use_quant_) budget = budget / (item + 4) * item;
+	/* 宽比例尺范围: 第一遍分档计分, 第二遍投票 */
+	for (int pass = 0; pass < (bucketed ? 2 : 1); ++pass) {
+		builder_.Begin(pts, len_low);
+		while ((nblock = builder_.Next(shapes2_, budget)) > 0) {
+			if (!pass) nshape2_ += nblock;
+			if (use_quant_) quant2_.Build(shapes2_, nblock, false);
+			else pool2_.Build(shapes2_, nblock);
+			for (j = 0; j < nblock; ++j) {
+				const MatchShape<T>& shape2 = shapes2_[j];
+				// 比例尺范围内的集合1匹配单元: 长度位于[len2 / high, len2 / low]
+				first = std::lower_bound(len1_.begin(), len1_.end(), shape2.len / scale_high_);
+				last  = std::upper_bound(first, len1_.cend(), shape2.len / scale_low_);
+				for (k = first - len1_.begin(); k < last - len1_.begin(); ++k) {
+					i = order1_[k];
+					if (!bucketed) {
+						if (match_shape(i, j, true)) ++count;
+					}
+					else if (!pass) {
+						// 以多数样本一致的匹配单元对计分
+						if (match_shape(i, j, false) * 2 >= shapes1_[i].Count())
+							++score_[scale_bucket(shape2.len / shapes1_[i].len)];
+					}
+					else if (std::abs(scale_bucket(shape2.len / shapes1_[i].len) - best_bucket_) <= 1
+							&& match_shape(i, j, true))
+						++count;
+				}
+			}
+		}
+		if (!pass && bucketed) select_bucket();
+	}
+	return nshape2_ >= shape_count_min_ ? count : 0;
+}
+
+template <typename T>
+T ShapeMatch<T>::BestScale() const {
+	if (best_bucket_ < 0) return std::sqrt(scale_low_ * scale_high_);
+	return scale_low_ * std::exp(bucket_width_ * (T(best_bucket_) + T(0.5)));
+}
+
+template <typename T>
+int ShapeMatch<T>::scale_bucket(T scale) const {
+	int k = int(std::log(scale / scale_low_) / bucket_width_);
+	return k < 0 ? 0 : (k >= nbucket_ ? nbucket_ - 1 : k);
+}
+
+template <typename T>
+int ShapeMatch<T>::block_end(const std::vector<int>& start, int k0, int n, size_t items) {
+	if (!items) return n;
+	int k = k0 + 1;	// 每块至少包含一个匹配单元
+	while (k < n && size_t(start[k + 1] - start[k0]) <= items) ++k;
+	return k;
+}
+
+template <typename T>
+void ShapeMatch<T>::select_bucket() {
+	int k, best(0), sum;
+
+	best_bucket_ = -1;
+	for (k = 0; k < nbucket_; ++k) {
+		sum = score_[k] + (k > 0 ? score_[k - 1] : 0) + (k + 1 < nbucket_ ? score_[k + 1] : 0);
+		if (sum > best) {
+			best = sum;
+			best_bucket_ = k;
+		}
+	}
+}
+
+template <typename T>
+void ShapeMatch<T>::index_shape1() {
+	int i;
+
+	order1_.resize(nshape1_);
+	for (i = 0; i < nshape1_; ++i) order1_[i] = i;
+	std::sort(order1_.begin(), order1_.end(), [this](int i1, int i2) {
+		return shapes1_[i1].len < shapes1_[i2].len;
+	});
+	len1_.resize(nshape1_);
+	for (i = 0; i < nshape1_; ++i) len1_[i] = shapes1_[order1_[i]].len;
 }
 
-ShapeMatch::~ShapeMatch() {
+template <typename T>
+int ShapeMatch<T>::GetMatchedPair(double ratio_min, PtPairMSVec& pairs) {
+	const std::vector<int>& ids2 = *refid2_;
+	int n(id1_.size()), id2;
+	double ratio;
 
+	pairs.clear();
+	for (int i = 0; i < n; ++i) {
+		if (votes_[i].GetHitPoint(id2, ratio) && ratio > ratio_min)
+			pairs.push_back(PointPairMS(id1_[i], ids2[id2]));
+	}
+	return pairs.size();
 }
+
+template <typename T>
+int ShapeMatch<T>::match_shape(int i1, int i2, bool vote) {
+	const MatchShape<T>& shape1 = shapes1_[i1];
+	const MatchShape<T>& shape2 = (*ref2_)[i2];
+	T scale = shape2.len / shape1.len;
+	if (scale < scale_low_ || scale > scale_high_) return 0;
+
+	int n1(shape1.Count()), n2(shape2.Count()), n0(0);
+	int i, j, hit, id;
+	T dincl(diff_incl_max_), dlen(diff_lnormal_max_);
+	T incl, lnormal;
+	// 特征池: 定点特征或连续存储的浮点特征
+	const unsigned short *qincl1(NULL), *qlen1(NULL), *qincl2(NULL), *qlen2(NULL);
+	const T *incl1(NULL), *len1(NULL), *incl2(NULL), *len2(NULL);
+	if (use_quant_) {
+		qincl1 = quant1_.incl.data() + quant1_.start[i1];
+		qlen1  = quant1_.len.data() + quant1_.start[i1];
+		qincl2 = qref2_->incl.data() + qref2_->start[i2];
+		qlen2  = qref2_->len.data() + qref2_->start[i2];
+	}
+	else {
+		incl1 = pool1_.incl.data() + pool1_.start[i1];
+		len1  = pool1_.len.data() + pool1_.start[i1];
+		incl2 = pref2_->incl.data() + pref2_->start[i2];
+		len2  = pref2_->len.data() + pref2_->start[i2];
+	}
+
+	if (int(mask_.size()) < n2) mask_.resize(n2);
+	unsigned char* mask = mask_.data();
+	for (i = 0; i < n1; ++i) {
+		id = shape1.ids[i];
+		if (use_quant_) {
+			hit = compare_q16(qincl2, qlen2, n2, qincl1[i], qlen1[i], quant1_.tincl, quant1_.tlen, mask);
+		}
+		else {
+			incl    = incl1[i];
+			lnormal = len1[i];
+			// 无分支比较, 便于编译器向量化
+			for (j = 0, hit = 0; j < n2; ++j) {
+				mask[j] = (std::fabs(incl2[j] - incl) <= dincl) & (std::fabs(len2[j] - lnormal) <= dlen);
+				hit += mask[j];
+			}
+		}
+		if (!hit) continue;
+		// 加入候选匹配项
+		n0 += hit;
+		if (!vote) continue;
+		for (j = 0; j < n2; ++j) {
+			if (mask[j]) votes_[id].MarkHitPoint(shape2.ids[j]);
+		}
+	}
+
+	// 中心点和定向点加入候选匹配项
+	if (n0 && vote) {
+		votes_[shape1.idc].MarkHitPoint(shape2.idc);
+		votes_[shape1.ido].MarkHitPoint(shape2.ido);
+	}
+
+	return n0;
+}
+
+/* 实例: 单精度与双精度 */
+template class ShapeMatch<float>;
+template class ShapeMatch<double>;
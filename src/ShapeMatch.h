@@ -4,6 +4,16 @@
  * @version 0.1
  * @date 2020-11-02
  * @author 卢晓猛
+ * @note
+ * 函数调用流程:
+ * - SetParameter
+ * - SetScale
+ * - BuildShape1
+ * - BuildShape2, 或UseShape2使用外部构建的匹配单元
+ * - Match
+ * - GetMatchedPair
+ *
+ * 流式匹配: 以MatchStream替代BuildShape2和Match, 集合2匹配单元分块生成、匹配后丢弃
  */
 
 #ifndef SHAPEMATCH_H_
@@ -13,16 +23,216 @@
 #include "MatchShape.h"
 #include "MatchingShapePoint.h"
 #include "MatchedShapePointPair.h"
+#include "BuildMatchShape.h"
 
 /*!
  * @class ShapeMatch
- * @brief
- *
+ * @brief 楔形模型匹配引擎
+ * @tparam T 坐标精度. 提供float和double两种实例
+ * @note
+ * - 集合1和集合2中的样本应按亮度递减排列
+ * - 两个集合的亮度排序可能不一致. 集合1中亮度相近的样本对另构建反向匹配单元, 使集合2中以任一样本
+ *   为中心的匹配单元都有对应项. 集合1样本较少, 匹配耗时按反向单元的比例增加
+ * - 比例尺定义为: 集合2长度/集合1长度
+ * - 比例尺范围较宽时, 候选匹配单元对按ln(比例尺)分档. 多数样本一致的匹配单元对最多的相邻三档决定比例尺,
+ *   仅其中的候选参与投票, 其它比例尺的偶然相似不干扰投票
+ * - float实例的归一化长度和倾角精度满足匹配容差, 且向量化比较宽度为double的2倍
+ * - 启用16位定点特征时, 样本比较使用MatchShapeQ16特征池. 处理器支持AVX2时每次比较16个样本,
+ *   否则使用标量实现
+ * - 样本特征连续存储在特征池中. 匹配单元对按两个集合的特征块分块遍历, 集合2的一块特征驻留缓存,
+ *   被集合1的全部匹配单元重复使用
+ * - 流式匹配时集合1匹配单元按长度建立索引, 集合2匹配单元仅与比例尺范围内的集合1匹配单元比较.
+ *   宽比例尺范围需两遍生成: 第一遍分档计分, 第二遍仅得分最高的相邻三档投票
  */
+template <typename T>
 class ShapeMatch {
+	template <typename U, int NIMG, int NWCS, int ANGLE> friend class ShapeKernel;
+
 public:
 	ShapeMatch();
 	virtual ~ShapeMatch();
+
+protected:
+	/* 参数 */
+	T diff_incl_max_;		//< 约束: 倾角最大偏差, 量纲: 角度
+	T diff_lnormal_max_;	//< 约束: 归一距离最大偏差
+	int shape_count_min_;	//< 约束: 匹配单元最小数量
+	T scale_low_;			//< 比例尺下限
+	T scale_high_;			//< 比例尺上限
+	T bucket_width_;		//< 比例尺分档宽度, ln(比例尺)
+	int nbucket_;			//< 比例尺分档数量
+	int best_bucket_;		//< 得分最高的比例尺档
+	bool use_quant_;		//< 以16位定点特征比较样本
+	size_t stream_budget_;	//< 流式匹配时集合2匹配单元的内存预算, 量纲: 字节. 0: 不使用流式匹配
+	size_t block_size_;		//< 分块匹配时两个集合特征块的缓存预算, 量纲: 字节. 0: 不分块
+	T rank_margin_;			//< 集合1构建反向匹配单元的亮度差阈值, 量纲: 星等. 0: 不构建
+
+	/* 匹配项 */
+	BuildMatchShape<T> builder_;	//< 匹配单元构建器
+	std::vector<int> id1_;		//< 集合1样本ID
+	std::vector<int> id2_;		//< 集合2样本ID
+	MatchShapeVec<T> shapes1_;	//< 集合1匹配单元. 内存可重复使用
+	MatchShapeVec<T> shapes2_;	//< 集合2匹配单元. 内存可重复使用
+	int nshape1_;				//< 集合1有效匹配单元数量
+	int nshape2_;				//< 集合2有效匹配单元数量
+	const MatchShapeVec<T>* ref2_;		//< 参与匹配的集合2匹配单元: shapes2_或外部构建的匹配单元
+	const std::vector<int>* refid2_;	//< 参与匹配的集合2样本ID: id2_或外部样本ID
+	OptPtPairMSVec votes_;		//< 集合1样本的候选对应关系
+	std::vector<unsigned char> mask_;	//< 样本特征比较结果
+	MatchShapeQ16 quant1_;		//< 集合1定点特征池
+	MatchShapeQ16 quant2_;		//< 集合2定点特征池. 内存可重复使用
+	const MatchShapeQ16* qref2_;	//< 参与匹配的集合2定点特征池: quant2_或外部特征池
+	MatchShapePool<T> pool1_;	//< 集合1特征池
+	MatchShapePool<T> pool2_;	//< 集合2特征池. 内存可重复使用
+	const MatchShapePool<T>* pref2_;	//< 参与匹配的集合2特征池: pool2_或外部特征池
+	std::vector<int> order1_;	//< 流式匹配: 按长度递增排列的集合1匹配单元序号
+	std::vector<T> len1_;		//< 流式匹配: 与order1_对应的集合1匹配单元长度
+
+	/* 比例尺分档 */
+	struct candidate {
+		int i1, i2;		//< 集合1和集合2的匹配单元
+		int bucket;		//< 比例尺档
+	};
+	std::vector<candidate> cands_;	//< 候选匹配单元对. 内存可重复使用
+	std::vector<int> score_;		//< 各比例尺档中多数样本一致的匹配单元对数量
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 设置模型构建与匹配约束参数
+	 * @param param  约束参数
+	 */
+	void SetParameter(const ParamMatchShape& param);
+	/*!
+	 * @brief 设置比例尺范围
+	 * @param low   比例尺下限
+	 * @param high  比例尺上限
+	 */
+	void SetScale(T low, T high);
+	/*!
+	 * @brief 由样本集合1构建匹配单元
+	 * @param pts      样本集合. z: 亮度, 量纲: 星等
+	 * @param len_low  定向点的最小中心距
+	 * @return
+	 * 匹配单元数量不少于阈值时返回true
+	 */
+	bool BuildShape1(const PtMSVec<T>& pts, T len_low);
+	/*!
+	 * @brief 由样本集合2构建匹配单元
+	 * @param pts      样本集合
+	 * @param len_low  定向点的最小中心距
+	 * @return
+	 * 匹配单元数量不少于阈值时返回true
+	 */
+	bool BuildShape2(const PtMSVec<T>& pts, T len_low);
+	/*!
+	 * @brief 使用外部构建的集合2匹配单元, 替代BuildShape2
+	 * @param shapes  匹配单元. 调用者保证其在Match和GetMatchedPair期间有效且不被修改
+	 * @param n       有效匹配单元数量
+	 * @param ids     集合2样本ID
+	 * @param pool    外部构建的特征池. 为空或模型数量不一致时, 引擎自行构建
+	 * @param quant   外部构建的定点特征池. 为空或量化步长不一致时, 启用定点特征的引擎自行构建
+	 * @return
+	 * 匹配单元数量不少于阈值时返回true
+	 * @note
+	 * 外部匹配单元只被读取, 可由多个引擎并发使用
+	 */
+	bool UseShape2(const MatchShapeVec<T>& shapes, int n, const std::vector<int>& ids,
+			const MatchShapePool<T>* pool = NULL, const MatchShapeQ16* quant = NULL);
+	/*!
+	 * @brief 匹配两个集合的匹配单元, 并为样本对投票
+	 * @return
+	 * 成功匹配的匹配单元对数量
+	 */
+	int Match();
+	/*!
+	 * @brief 流式匹配: 分块生成集合2匹配单元, 逐块匹配并投票, 替代BuildShape2和Match
+	 * @param pts      样本集合2
+	 * @param len_low  定向点的最小中心距
+	 * @return
+	 * 成功匹配的匹配单元对数量. 集合2匹配单元数量少于阈值时返回0
+	 * @note
+	 * 每块匹配单元及其定点特征的内存不超过预算, 峰值内存与集合2样本数量无关
+	 */
+	int MatchStream(const PtMSVec<T>& pts, T len_low);
+	/*!
+	 * @brief 提取投票结果
+	 * @param ratio_min  命中率最高与次高的比值阈值
+	 * @param pairs      样本对. id1: 集合1样本ID; id2: 集合2样本ID
+	 * @return
+	 * 样本对数量
+	 */
+	int GetMatchedPair(double ratio_min, PtPairMSVec& pairs);
+	/*!
+	 * @brief 查看集合1的匹配单元数量
+	 */
+	int ShapeCount1() const {
+		return nshape1_;
+	}
+	/*!
+	 * @brief 查看集合2的匹配单元数量
+	 */
+	int ShapeCount2() const {
+		return nshape2_;
+	}
+	/*!
+	 * @brief 查看是否启用流式匹配
+	 */
+	bool Streaming() const {
+		return stream_budget_ > 0;
+	}
+	/*!
+	 * @brief 查看最近一次匹配是否按比例尺分档投票
+	 */
+	bool Bucketed() const {
+		return best_bucket_ >= 0;
+	}
+	/*!
+	 * @brief 查看比例尺分档宽度, ln(比例尺)
+	 */
+	T BucketWidth() const {
+		return bucket_width_;
+	}
+	/*!
+	 * @brief 查看投票采用的比例尺
+	 * @return
+	 * 得分最高的比例尺档的中心. 未分档时返回比例尺范围的几何中心
+	 */
+	T BestScale() const;
+
+protected:
+	/* 功能 */
+	/*!
+	 * @brief 匹配两个匹配单元, 并为样本对投票
+	 * @param i1    集合1匹配单元序号
+	 * @param i2    集合2匹配单元序号
+	 * @param vote  是否投票. false: 仅计数
+	 * @return
+	 * 特征一致的样本对数量
+	 */
+	int match_shape(int i1, int i2, bool vote);
+	/*!
+	 * @brief 计算比例尺所在的档
+	 */
+	int scale_bucket(T scale) const;
+	/*!
+	 * @brief 计算特征块的结束位置
+	 * @param start  匹配单元样本在特征池中的起始位置
+	 * @param k0     特征块的起始匹配单元
+	 * @param n      匹配单元数量
+	 * @param items  每块的样本数量上限. 0: 不分块
+	 * @return
+	 * 特征块的结束匹配单元(不含). 每块至少包含一个匹配单元
+	 */
+	static int block_end(const std::vector<int>& start, int k0, int n, size_t items);
+	/*!
+	 * @brief 由各档得分选择得分最高的相邻三档, 结果存入best_bucket_
+	 */
+	void select_bucket();
+	/*!
+	 * @brief 建立集合1匹配单元的长度索引
+	 */
+	void index_shape1();
 };
 
 #endif /* SHAPEMATCH_H_ */
@@ -0,0 +1,178 @@
+/**
+ * @file SkyTile.cpp
+ * @brief 全天盲匹配的天区划分: 等面积天区, 保证相邻视场的最小重叠
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "ADefine.h"
+#include "SkyTile.h"
+
+using namespace std;
+
+/* 余纬(colat1, lon1)与(colat2, lon2)的角距. 量纲: 弧度 */
+static double colat_distance(double colat1, double lon1, double colat2, double lon2) {
+	double c = cos(colat1) * cos(colat2) + sin(colat1) * sin(colat2) * cos(lon1 - lon2);
+	return acos(c > 1.0 ? 1.0 : (c < -1.0 ? -1.0 : c));
+}
+
+SkyTile::SkyTile() {
+	nring_  = 0;
+	radius_ = 0.0;
+}
+
+SkyTile::~SkyTile() {
+}
+
+double SkyTile::FrameRadius(int w, int h, double scale, double overlap) {
+	if (overlap < 0.0) overlap = 0.0;
+	else if (overlap > 0.99) overlap = 0.99;
+	return (w <= h ? w : h) * scale * 0.5 * (1.0 - overlap) * AS2D;
+}
+
+int SkyTile::Generate(double rmax) {
+	double r = rmax * D2R;
+	if (r >= API) r = API;
+	// 天区内含于其外接圆: 天区数量不少于全天面积与外接圆面积之比
+	int n = int(2.0 / (1.0 - cos(r)));
+	if (n < 1) n = 1;
+	// 外接圆半径随天区数量不严格单调, 逐次增加天区数量, 步长不超过0.5%
+	while ((radius_ = partition(n, tiles_)) > r) n += n < 200 ? 1 : n / 200;
+	radius_ *= R2D;
+	nring_ = tiles_.size() ? tiles_.back().ring + 1 : 0;
+	return tiles_.size();
+}
+
+double SkyTile::partition(int n, SkyTileVec& tiles) {
+	sky_tile tile;
+	tiles.clear();
+	if (n <= 2) {// 单一天区覆盖全天, 或南北半球
+		tile.ra     = 0.0;
+		tile.dec    = 90.0;
+		tile.radius = n == 1 ? 180.0 : 90.0;
+		tile.ring   = 0;
+		tiles.push_back(tile);
+		if (n == 2) {
+			tile.dec  = -90.0;
+			tile.ring = 1;
+			tiles.push_back(tile);
+		}
+		return tile.radius * D2R;
+	}
+
+	/* 极冠: 面积为单个天区面积 */
+	double area  = 4.0 * API / n;			// 单个天区面积, 量纲: 球面度
+	double colat = acos(1.0 - 2.0 / n);		// 极冠余纬
+	double rmax  = colat;
+	tile.ra     = 0.0;
+	tile.dec    = 90.0;
+	tile.radius = colat * R2D;
+	tile.ring   = 0;
+	tiles.push_back(tile);
+
+	/* 赤纬带数量: 带宽接近天区的理想边长 */
+	int nring = int((API - 2.0 * colat) / sqrt(area) + 0.5);
+	if (nring < 1) nring = 1;
+	double width = (API - 2.0 * colat) / nring;
+	double ideal, carry(0.0), top(colat), bottom;
+	int i, j, m, count(1);
+
+	for (i = 1; i <= nring; ++i) {
+		// 赤纬带内的天区数量: 理想值累计取整, 使全部赤纬带的天区总数为n - 2
+		ideal = 2.0 * API * (cos(colat + (i - 1) * width) - cos(colat + i * width)) / area;
+		m = int(floor(ideal + carry + 0.5));
+		if (m < 1) m = 1;
+		carry += ideal - m;
+		// 赤纬带边界由累计面积确定, 天区面积严格相等
+		count += m;
+		bottom = i == nring ? API - colat : acos(1.0 - 2.0 * count / n);
+		// 天区中心与外接圆半径
+		double dlon  = A2PI / m;
+		double cen   = (top + bottom) * 0.5;
+		double r = colat_distance(cen, 0.0, top, dlon * 0.5);
+		double rb = colat_distance(cen, 0.0, bottom, dlon * 0.5);
+		if (rb > r) r = rb;
+		if (r > rmax) rmax = r;
+		// 相邻赤纬带错开半个天区
+		double offset = (i % 2) ? 0.5 : 0.0;
+		for (j = 0; j < m; ++j) {
+			tile.ra     = (j + offset) * dlon * R2D;
+			tile.dec    = 90.0 - cen * R2D;
+			tile.radius = r * R2D;
+			tile.ring   = i;
+			tiles.push_back(tile);
+		}
+		top = bottom;
+	}
+
+	tile.ra     = 0.0;
+	tile.dec    = -90.0;
+	tile.radius = colat * R2D;
+	tile.ring   = nring + 1;
+	tiles.push_back(tile);
+
+	return rmax;
+}
+
+int SkyTile::CullHorizon(double lon, double lat, double mjd, double alt_min) {
+	double lst = (GMST(mjd) + lon) * D2R;
+	double sinlat(sin(lat * D2R)), coslat(cos(lat * D2R));
+	double dec, alt;
+	SkyTileVec::iterator it;
+
+	for (it = tiles_.begin(); it != tiles_.end();) {
+		dec = it->dec * D2R;
+		alt = asin(sinlat * sin(dec) + coslat * cos(dec) * cos(lst - it->ra * D2R)) * R2D;
+		if (alt + it->radius < alt_min) it = tiles_.erase(it);
+		else ++it;
+	}
+	return tiles_.size();
+}
+
+double SkyTile::SortByPrior(double ra, double dec, double sigma) {
+	int n(tiles_.size()), i;
+	if (!n) return 0.0;
+	double ra0(ra * D2R), dec0(dec * D2R);
+	vector<double> dist(n);
+	vector<int> order(n);
+
+	for (i = 0; i < n; ++i) {
+		dist[i]  = colat_distance(API * 0.5 - dec0, ra0, API * 0.5 - tiles_[i].dec * D2R, tiles_[i].ra * D2R);
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(), [&dist](int i1, int i2) {
+		return dist[i1] < dist[i2];
+	});
+	SkyTileVec tiles(n);
+	for (i = 0; i < n; ++i) tiles[i] = tiles_[order[i]];
+	tiles_.swap(tiles);
+
+	/* 尝试天区数量的期望值. 概率以最近天区为基准, 避免下溢 */
+	if (sigma <= 0.0) return 1.0;
+	double s2 = 2.0 * sigma * sigma * D2R * D2R;
+	double d0 = dist[order[0]], d, p, sum(0.0), expect(0.0);
+	for (i = 0; i < n; ++i) {
+		d = dist[order[i]];
+		p = exp((d0 * d0 - d * d) / s2);
+		sum    += p;
+		expect += p * (i + 1);
+	}
+	return expect / sum;
+}
+
+double SkyTile::GMST(double mjd) {
+	double t = (mjd - MJD2K) / DAYS_JC;
+	double gmst = 280.46061837 + 360.98564736629 * (mjd - MJD2K) + t * t * (0.000387933 - t / 38710000.0);
+	return cyclemod(gmst, 360.0);
+}
+
+double SkyTile::MJD(int year, int month, int day, double hours) {
+	// 格里历日期转换为儒略日数, 适用于1582年10月15日之后
+	int a = (14 - month) / 12;
+	int y = year + 4800 - a;
+	int m = month + 12 * a - 3;
+	int jdn = day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045;
+	return jdn - 2400001 + hours / 24.0;
+}
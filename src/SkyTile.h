@@ -0,0 +1,147 @@
+/**
+ * @file SkyTile.h
+ * @brief 全天盲匹配的天区划分: 等面积天区, 保证相邻视场的最小重叠
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 划分方法: 球面递归分区(Leopardi, Recursive Zonal Equal Area Partition)
+ * - 南北极冠各为一个天区, 其余天区分布在若干赤纬带内, 同一赤纬带内的天区赤经宽度相同
+ * - 赤纬带边界由累计面积确定, 全部天区面积严格相等
+ * - 天区中心取赤经中点和余纬中点. 天区由两条赤纬线和两条赤经线围成, 中心到天区边界的
+ *   最大角距在天区角点处取得, 据此计算外接圆半径
+ * - 逐次增加天区数量, 直至全部天区的外接圆半径不大于给定值. 天球上任意一点与其所在天区中心的
+ *   角距不大于该值
+ * @note
+ * 天区列表仅依赖外接圆半径, 与匹配流程无关, 可由任意调度方式使用
+ * @note
+ * 可选的先验信息:
+ * - CullHorizon: 由测站和曝光时间剔除不可见的天区
+ * - SortByPrior: 按先验指向的概率递减排列天区, 减少匹配成功前尝试的天区数量
+ */
+
+#ifndef SKYTILE_H_
+#define SKYTILE_H_
+
+#include <vector>
+
+/*!
+ * @struct sky_tile
+ * @brief 天区
+ */
+struct sky_tile {
+	double ra, dec;	///< 天区中心, 量纲: 角度
+	double radius;	///< 天区外接圆半径, 量纲: 角度
+	int ring;		///< 赤纬带编号. 自北极冠向南递增, 北极冠为0
+};
+typedef std::vector<sky_tile> SkyTileVec;
+
+class SkyTile {
+public:
+	SkyTile();
+	virtual ~SkyTile();
+
+protected:
+	SkyTileVec tiles_;	//< 天区列表
+	int nring_;			//< 赤纬带数量, 含两个极冠
+	double radius_;		//< 全部天区外接圆半径的最大值, 量纲: 角度
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 生成天区列表
+	 * @param rmax  天区外接圆半径上限, 量纲: 角度
+	 * @return
+	 * 天区数量
+	 * @note
+	 * 天区数量为满足半径约束的最小等面积划分. 由视场确定rmax时, 参见FrameRadius
+	 */
+	int Generate(double rmax);
+	/*!
+	 * @brief 由视场计算天区外接圆半径上限
+	 * @param w        图像宽度, 量纲: 像素
+	 * @param h        图像高度, 量纲: 像素
+	 * @param scale    像元比例尺, 量纲: 角秒/像素. 宽范围时取下限, 视场最小
+	 * @param overlap  相邻视场的最小重叠比例, 有效范围: [0, 1)
+	 * @return
+	 * 外接圆半径上限, 量纲: 角度
+	 * @note
+	 * 半径取视场内切圆半径的(1 - overlap)倍. 视场中心与其所在天区中心的角距不大于该半径,
+	 * 相邻天区中心的角距不大于该半径的2倍, 即视场短边的(1 - overlap)倍, 以天区中心指向的
+	 * 相邻视场至少重叠overlap倍短边
+	 */
+	static double FrameRadius(int w, int h, double scale, double overlap);
+	/*!
+	 * @brief 剔除不可见的天区
+	 * @param lon      测站地理经度, 量纲: 角度. 东经为正
+	 * @param lat      测站地理纬度, 量纲: 角度. 北纬为正
+	 * @param mjd      曝光时间, 修正儒略日. UTC
+	 * @param alt_min  最低可观测高度角, 量纲: 角度
+	 * @return
+	 * 可见天区数量
+	 * @note
+	 * 天区中心高度角加外接圆半径低于alt_min时, 天区内的任何指向均不可见
+	 */
+	int CullHorizon(double lon, double lat, double mjd, double alt_min);
+	/*!
+	 * @brief 按先验指向的概率递减排列天区
+	 * @param ra     先验指向赤经, 量纲: 角度
+	 * @param dec    先验指向赤纬, 量纲: 角度
+	 * @param sigma  先验指向的不确定度, 量纲: 角度
+	 * @return
+	 * 匹配成功前尝试天区数量的期望值
+	 * @note
+	 * - 先验为以先验指向为中心的二维高斯分布. 天区面积相等, 其概率正比于中心处的概率密度,
+	 *   排列顺序即与先验指向的角距递增顺序
+	 * - 期望值由各天区概率及其序号计算, 不含已剔除的天区
+	 */
+	double SortByPrior(double ra, double dec, double sigma);
+	/*!
+	 * @brief 计算格林尼治平恒星时
+	 * @param mjd  修正儒略日. 以UTC近似UT1
+	 * @return
+	 * 格林尼治平恒星时, 量纲: 角度
+	 */
+	static double GMST(double mjd);
+	/*!
+	 * @brief 计算修正儒略日
+	 * @param year   年
+	 * @param month  月
+	 * @param day    日
+	 * @param hours  当日时间, 量纲: 小时
+	 * @return
+	 * 修正儒略日
+	 */
+	static double MJD(int year, int month, int day, double hours);
+	/*!
+	 * @brief 查看天区列表
+	 * @return
+	 * 天区列表. 生成后按赤纬带自北向南, 赤纬带内按赤经递增排列
+	 */
+	const SkyTileVec& Tiles() const {
+		return tiles_;
+	}
+	/*!
+	 * @brief 查看赤纬带数量, 含两个极冠
+	 */
+	int RingCount() const {
+		return nring_;
+	}
+	/*!
+	 * @brief 查看全部天区外接圆半径的最大值, 量纲: 角度
+	 */
+	double Radius() const {
+		return radius_;
+	}
+
+protected:
+	/*!
+	 * @brief 将天球划分为n个等面积天区
+	 * @param n      天区数量
+	 * @param tiles  天区列表
+	 * @return
+	 * 全部天区外接圆半径的最大值, 量纲: 弧度
+	 */
+	double partition(int n, SkyTileVec& tiles);
+};
+
+#endif /* SKYTILE_H_ */
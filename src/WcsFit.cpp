@@ -0,0 +1,477 @@
+/**
+ * @file WcsFit.cpp
+ * @brief 全视场WCS拟合: 以匹配的样本对为初值, 交叉匹配全部星像与参考星, 拟合TAN投影和SIP畸变多项式
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "ADefine.h"
+#include "WcsFit.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+/* 多项式的项数. 项按阶数递增排列, 同阶项按v的幂次递增排列 */
+static int term_count(int order) {
+	return (order + 1) * (order + 2) / 2;
+}
+
+/* 四路累加的点积: 各路独立累加, 循环可向量化 */
+static double dot(const double* x1, const double* x2, int n) {
+	double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+	int k, u;
+	for (k = 0; k + 4 <= n; k += 4) {
+		for (u = 0; u < 4; ++u) acc[u] += x1[k + u] * x2[k + u];
+	}
+	for (; k < n; ++k) acc[0] += x1[k] * x2[k];
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+/*!
+ * @brief 计算多项式及其偏导数
+ * @param coef   系数, 按项排列
+ * @param order  阶数
+ * @param u      归一化图像坐标
+ * @param v      归一化图像坐标
+ * @param fu     偏导数: u. 为NULL时不计算偏导数
+ * @param fv     偏导数: v
+ * @return
+ * 多项式值
+ */
+static double poly_eval(const double* coef, int order, double u, double v, double* fu = NULL, double* fv = NULL) {
+	double up[WCSFIT_ORDER_MAX + 1], vp[WCSFIT_ORDER_MAX + 1];
+	double f(0.0), du(0.0), dv(0.0);
+	int d, p, q, t;
+
+	up[0] = vp[0] = 1.0;
+	for (d = 1; d <= order; ++d) {
+		up[d] = up[d - 1] * u;
+		vp[d] = vp[d - 1] * v;
+	}
+	for (d = 0, t = 0; d <= order; ++d) {
+		for (q = 0; q <= d; ++q, ++t) {
+			p = d - q;
+			f += coef[t] * up[p] * vp[q];
+			if (!fu) continue;
+			if (p) du += coef[t] * p * up[p - 1] * vp[q];
+			if (q) dv += coef[t] * q * up[p] * vp[q - 1];
+		}
+	}
+	if (fu) {
+		*fu = du;
+		*fv = dv;
+	}
+	return f;
+}
+
+/*!
+ * @brief 平移多项式的原点: 求新原点坐标下的系数
+ * @note
+ * c(u + du, v + dv)按二项式展开
+ */
+static void poly_shift(double* coef, int order, double du, double dv) {
+	double binom[WCSFIT_ORDER_MAX + 1][WCSFIT_ORDER_MAX + 1];
+	double dup[WCSFIT_ORDER_MAX + 1], dvp[WCSFIT_ORDER_MAX + 1];
+	double shifted[(WCSFIT_ORDER_MAX + 1) * (WCSFIT_ORDER_MAX + 2) / 2];
+	int n(term_count(order)), d, p, q, i, j, t, s;
+
+	for (i = 0; i <= order; ++i) {
+		binom[i][0] = binom[i][i] = 1.0;
+		for (j = 1; j < i; ++j) binom[i][j] = binom[i - 1][j - 1] + binom[i - 1][j];
+	}
+	dup[0] = dvp[0] = 1.0;
+	for (d = 1; d <= order; ++d) {
+		dup[d] = dup[d - 1] * du;
+		dvp[d] = dvp[d - 1] * dv;
+	}
+	for (t = 0; t < n; ++t) shifted[t] = 0.0;
+	for (d = 0, t = 0; d <= order; ++d) {
+		for (q = 0; q <= d; ++q, ++t) {
+			p = d - q;
+			// u^p * v^q展开为u^i * v^j, i <= p, j <= q
+			for (i = 0; i <= p; ++i) {
+				for (j = 0; j <= q; ++j) {
+					s = term_count(i + j - 1) + j;
+					shifted[s] += coef[t] * binom[p][i] * binom[q][j] * dup[p - i] * dvp[q - j];
+				}
+			}
+		}
+	}
+	for (t = 0; t < n; ++t) coef[t] = shifted[t];
+}
+
+/*!
+ * @brief Cholesky分解求解对称正定线性方程组
+ * @param a  系数矩阵, n*n, 行主序. 分解后下三角为L
+ * @param b  右端项, 求解后为解. 与a共用分解, 依次求解nrhs组
+ * @return
+ * 矩阵正定时返回true
+ */
+static bool cholesky_solve(double* a, int n, double* b, int nrhs) {
+	int i, j, k, r;
+	double s;
+
+	for (j = 0; j < n; ++j) {
+		s = a[j * n + j];
+		for (k = 0; k < j; ++k) s -= a[j * n + k] * a[j * n + k];
+		if (s <= 0.0) return false;
+		a[j * n + j] = sqrt(s);
+		for (i = j + 1; i < n; ++i) {
+			s = a[i * n + j];
+			for (k = 0; k < j; ++k) s -= a[i * n + k] * a[j * n + k];
+			a[i * n + j] = s / a[j * n + j];
+		}
+	}
+	for (r = 0; r < nrhs; ++r, b += n) {
+		for (i = 0; i < n; ++i) {// L * y = b
+			s = b[i];
+			for (k = 0; k < i; ++k) s -= a[i * n + k] * b[k];
+			b[i] = s / a[i * n + i];
+		}
+		for (i = n - 1; i >= 0; --i) {// L' * x = y
+			s = b[i];
+			for (k = i + 1; k < n; ++k) s -= a[k * n + i] * b[k];
+			b[i] = s / a[i * n + i];
+		}
+	}
+	return true;
+}
+
+/*!
+ * @brief 计算两个切平面之间的旋转矩阵
+ * @param l1   切平面1的切点, 量纲: 弧度
+ * @param b1   切平面1的切点, 量纲: 弧度
+ * @param l2   切平面2的切点, 量纲: 弧度
+ * @param b2   切平面2的切点, 量纲: 弧度
+ * @param rot  旋转矩阵. 切平面1的坐标(xi, eta, 1)左乘该矩阵得到(xi', eta', 1)的同向矢量
+ * @note
+ * 切平面的基矢量: xi方向, eta方向, 切点方向. 矩阵元素为切平面2与切平面1基矢量的点积
+ */
+static void plane_rotation(double l1, double b1, double l2, double b2, double rot[3][3]) {
+	double e1[3][3] = {
+		{ -sin(l1), cos(l1), 0.0 },
+		{ -sin(b1) * cos(l1), -sin(b1) * sin(l1), cos(b1) },
+		{ cos(b1) * cos(l1), cos(b1) * sin(l1), sin(b1) }
+	};
+	double e2[3][3] = {
+		{ -sin(l2), cos(l2), 0.0 },
+		{ -sin(b2) * cos(l2), -sin(b2) * sin(l2), cos(b2) },
+		{ cos(b2) * cos(l2), cos(b2) * sin(l2), sin(b2) }
+	};
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) rot[i][j] = e2[i][0] * e1[j][0] + e2[i][1] * e1[j][1] + e2[i][2] * e1[j][2];
+	}
+}
+
+WcsFit::WcsFit() {
+	order_  = 3;
+	radius_ = 10.0;
+	niter_  = 6;
+	clip_   = 3.0;
+	tanl_ = tanb_ = 0.0;
+	x0_ = y0_ = 0.0;
+	norm_ = 1.0;
+	order_fit_ = 0;
+}
+
+WcsFit::~WcsFit() {
+}
+
+void WcsFit::SetParameter(const ParamMatchShape& param) {
+	order_  = param.wcsfit_order;
+	radius_ = param.wcsfit_radius;
+	niter_  = param.wcsfit_iteration;
+	clip_   = param.wcsfit_clip;
+	if (order_ < 1) order_ = 1;
+	else if (order_ > WCSFIT_ORDER_MAX) order_ = WCSFIT_ORDER_MAX;
+	if (niter_ < 1) niter_ = 1;
+}
+
+bool WcsFit::Fit(const MatchRefsys& match, int w, int h) {
+	const MatchRefsys::solution& sol = match.GetSolution();
+	const MatchRefsys::ObjImgVec& objimg = match.GetImageObject();
+	const MatchRefsys::ObjWcsVec& objwcs = match.GetWcsObject();
+	const PtPairMSVec& pairs = match.GetMatchedPair();
+	int nimg(objimg.size()), nwcs(objwcs.size()), i;
+
+	wcs_ = wcs_sip();
+	pairs_.clear();
+	if (pairs.size() < 3) return false;
+
+	/* 切点与多项式原点. 世界目标重新投影至以定位解中心为切点的切平面 */
+	tanl_ = sol.ra * D2R;
+	tanb_ = sol.dec * D2R;
+	x0_   = w * 0.5;
+	y0_   = h * 0.5;
+	norm_ = (w >= h ? w : h) * 0.5;
+	imgx_.resize(nimg);
+	imgy_.resize(nimg);
+	imgord_.resize(nimg);
+	for (i = 0; i < nimg; ++i) {
+		imgx_[i] = objimg[i].x;
+		imgy_[i] = objimg[i].y;
+		imgord_[i] = i;
+	}
+	// 交叉匹配时按条带内X递增的顺序查找, 相邻查找访问k-d树的相同分支
+	double band = norm_ / 32.0;
+	sort(imgord_.begin(), imgord_.end(), [this, band](int i1, int i2) {
+		int b1(int(imgy_[i1] / band)), b2(int(imgy_[i2] / band));
+		return b1 < b2 || (b1 == b2 && imgx_[i1] < imgx_[i2]);
+	});
+	/* 世界目标由匹配系统的切平面转换至以定位解中心为切点的切平面 */
+	const MatchRefsys::refcenter& ref = match.GetWcsCenter();
+	double rot[3][3], z;
+	plane_rotation(ref.x, ref.y, tanl_, tanb_, rot);
+	refxi_.resize(nwcs);
+	refeta_.resize(nwcs);
+	for (i = 0; i < nwcs; ++i) {
+		const MatchRefsys::object_wcs& obj = objwcs[i];
+		z = rot[2][0] * obj.x + rot[2][1] * obj.y + rot[2][2];
+		if (z <= 0.0) {// 背向切点
+			refxi_[i] = refeta_[i] = 1E6;
+			continue;
+		}
+		refxi_[i]  = (rot[0][0] * obj.x + rot[0][1] * obj.y + rot[0][2]) / z;
+		refeta_[i] = (rot[1][0] * obj.x + rot[1][1] * obj.y + rot[1][2]) / z;
+	}
+
+	/* 由样本对拟合线性TAN解 */
+	pairs_.assign(pairs.begin(), pairs.end());
+	if (!fit_poly(1)) return false;
+	double det = coefxi_[1] * coefeta_[2] - coefxi_[2] * coefeta_[1];
+	if (det == 0.0) return false;
+
+	/* 视场内的参考星: 线性解预测的图像坐标在图像内, 边缘外延初始搜索半径. 建立k-d树 */
+	double xlim((x0_ + radius_) / norm_), ylim((y0_ + radius_) / norm_), dxi, deta, u, v;
+	int n(0);
+	refid_.clear();
+	local_.assign(nwcs, -1);
+	for (i = 0; i < nwcs; ++i) {
+		dxi  = refxi_[i] - coefxi_[0];
+		deta = refeta_[i] - coefeta_[0];
+		u = (coefeta_[2] * dxi - coefxi_[2] * deta) / det;
+		v = (coefxi_[1] * deta - coefeta_[1] * dxi) / det;
+		if (fabs(u) > xlim || fabs(v) > ylim) continue;
+		local_[i]  = n;
+		refxi_[n]  = refxi_[i];
+		refeta_[n] = refeta_[i];
+		refid_.push_back(i);
+		++n;
+	}
+	refxi_.resize(n);
+	refeta_.resize(n);
+	tree_.Build(refxi_.data(), refeta_.data(), n);
+	for (i = 0, n = 0; i < int(pairs_.size()); ++i) {
+		if (local_[pairs_[i].id2] >= 0) pairs_[n++] = PointPairMS(pairs_[i].id1, local_[pairs_[i].id2]);
+	}
+	pairs_.resize(n);
+	double rms = residual();
+	double r(radius_), rms_last(0.0);
+	bool success(true);
+	int last(-1);
+
+	/* 迭代: 交叉匹配、拟合与剔除. 阶数逐次增加, 达到设定阶数后收紧搜索半径 */
+	for (int iter = 1; iter <= niter_; ++iter) {
+		int order = iter < order_ ? iter : order_;
+		success = cross_match(r) >= 3 && fit_poly(order);
+		if (!success) break;
+		rms = residual();
+		if (reject(clip_ * rms)) {
+			if (!(success = fit_poly(order))) break;
+			rms = residual();
+		}
+		if (order < order_) continue;
+		// 达到设定阶数后, 样本对和残差不再变化时结束迭代
+		if (int(pairs_.size()) == last && fabs(rms - rms_last) <= rms * 1E-3) break;
+		last     = pairs_.size();
+		rms_last = rms;
+		if (2.0 * clip_ * rms < r) r = 2.0 * clip_ * rms;
+	}
+	if (!success) {
+		pairs_.clear();
+		return false;
+	}
+	to_sip(rms);
+	// 样本对的参考星ID恢复为世界目标ID
+	for (i = 0; i < int(pairs_.size()); ++i) pairs_[i].id2 = refid_[pairs_[i].id2];
+	return true;
+}
+
+void WcsFit::Image2World(double x, double y, double& ra, double& dec) const {
+	double up[WCSFIT_ORDER_MAX + 1], vp[WCSFIT_ORDER_MAX + 1];
+	double u(x - wcs_.crpix[0]), v(y - wcs_.crpix[1]), f(0.0), g(0.0);
+	int p, q;
+
+	up[0] = vp[0] = 1.0;
+	for (p = 1; p <= wcs_.order; ++p) {
+		up[p] = up[p - 1] * u;
+		vp[p] = vp[p - 1] * v;
+	}
+	for (p = 0; p <= wcs_.order; ++p) {
+		for (q = 0; p + q <= wcs_.order; ++q) {
+			if (p + q < 2) continue;
+			f += wcs_.a[p][q] * up[p] * vp[q];
+			g += wcs_.b[p][q] * up[p] * vp[q];
+		}
+	}
+	u += f;
+	v += g;
+	double xi  = (wcs_.cd[0][0] * u + wcs_.cd[0][1] * v) * D2R;
+	double eta = (wcs_.cd[1][0] * u + wcs_.cd[1][1] * v) * D2R;
+	plane2sphere(xi, eta, ra, dec);
+	ra  *= R2D;
+	dec *= R2D;
+}
+
+void WcsFit::plane2sphere(double xi, double eta, double &l, double &b) const {
+	double fract = cos(tanb_) - eta * sin(tanb_);
+	l = cyclemod(tanl_ + atan2(xi, fract), A2PI);
+	b = atan2((eta * cos(tanb_) + sin(tanb_)) * cos(l - tanl_), fract);
+}
+
+void WcsFit::predict(double x, double y, double &xi, double &eta) const {
+	double u((x - x0_) / norm_), v((y - y0_) / norm_);
+	xi  = poly_eval(coefxi_.data(), order_fit_, u, v);
+	eta = poly_eval(coefeta_.data(), order_fit_, u, v);
+}
+
+int WcsFit::cross_match(double r) {
+	/* 搜索半径换算为切平面尺度: 一次项的行列式为像元面积 */
+	double scale = sqrt(fabs(coefxi_[1] * coefeta_[2] - coefxi_[2] * coefeta_[1])) / norm_;
+	double rr(r * scale), xi, eta, d2;
+	int nimg(imgx_.size()), nwcs(refxi_.size()), i, j, k;
+
+	owner_.assign(nwcs, -1);
+	dist_.assign(nwcs, DBL_MAX);
+	for (k = 0; k < nimg; ++k) {
+		i = imgord_[k];
+		predict(imgx_[i], imgy_[i], xi, eta);
+		if ((j = tree_.Nearest(xi, eta, rr, d2)) >= 0 && d2 < dist_[j]) {
+			owner_[j] = i;
+			dist_[j]  = d2;
+		}
+	}
+	// 每颗参考星保留最近的星像
+	pairs_.clear();
+	for (j = 0; j < nwcs; ++j) {
+		if (owner_[j] >= 0) pairs_.push_back(PointPairMS(owner_[j], j));
+	}
+	return pairs_.size();
+}
+
+bool WcsFit::fit_poly(int order) {
+	int n(pairs_.size()), nt, d, q, t, i, j, k;
+	// 样本对不足时降低阶数: 样本对数量不少于项数的3倍
+	while (order > 1 && n < 3 * term_count(order)) --order;
+	if (n < term_count(order)) return false;
+	nt = term_count(order);
+
+	/* 基函数值按列存储: 高次项由低次项乘以u或v递推 */
+	basis_.resize(size_t(nt + 2) * n);
+	double* xi  = basis_.data() + size_t(nt) * n;
+	double* eta = xi + n;
+	for (k = 0; k < n; ++k) {
+		basis_[k]     = 1.0;
+		basis_[n + k] = (imgx_[pairs_[k].id1] - x0_) / norm_;
+		basis_[2 * n + k] = (imgy_[pairs_[k].id1] - y0_) / norm_;
+		xi[k]  = refxi_[pairs_[k].id2];
+		eta[k] = refeta_[pairs_[k].id2];
+	}
+	for (d = 2, t = 3; d <= order; ++d) {
+		for (q = 0; q <= d; ++q, ++t) {
+			double* col = basis_.data() + size_t(t) * n;
+			// u^p * v^q = u * u^(p-1) * v^q; q == d时 = v * v^(q-1)
+			const double* prev = basis_.data() + size_t(q < d ? term_count(d - 2) + q : term_count(d - 2) + q - 1) * n;
+			const double* mul  = basis_.data() + size_t(q < d ? 1 : 2) * n;
+			for (k = 0; k < n; ++k) col[k] = prev[k] * mul[k];
+		}
+	}
+
+	/* 法方程: 矩阵元素为两列的点积 */
+	vector<double> a(nt * nt), b(2 * nt);
+	for (i = 0; i < nt; ++i) {
+		const double* col = basis_.data() + size_t(i) * n;
+		for (j = 0; j <= i; ++j) a[i * nt + j] = a[j * nt + i] = dot(col, basis_.data() + size_t(j) * n, n);
+		b[i]      = dot(col, xi, n);
+		b[nt + i] = dot(col, eta, n);
+	}
+	if (!cholesky_solve(a.data(), nt, b.data(), 2)) return false;
+	coefxi_.assign(b.begin(), b.begin() + nt);
+	coefeta_.assign(b.begin() + nt, b.end());
+	order_fit_ = order;
+	return true;
+}
+
+double WcsFit::residual() {
+	double scale = sqrt(fabs(coefxi_[1] * coefeta_[2] - coefxi_[2] * coefeta_[1])) / norm_;
+	double xi, eta, dxi, deta, sum(0.0);
+	int n(pairs_.size());
+
+	resid_.resize(n);
+	for (int k = 0; k < n; ++k) {
+		predict(imgx_[pairs_[k].id1], imgy_[pairs_[k].id1], xi, eta);
+		dxi  = xi - refxi_[pairs_[k].id2];
+		deta = eta - refeta_[pairs_[k].id2];
+		resid_[k] = sqrt(dxi * dxi + deta * deta) / scale;
+		sum += resid_[k] * resid_[k];
+	}
+	return n ? sqrt(sum / n) : 0.0;
+}
+
+int WcsFit::reject(double limit) {
+	int n(pairs_.size()), k, m(0);
+	for (k = 0; k < n; ++k) {
+		if (resid_[k] > limit) continue;
+		pairs_[m] = pairs_[k];
+		resid_[m] = resid_[k];
+		++m;
+	}
+	pairs_.resize(m);
+	resid_.resize(m);
+	return n - m;
+}
+
+void WcsFit::to_sip(double rms) {
+	int order(order_fit_), nt(term_count(order_fit_)), d, p, q, t, i;
+	double u(0.0), v(0.0), f, g, fu, fv, gu, gv, det;
+
+	/* 牛顿迭代求多项式零点, 即切点的图像坐标. 零点作为SIP原点 */
+	for (i = 0; i < 10; ++i) {
+		f = poly_eval(coefxi_.data(), order, u, v, &fu, &fv);
+		g = poly_eval(coefeta_.data(), order, u, v, &gu, &gv);
+		if ((det = fu * gv - fv * gu) == 0.0) break;
+		double du((f * gv - g * fv) / det), dv((g * fu - f * gu) / det);
+		u -= du;
+		v -= dv;
+		if (fabs(du) + fabs(dv) < 1E-12) break;
+	}
+	vector<double> cx(coefxi_), ce(coefeta_);
+	poly_shift(cx.data(), order, u, v);
+	poly_shift(ce.data(), order, u, v);
+
+	/* CD矩阵: 一次项. SIP系数: 高次项左乘CD矩阵的逆 */
+	double cd[2][2] = { { cx[1] / norm_, cx[2] / norm_ }, { ce[1] / norm_, ce[2] / norm_ } };
+	det = cd[0][0] * cd[1][1] - cd[0][1] * cd[1][0];
+	wcs_.crval[0] = tanl_ * R2D;
+	wcs_.crval[1] = tanb_ * R2D;
+	wcs_.crpix[0] = x0_ + u * norm_;
+	wcs_.crpix[1] = y0_ + v * norm_;
+	wcs_.cd[0][0] = cd[0][0] * R2D;
+	wcs_.cd[0][1] = cd[0][1] * R2D;
+	wcs_.cd[1][0] = cd[1][0] * R2D;
+	wcs_.cd[1][1] = cd[1][1] * R2D;
+	wcs_.order    = order;
+	for (d = 2, t = 3; d <= order; ++d) {
+		double s = pow(norm_, d);
+		for (q = 0; q <= d && t < nt; ++q, ++t) {
+			p = d - q;
+			wcs_.a[p][q] = ( cd[1][1] * cx[t] - cd[0][1] * ce[t]) / det / s;
+			wcs_.b[p][q] = (-cd[1][0] * cx[t] + cd[0][0] * ce[t]) / det / s;
+		}
+	}
+	wcs_.rms     = rms;
+	wcs_.matched = pairs_.size();
+}
@@ -0,0 +1,179 @@
+/**
+ * @file WcsFit.h
+ * @brief 全视场WCS拟合: 以匹配的样本对为初值, 交叉匹配全部星像与参考星, 拟合TAN投影和SIP畸变多项式
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 函数调用流程:
+ * - SetParameter
+ * - Fit: 在MatchRefsys::DoMatch或DoTrack成功后调用
+ * - GetWcs, GetMatchedPair, Image2World: 查看拟合结果
+ * @note
+ * 拟合流程:
+ * - 以定位解的中心为切点(CRVAL), 图像中心为参考像素(CRPIX). 参考星由匹配系统的切平面旋转至该切平面
+ * - 由样本对拟合线性TAN解. 预测图像坐标在图像内的参考星建立k-d树
+ * - 迭代: 以当前解计算全部星像的切平面坐标, 在k-d树中搜索最近的参考星, 每颗参考星保留最近的星像;
+ *   以最小二乘拟合多项式, 剔除残差大于阈值的样本对后重新拟合; 以残差收紧搜索半径.
+ *   多项式阶数逐次增加至设定阶数
+ * - 多项式的零点并入CRPIX, 一次项为CD矩阵, 高次项按SIP约定转换为A/B系数
+ * @note
+ * 最小二乘: 基函数值按列连续存储, 法方程矩阵的元素为两列的点积, 以Cholesky分解求解.
+ * 图像坐标以半幅宽度归一化, 抑制高次项的病态
+ */
+
+#ifndef WCSFIT_H_
+#define WCSFIT_H_
+
+#include <vector>
+#include "KdTree.h"
+#include "MatchRefsys.h"
+
+#define WCSFIT_ORDER_MAX	5	//< 多项式的最高阶数
+
+class WcsFit {
+public:
+	WcsFit();
+	virtual ~WcsFit();
+
+public:
+	/* 数据类型 */
+	/*!
+	 * @struct wcs_sip TAN-SIP投影
+	 * @note
+	 * 像素坐标到切平面坐标:
+	 *   u = x - crpix[0], v = y - crpix[1]
+	 *   (xi, eta) = cd * (u + f(u, v), v + g(u, v))
+	 *   f(u, v) = sum(a[p][q] * u^p * v^q), g(u, v) = sum(b[p][q] * u^p * v^q), 2 <= p + q <= order
+	 */
+	struct wcs_sip {
+		double crval[2];	//< 切点的世界坐标, 量纲: 角度
+		double crpix[2];	//< 参考像素, 与导入的图像坐标一致
+		double cd[2][2];	//< 线性变换, 量纲: 角度/像素
+		int order;			//< SIP阶数. 小于2时无畸变项
+		double a[WCSFIT_ORDER_MAX + 1][WCSFIT_ORDER_MAX + 1];	//< SIP系数: X
+		double b[WCSFIT_ORDER_MAX + 1][WCSFIT_ORDER_MAX + 1];	//< SIP系数: Y
+		double rms;			//< 残差, 量纲: 像素
+		int matched;		//< 参与拟合的样本对数量
+
+	public:
+		wcs_sip() {
+			crval[0] = crval[1] = crpix[0] = crpix[1] = 0.0;
+			cd[0][0] = cd[0][1] = cd[1][0] = cd[1][1] = 0.0;
+			order   = 0;
+			rms     = 0.0;
+			matched = 0;
+			for (int p = 0; p <= WCSFIT_ORDER_MAX; ++p) {
+				for (int q = 0; q <= WCSFIT_ORDER_MAX; ++q) a[p][q] = b[p][q] = 0.0;
+			}
+		}
+	};
+
+protected:
+	/* 参数 */
+	int order_;			//< 多项式阶数
+	double radius_;		//< 初始搜索半径, 量纲: 像素
+	int niter_;			//< 最大迭代次数
+	double clip_;		//< 剔除阈值: 残差与均方根之比
+
+	/* 数据 */
+	double tanl_, tanb_;		//< 切点, 量纲: 弧度
+	double x0_, y0_;			//< 多项式的原点, 量纲: 像素
+	double norm_;				//< 图像坐标的归一化尺度, 量纲: 像素
+	std::vector<double> imgx_, imgy_;	//< 星像坐标, 量纲: 像素
+	std::vector<int> imgord_;	//< 星像的查找顺序: 按条带排列
+	std::vector<double> refxi_, refeta_;	//< 视场内参考星的切平面坐标, 量纲: 弧度
+	std::vector<int> refid_;	//< 视场内参考星对应的世界目标ID
+	std::vector<int> local_;	//< 世界目标对应的视场内参考星ID. -1: 视场外
+	KdTree tree_;				//< 参考星的k-d树
+	PtPairMSVec pairs_;			//< 样本对: 星像ID-视场内参考星ID. 拟合成功后为星像ID-世界目标ID
+	std::vector<int> owner_;	//< 参考星对应的星像ID
+	std::vector<double> dist_;	//< 参考星与星像预测位置的距离平方
+
+	/* 拟合 */
+	int order_fit_;					//< 当前多项式阶数
+	std::vector<double> coefxi_;	//< 多项式系数: xi
+	std::vector<double> coefeta_;	//< 多项式系数: eta
+	std::vector<double> basis_;		//< 基函数值, 按列连续存储
+	std::vector<double> resid_;		//< 样本对残差, 量纲: 像素
+	wcs_sip wcs_;					//< 拟合结果
+
+public:
+	/* 接口 */
+	/*!
+	 * @brief 设置拟合参数
+	 * @param param  参数
+	 */
+	void SetParameter(const ParamMatchShape& param);
+	/*!
+	 * @brief 拟合全视场WCS
+	 * @param match  匹配系统. 已匹配成功, 使用其定位解、样本对以及全部图像和世界目标
+	 * @param w      图像宽度, 量纲: 像素
+	 * @param h      图像高度, 量纲: 像素
+	 * @return
+	 * 拟合结果
+	 */
+	bool Fit(const MatchRefsys& match, int w, int h);
+	/*!
+	 * @brief 查看拟合结果
+	 */
+	const wcs_sip& GetWcs() const {
+		return wcs_;
+	}
+	/*!
+	 * @brief 查看交叉匹配的样本对
+	 * @return
+	 * 样本对. id1: 图像目标ID; id2: 世界目标ID, 与MatchRefsys一致
+	 */
+	const PtPairMSVec& GetMatchedPair() const {
+		return pairs_;
+	}
+	/*!
+	 * @brief 由拟合结果计算图像坐标对应的世界坐标
+	 * @param x    图像坐标
+	 * @param y    图像坐标
+	 * @param ra   赤经, 量纲: 角度
+	 * @param dec  赤纬, 量纲: 角度
+	 */
+	void Image2World(double x, double y, double& ra, double& dec) const;
+
+protected:
+	/* 功能 */
+	void plane2sphere(double xi, double eta, double &l, double &b) const;
+	/*!
+	 * @brief 由当前多项式计算图像坐标对应的切平面坐标
+	 */
+	void predict(double x, double y, double &xi, double &eta) const;
+	/*!
+	 * @brief 交叉匹配全部星像与参考星
+	 * @param r  搜索半径, 量纲: 像素
+	 * @return
+	 * 样本对数量
+	 */
+	int cross_match(double r);
+	/*!
+	 * @brief 由样本对拟合多项式
+	 * @param order  阶数. 样本对不足时降低阶数
+	 * @return
+	 * 拟合结果
+	 */
+	bool fit_poly(int order);
+	/*!
+	 * @brief 计算样本对残差
+	 * @return
+	 * 残差均方根, 量纲: 像素
+	 */
+	double residual();
+	/*!
+	 * @brief 剔除残差大于阈值的样本对
+	 * @return
+	 * 剔除数量
+	 */
+	int reject(double limit);
+	/*!
+	 * @brief 将多项式转换为TAN-SIP投影
+	 * @param rms  残差均方根
+	 */
+	void to_sip(double rms);
+};
+
+#endif /* WCSFIT_H_ */
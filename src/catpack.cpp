@@ -0,0 +1,212 @@
+/**
+ * @file catpack.cpp
+ * @brief 将原始格式的Tycho2星表转换为紧凑格式(ACatPack.h)或内存映射格式(ACatMmap.h)
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 命令行参数:
+ * - -m 子天区划分数. 指定时输出内存映射格式, 否则输出紧凑格式
+ * - 原始星表文件路径
+ * - 输出星表文件路径
+ * @note
+ * 原始格式: 2.5度天区索引(tycho2_asc) + 恒星数据(tycho2_elem)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include "ADefine.h"
+#include "ACatTycho2.h"
+#include "ACatPack.h"
+#include "ACatMmap.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+#define CAT_STEP	2.5		// 原始格式天区步长, 量纲: 角度
+
+/*!
+ * @brief 读取原始格式中一个天区的恒星
+ */
+bool read_zone(FILE *fpin, const vector<tycho2_asc>& asc, int zc, vector<tycho2_elem>& stars) {
+	stars.resize(asc[zc].number);
+	if (stars.empty()) return true;
+	fseek(fpin, (long) asc.size() * sizeof(tycho2_asc) + (long) asc[zc].start * sizeof(tycho2_elem), SEEK_SET);
+	return fread(stars.data(), sizeof(tycho2_elem), stars.size(), fpin) == stars.size();
+}
+
+int pack_compact(FILE *fpin, const vector<tycho2_asc>& asc, FILE *fpout) {
+	catpack_header header;
+	memcpy(header.magic, CATPACK_MAGIC, sizeof(header.magic));
+	header.step  = int(MILLIAS * CAT_STEP);
+	header.nZR   = int(360.001 / CAT_STEP);
+	header.nZD   = int(180.001 / CAT_STEP);
+	header.nstar = 0;
+
+	int nasc = header.nZR * header.nZD;
+	vector<catpack_zone> zones(nasc);
+	vector<tycho2_elem> stars;
+	vector<unsigned char> block;
+	unsigned int offset(0);
+
+	// 先占位文件头和索引, 数据块写完后回填
+	fwrite(&header, sizeof(catpack_header), 1, fpout);
+	fwrite(zones.data(), sizeof(catpack_zone), nasc, fpout);
+
+	for (int zd = 0, zc = 0; zd < header.nZD; ++zd) {
+		for (int zr = 0; zr < header.nZR; ++zr, ++zc) {
+			int ra0(zr * header.step), spd0(zd * header.step);
+			int number = asc[zc].number;
+
+			zones[zc].offset = offset;
+			zones[zc].number = number;
+			zones[zc].bytes  = 0;
+			zones[zc].checksum = catpack_adler32(NULL, 0);
+			if (number == 0) continue;
+
+			if (!read_zone(fpin, asc, zc, stars)) {
+				printf ("failed to read zone[%d, %d]\n", zr, zd);
+				return -2;
+			}
+			// 编码以天区边界为原点, 不在天区内的恒星无法表示
+			for (int i = 0; i < number; ++i) {
+				if (stars[i].ra < ra0 || stars[i].ra - ra0 >= (1 << 24) || stars[i].spd < spd0) {
+					printf ("star out of zone[%d, %d]: ra = %d, spd = %d\n", zr, zd, stars[i].ra, stars[i].spd);
+					return -4;
+				}
+			}
+			catpack_encode(stars.data(), number, ra0, spd0, block);
+			fwrite(block.data(), 1, block.size(), fpout);
+			zones[zc].bytes    = block.size();
+			zones[zc].checksum = catpack_adler32(block.data(), block.size());
+			offset += block.size();
+			header.nstar += number;
+		}
+	}
+
+	fseek(fpout, 0, SEEK_SET);
+	fwrite(&header, sizeof(catpack_header), 1, fpout);
+	fwrite(zones.data(), sizeof(catpack_zone), nasc, fpout);
+
+	printf ("%u stars: %.2f bytes/star, data %u bytes\n", header.nstar,
+			header.nstar ? double(offset) / header.nstar : 0.0, offset);
+	return 0;
+}
+
+int pack_mmap(FILE *fpin, const vector<tycho2_asc>& asc, int nsub, FILE *fpout) {
+	catmmap_header header;
+	memset(&header, 0, sizeof(catmmap_header));
+	memcpy(header.magic, CATMMAP_MAGIC, sizeof(header.magic));
+	header.step  = int(MILLIAS * CAT_STEP);
+	header.nsub  = nsub;
+	header.nZR   = int(360.001 / CAT_STEP);
+	header.nZD   = int(180.001 / CAT_STEP);
+
+	int n0 = header.nZR * header.nZD;
+	int nsub2 = nsub * nsub;
+	int substep = header.step / nsub;
+	vector<catmmap_zone> zone0(n0), zone1(n0 * nsub2);
+	vector<tycho2_elem> stars;
+	vector<int> subid;
+	vector<int> order;
+
+	fwrite(&header, sizeof(catmmap_header), 1, fpout);
+	fwrite(zone0.data(), sizeof(catmmap_zone), zone0.size(), fpout);
+	fwrite(zone1.data(), sizeof(catmmap_zone), zone1.size(), fpout);
+
+	for (int zd = 0, zc = 0; zd < header.nZD; ++zd) {
+		for (int zr = 0; zr < header.nZR; ++zr, ++zc) {
+			int ra0(zr * header.step), spd0(zd * header.step);
+			int number = asc[zc].number;
+			ptr_catmmap_zone sub = zone1.data() + zc * nsub2;
+
+			if (!read_zone(fpin, asc, zc, stars)) {
+				printf ("failed to read zone[%d, %d]\n", zr, zd);
+				return -2;
+			}
+			// 子天区编号, 天区内按子天区和星等排序
+			subid.resize(number);
+			order.resize(number);
+			for (int k = 0; k < number; ++k) {
+				int i = (stars[k].ra  - ra0)  / substep;
+				int j = (stars[k].spd - spd0) / substep;
+				i = i < 0 ? 0 : (i >= nsub ? nsub - 1 : i);
+				j = j < 0 ? 0 : (j >= nsub ? nsub - 1 : j);
+				subid[k] = j * nsub + i;
+				order[k] = k;
+			}
+			stable_sort(order.begin(), order.end(), [&](int k1, int k2) {
+				return subid[k1] < subid[k2] || (subid[k1] == subid[k2] && stars[k1].mag < stars[k2].mag);
+			});
+
+			zone0[zc].start  = header.nstar;
+			zone0[zc].number = number;
+			for (int k = 0; k < nsub2; ++k) {
+				sub[k].start  = header.nstar;
+				sub[k].number = 0;
+			}
+			for (int k = 0; k < number; ++k) {
+				const tycho2_elem& star = stars[order[k]];
+				int s = subid[order[k]];
+				if (!sub[s].number) sub[s].start = header.nstar + k;
+				++sub[s].number;
+				fwrite(&star, sizeof(tycho2_elem), 1, fpout);
+			}
+			header.nstar += number;
+		}
+	}
+
+	fseek(fpout, 0, SEEK_SET);
+	fwrite(&header, sizeof(catmmap_header), 1, fpout);
+	fwrite(zone0.data(), sizeof(catmmap_zone), zone0.size(), fpout);
+	fwrite(zone1.data(), sizeof(catmmap_zone), zone1.size(), fpout);
+
+	printf ("%u stars, %d x %d sub-zones per %.1f degree zone\n", header.nstar, nsub, nsub, CAT_STEP);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int nsub(0), ch, rslt;
+
+	while ((ch = getopt(argc, argv, "m:")) != -1) {
+		switch (ch) {
+		case 'm':
+			nsub = atoi(optarg);
+			break;
+		default:
+			break;
+		}
+	}
+	if (argc - optind < 2 || (nsub && (nsub < 1 || int(MILLIAS * CAT_STEP) % nsub))) {
+		printf ("Usage: catpack [-m nsub] <tycho2.dat> <output.dat>\n");
+		return -1;
+	}
+
+	const char *pathin(argv[optind]), *pathout(argv[optind + 1]);
+	int nasc = int(360.001 / CAT_STEP) * int(180.001 / CAT_STEP);
+	vector<tycho2_asc> asc(nasc);
+	FILE *fpin, *fpout;
+
+	if ((fpin = fopen(pathin, "rb")) == NULL) {
+		printf ("failed to open catalog[%s]\n", pathin);
+		return -2;
+	}
+	if (fread(asc.data(), sizeof(tycho2_asc), nasc, fpin) != (size_t) nasc) {
+		printf ("failed to read index of catalog[%s]\n", pathin);
+		fclose(fpin);
+		return -2;
+	}
+	if ((fpout = fopen(pathout, "wb")) == NULL) {
+		printf ("failed to create file[%s]\n", pathout);
+		fclose(fpin);
+		return -3;
+	}
+	rslt = nsub ? pack_mmap(fpin, asc, nsub, fpout) : pack_compact(fpin, asc, fpout);
+	fclose(fpin);
+	fclose(fpout);
+	if (rslt) unlink(pathout);
+
+	return rslt;
+}
@@ -1,16 +1,59 @@
 /**
  * 测试星场与星表匹配算法
  * 命令行参数:
+ * - -c 参数文件路径. 缺省时使用内置参数
+ * - -t 已解算帧目录. 在该目录的帧集合上扫描匹配参数, 输出耗时-成功率的Pareto前沿
+ * - -b 性能测试. 以CAT文件星像及其旋转缩放副本, 比较单/双精度匹配引擎的耗时.
+ *   Linux下以硬件计数器统计缓存访问与缺失, 对比分块与不分块匹配
+ * - -s 跟踪模式. 命令行依次给出同一指向的帧序列, 首帧完整匹配, 后续帧以前一帧的解为先验
+ * - -p 并发解算的线程数. 命令行给出同一指向的多帧, 各帧由会话池中的会话并发解算, 共享星表侧模型
+ * - -m 拼接相机的芯片几何文件. 一次查询全部芯片的参考星, 芯片并发解算(线程数由-p指定), 以联合解检验各芯片
+ * - -u 曝光时间, UTC, 格式: YYYY-MM-DDThh:mm:ss. 参数文件启用测站时, 盲匹配剔除不可见的天区
+ * - -r 先验指向, 格式: 赤经,赤纬,不确定度(角度). 以盲匹配求解, 天区按先验概率递减排列
+ * - 参数文件启用星场缓存时, 单帧解算前先查找已解算星场缓存, 解算成功后星场加入缓存
+ * - 参数文件启用全视场WCS拟合时, 单帧匹配成功后交叉匹配全部星像与参考星, 拟合TAN-SIP投影
  * - CAT文件路径. CAT文件记录已提取星像的测量信息, 主要是三列:
  *   1. X
  *   2. Y
  *   3. Flux
+ * @note
+ * 参数扫描模式下, 目录中应包含帧列表文件frames.lst, 每行记录一帧:
+ * 文件名 宽度 高度 中心赤经(角度) 中心赤纬(角度) 像元比例尺(角秒/像素)
+ * 芯片几何文件每行记录一个芯片, 星像列表文件相对几何文件所在目录:
+ * 文件名 宽度 高度 芯片原点在焦面的X(像素) Y(像素) 芯片相对焦面的旋转角(角度)
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 #include "ADefine.h"
 #include "ACatTycho2.h"
+#include "ACatMmap.h"
+#include "ACatAsync.h"
+#include "ParamMatchShape.h"
 #include "MatchRefsys.h"
+#include "ShapeKernel.h"
+#include "MatchSolver.h"
+#include "MosaicSolver.h"
+#include "SkyTile.h"
+#include "FieldCache.h"
+#include "WcsFit.h"
 
+using namespace std;
 using namespace AstroUtil;
 
 bool isValidRA(double x) {
@@ -45,101 +88,923 @@ int load_cat(int w, int h, const char* filepath, MatchRefsys& match) {
 	return n;
 }
 
-bool load_refstar(double ra, double dec, double fov, ACatTycho2& cat, MatchRefsys& match) {
-	int nstar, i;
-	ptr_tycho2_elem stars;
+/*!
+ * @brief 依据文件格式创建参考星表
+ * @param param  参数. 使用星表文件路径和内存预算
+ * @return
+ * 内存映射格式使用ACatMmap, 其它格式使用ACatTycho2
+ */
+ACatalog* open_catalog(const ParamMatchShape& param) {
+	return ACatMmap::Open(param.pathcat.c_str(), size_t(param.cat_budget) << 20, param.cat_maglim);
+}
+
+/*!
+ * @brief 由参数设置单帧视场的参考星查询区域
+ * @param ra     视场中心赤经, 量纲: 角度
+ * @param dec    视场中心赤纬, 量纲: 角度
+ * @param w      图像宽度, 量纲: 像素
+ * @param h      图像高度, 量纲: 像素
+ * @param scale  像元比例尺上限, 量纲: 角秒/像素
+ * @param fp     查询区域
+ * @note
+ * 旋转角已知时为视场矩形, 否则为对角线视场的外接圆
+ */
+void frame_footprint(const ParamMatchShape& param, double ra, double dec, int w, int h, double scale,
+		cat_footprint& fp) {
+	if (param.footprint_margin < 90.0)
+		fp.SetRect(ra, dec, w * scale / 60.0, h * scale / 60.0, param.footprint_rotation, param.footprint_margin);
+	else
+		fp.SetCircle(ra, dec, (w >= h ? w : h) * scale * 1.414 / 120.0);
+}
+
+bool load_refstar(const cat_footprint& fp, ACatalog& cat, MatchRefsys& match) {
+	int nstar;
 
-	if (!cat.FindStar(ra, dec, fov * 0.5)) {
+	// 参考星直接导入匹配系统
+	match.BeginImportWcsObject(fp.ra, fp.dec);
+	nstar = cat.FindStar(fp, [&match](double ra, double dec, double mag) {
+		match.ImportWcsObject(ra, dec, mag);
+	});
+	if (nstar <= 0) {
 		printf ("faild to find reference stars\n");
 		return false;
 	}
-	stars = cat.GetResult(nstar);
 	if (nstar < 5) {
 		printf ("reference stars [%d] are not enough\n", nstar);
 		return false;
 	}
+	match.CompleteImportWcsObjectr();
 
-	match.BeginImportWcsObject(ra, dec);
-	for (i = 0; i < nstar; ++i) {
-		match.ImportWcsObject(stars[i].ra * MAS2D, stars[i].spd * MAS2D - 90.0, stars[i].mag * 0.001);
+	return true;
+}
+
+bool import_refstar(double ra, double dec, const CatStarVec& stars, MatchRefsys& match) {
+	if (stars.empty()) {
+		printf ("faild to find reference stars\n");
+		return false;
+	}
+	if (stars.size() < 5) {
+		printf ("reference stars [%lu] are not enough\n", stars.size());
+		return false;
 	}
+	match.BeginImportWcsObject(ra, dec);
+	for (CatStarVec::const_iterator it = stars.begin(); it != stars.end(); ++it)
+		match.ImportWcsObject(it->ra, it->dec, it->mag);
 	match.CompleteImportWcsObjectr();
 
 	return true;
 }
 
+/*------------------------------------------------------------------------*/
+/* 匹配参数扫描 */
+struct frame_object {// 帧内已提取星像
+	double x, y, flux;
+};
+
+struct frame_star {// 帧视场内参考星
+	double ra, dec, mag;
+};
+
+struct solved_frame {// 已解算帧
+	string filepath;
+	int w, h;			// 图像宽度和高度
+	double ra, dec;		// 中心指向, 量纲: 角度
+	double scale;		// 像元比例尺, 量纲: 角秒/像素
+	vector<frame_object> objs;
+	vector<frame_star> stars;
+};
+
+struct tune_result {// 一组参数的扫描结果
+	ParamMatchShape param;
+	double time;	// 单帧解算耗时中值, 量纲: 毫秒
+	double rate;	// 成功率
+};
+
+/*!
+ * @brief 加载已解算帧的星像和参考星
+ * @param dirpath  帧目录
+ * @param cat      参考星表
+ * @param frames   已解算帧集合
+ * @return
+ * 已加载帧数量
+ */
+int load_solved_frames(const char* dirpath, ACatalog& cat, vector<solved_frame>& frames) {
+	string listpath = string(dirpath) + "/frames.lst";
+	FILE *fp = fopen(listpath.c_str(), "r");
+	if (!fp) return 0;
+
+	char line[300], name[256];
+	while (fgets(line, 300, fp)) {
+		solved_frame frame;
+		if (line[0] == '#' || sscanf(line, "%255s %d %d %lf %lf %lf", name,
+				&frame.w, &frame.h, &frame.ra, &frame.dec, &frame.scale) != 6)
+			continue;
+		frame.filepath = string(dirpath) + "/" + name;
+
+		FILE *fpcat = fopen(frame.filepath.c_str(), "r");
+		if (!fpcat) continue;
+		char text[100];
+		frame_object obj;
+		while (fgets(text, 100, fpcat)) {
+			if (text[0] != '#' && sscanf(text, "%lf %lf %lf", &obj.x, &obj.y, &obj.flux) == 3)
+				frame.objs.push_back(obj);
+		}
+		fclose(fpcat);
+
+		double fov = (frame.w >= frame.h ? frame.w : frame.h) * frame.scale * 1.02 * 1.414 / 60.0;
+		vector<frame_star>& stars = frame.stars;
+		if (cat.FindStar(frame.ra, frame.dec, fov * 0.5, [&stars](double ra, double dec, double mag) {
+			frame_star star = { ra, dec, mag };
+			stars.push_back(star);
+		}) <= 0) continue;
+		frames.push_back(frame);
+	}
+	fclose(fp);
+
+	return frames.size();
+}
+
+/*!
+ * @brief 以已知像元比例尺检验匹配结果
+ * @return
+ * 匹配样本对间距之比的中值与已知比例尺偏差小于1%时, 认为匹配正确
+ */
+bool verify_match(MatchRefsys& match, double scale) {
+	const PtPairMSVec& pairs = match.GetMatchedPair();
+	const MatchRefsys::ObjImgVec& objimg = match.GetImageObject();
+	const MatchRefsys::ObjWcsVec& objwcs = match.GetWcsObject();
+	int n(pairs.size()), i, j;
+	vector<double> ratio;
+
+	for (i = 0; i < n; ++i) {
+		j = (i + 1) % n;
+		double dx1 = objimg[pairs[i].id1].x - objimg[pairs[j].id1].x;
+		double dy1 = objimg[pairs[i].id1].y - objimg[pairs[j].id1].y;
+		double dx2 = objwcs[pairs[i].id2].x - objwcs[pairs[j].id2].x;
+		double dy2 = objwcs[pairs[i].id2].y - objwcs[pairs[j].id2].y;
+		double len = sqrt(dx1 * dx1 + dy1 * dy1);
+		if (len > 1.0) ratio.push_back(sqrt(dx2 * dx2 + dy2 * dy2) / len * R2AS);
+	}
+	if (ratio.size() < 2) return false;
+	nth_element(ratio.begin(), ratio.begin() + ratio.size() / 2, ratio.end());
+	return fabs(ratio[ratio.size() / 2] / scale - 1.0) < 0.01;
+}
+
+/*!
+ * @brief 使用一组参数解算所有帧
+ */
+void tune_frames(vector<solved_frame>& frames, tune_result& result) {
+	MatchRefsys match;
+	vector<double> times;
+	int nsucc(0);
+
+	match.SetParameter(result.param);
+	for (size_t k = 0; k < frames.size(); ++k) {
+		solved_frame& frame = frames[k];
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+		match.SetGuessScale(frame.scale * 0.98, frame.scale * 1.02);
+		match.BeginImportImageObject(frame.w, frame.h);
+		for (size_t i = 0; i < frame.objs.size(); ++i)
+			match.ImportImageObject(frame.objs[i].x, frame.objs[i].y, frame.objs[i].flux);
+		match.CompleteImportImageObject();
+		match.BeginImportWcsObject(frame.ra, frame.dec);
+		for (size_t i = 0; i < frame.stars.size(); ++i)
+			match.ImportWcsObject(frame.stars[i].ra, frame.stars[i].dec, frame.stars[i].mag);
+		match.CompleteImportWcsObjectr();
+		bool success = match.DoMatch() && verify_match(match, frame.scale);
+
+		chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+		times.push_back(dt.count());
+		if (success) ++nsucc;
+	}
+	nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+	result.time = times[times.size() / 2];
+	result.rate = double(nsucc) / frames.size();
+}
+
+/*!
+ * @brief 在已解算帧集合上扫描匹配参数, 输出解算耗时中值与成功率的Pareto前沿
+ * @param dirpath  帧目录
+ * @param param    基准参数
+ * @return
+ * 扫描结果
+ */
+int autotune(const char* dirpath, ParamMatchShape& param) {
+	unique_ptr<ACatalog> cat(open_catalog(param));
+	vector<solved_frame> frames;
+
+	if (!load_solved_frames(dirpath, *cat, frames)) {
+		printf ("no solved frame is found in %s\n", dirpath);
+		return -1;
+	}
+	printf ("%lu solved frames are loaded\n", frames.size());
+
+	const double angles[]   = { 45.0, 60.0, 90.0 };
+	const double incls[]    = { 0.05, 0.1, 0.2 };
+	const double lnormals[] = { 0.001, 0.002, 0.004 };
+	const int imgs[]        = { 20, 30, 40, 60 };
+	const int wcsratios[]   = { 2, 3, 4 };
+	const double goods[]    = { 0.3, 0.5 };
+	vector<tune_result> results;
+	tune_result result;
+
+	result.param = param;
+	result.param.use_stdprint = false;
+	for (double angle : angles) {
+		result.param.angle = angle;
+		for (double incl : incls) {
+			result.param.diff_incl_max = incl;
+			for (double lnormal : lnormals) {
+				result.param.diff_lnormal_max = lnormal;
+				for (int img : imgs) {
+					result.param.count_img_max = img;
+					for (int ratio : wcsratios) {
+						result.param.count_wcs_max = img * ratio;
+						for (double good : goods) {
+							result.param.good_match = good;
+							tune_frames(frames, result);
+							results.push_back(result);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/* Pareto前沿: 耗时递增, 成功率严格递增 */
+	sort(results.begin(), results.end(), [](const tune_result& x1, const tune_result& x2) {
+		return x1.time < x2.time || (x1.time == x2.time && x1.rate > x2.rate);
+	});
+	printf ("%8s %6s | %5s %5s %6s %4s %4s %4s\n",
+			"time_ms", "rate", "angle", "incl", "lnorm", "img", "wcs", "good");
+	double rate_max(-1.0);
+	for (size_t i = 0; i < results.size(); ++i) {
+		tune_result& x = results[i];
+		if (x.rate <= rate_max) continue;
+		rate_max = x.rate;
+		printf ("%8.2f %6.3f | %5.1f %5.3f %6.4f %4d %4d %4.2f\n",
+				x.time, x.rate, x.param.angle, x.param.diff_incl_max, x.param.diff_lnormal_max,
+				x.param.count_img_max, x.param.count_wcs_max, x.param.good_match);
+	}
+
+	return 0;
+}
+
+/*------------------------------------------------------------------------*/
+/* 匹配引擎性能测试 */
+/*!
+ * @struct cache_counter
+ * @brief 硬件性能计数器: 本进程用户态的缓存访问与缺失次数
+ * @note
+ * 仅Linux. 内核或虚拟机不提供硬件计数器时, 计数为-1
+ */
+struct cache_counter {
+	int fd[2];	//< 计数器: 缓存访问, 缓存缺失
+
+public:
+	cache_counter() {
+		fd[0] = fd[1] = -1;
+#ifdef __linux__
+		unsigned long long config[] = { PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES };
+		struct perf_event_attr attr;
+		for (int i = 0; i < 2; ++i) {
+			memset(&attr, 0, sizeof(attr));
+			attr.size     = sizeof(attr);
+			attr.type     = PERF_TYPE_HARDWARE;
+			attr.config   = config[i];
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv     = 1;
+			fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+#endif
+	}
+
+	~cache_counter() {
+		for (int i = 0; i < 2; ++i) {
+			if (fd[i] >= 0) close(fd[i]);
+		}
+	}
+
+	void start() {
+#ifdef __linux__
+		for (int i = 0; i < 2; ++i) {
+			if (fd[i] < 0) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	/*!
+	 * @brief 停止计数
+	 * @param counts  缓存访问与缺失次数. 不可用时为-1
+	 */
+	void stop(long long counts[2]) {
+		for (int i = 0; i < 2; ++i) {
+			counts[i] = -1;
+#ifdef __linux__
+			if (fd[i] < 0) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd[i], &counts[i], sizeof(long long)) != sizeof(long long)) counts[i] = -1;
+#endif
+		}
+	}
+};
+
+/*!
+ * @brief 使用指定精度的匹配引擎重复匹配
+ * @param set1    样本集合1
+ * @param set2    样本集合2
+ * @param param   约束参数
+ * @param scale   集合2相对集合1的比例尺
+ * @param repeat  重复次数
+ * @param npair   样本对数量
+ * @param counts  单次匹配的缓存访问与缺失次数. 硬件计数器不可用时为-1
+ * @param kernel  使用定长匹配核. 无适用实例时使用ShapeMatch::Match
+ * @return
+ * 单次匹配耗时, 量纲: 毫秒
+ */
+template <typename T>
+double bench_engine(const vector<frame_object>& set1, const vector<frame_object>& set2,
+		const ParamMatchShape& param, double scale, int repeat, int& npair, long long counts[2],
+		bool kernel = false) {
+	cache_counter counter;
+	ShapeMatch<T> engine;
+	PtMSVec<T> pts1, pts2;
+	PtPairMSVec pairs;
+	size_t i;
+
+	for (i = 0; i < set1.size(); ++i)
+		pts1.push_back(PointMS<T>(i, T(set1[i].x), T(set1[i].y), T(-2.5 * log10(set1[i].flux))));
+	for (i = 0; i < set2.size(); ++i) pts2.push_back(PointMS<T>(i, T(set2[i].x), T(set2[i].y)));
+	engine.SetParameter(param);
+	engine.SetScale(T(scale * 0.98), T(scale * 1.02));
+
+	counter.start();
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	for (int k = 0; k < repeat; ++k) {
+		engine.BuildShape1(pts1, T(param.aimg_min));
+		if (engine.Streaming()) engine.MatchStream(pts2, T(param.aimg_min * scale));
+		else {
+			engine.BuildShape2(pts2, T(param.aimg_min * scale));
+			if (kernel && (npair = ShapeKernelSet<T>::Match(engine, param.hit_ratio_min, pairs)) >= 0) continue;
+			engine.Match();
+		}
+		npair = engine.GetMatchedPair(param.hit_ratio_min, pairs);
+	}
+	chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+	counter.stop(counts);
+	for (int i = 0; i < 2; ++i) {
+		if (counts[i] > 0) counts[i] /= repeat;
+	}
+	return dt.count() / repeat;
+}
+
+/*!
+ * @brief 打印一种匹配引擎的性能测试结果
+ */
+void print_bench(const char* name, double ms, int npair, const long long counts[2]) {
+	printf ("%-10s %8.2f ms, %4d pairs", name, ms, npair);
+	if (counts[0] >= 0 && counts[1] >= 0)
+		printf (", cache refs %10lld, misses %9lld\n", counts[0], counts[1]);
+	else
+		printf (", cache counters n/a\n");
+}
+
+/*!
+ * @brief 比较单精度、双精度、16位定点特征、流式匹配引擎与定长匹配核的耗时
+ * @param filepath  CAT文件路径
+ * @param param     约束参数
+ */
+int benchmark(const char* filepath, const ParamMatchShape& param) {
+	FILE *fp = fopen(filepath, "r");
+	if (!fp) return -1;
+	vector<frame_object> objs, set1, set2;
+	frame_object obj;
+	char text[100];
+	while (fgets(text, 100, fp)) {
+		if (text[0] != '#' && sscanf(text, "%lf %lf %lf", &obj.x, &obj.y, &obj.flux) == 3)
+			objs.push_back(obj);
+	}
+	fclose(fp);
+	sort(objs.begin(), objs.end(), [](const frame_object& x1, const frame_object& x2) {
+		return x1.flux > x2.flux;
+	});
+	// 集合2: 较亮目标旋转37度并放大1.3倍
+	double scale(1.3), rot(37.0 * D2R);
+	int nobj = objs.size();
+	int n1 = nobj < param.count_img_max ? nobj : param.count_img_max;
+	int n2 = nobj < param.count_wcs_max ? nobj : param.count_wcs_max;
+	set1.assign(objs.begin(), objs.begin() + n1);
+	for (int i = 0; i < n2; ++i) {
+		obj.x = scale * (objs[i].x * cos(rot) - objs[i].y * sin(rot));
+		obj.y = scale * (objs[i].x * sin(rot) + objs[i].y * cos(rot));
+		set2.push_back(obj);
+	}
+
+	int repeat(10), npair32, npair64, npairq, npairs, npairu, npairk32, npairk64;
+	long long c32[2], c64[2], cq[2], cs[2], cu[2], ck32[2], ck64[2];
+	ParamMatchShape paramq(param), params(param), paramu(param);
+	paramq.use_quant16 = true;
+	// 流式匹配: 未设置预算时取256KB
+	if (params.stream_budget <= 0) params.stream_budget = 256;
+	// 对照: 不分块
+	paramu.block_size = 0;
+	double t32 = bench_engine<float>(set1, set2, param, scale, repeat, npair32, c32);
+	double t64 = bench_engine<double>(set1, set2, param, scale, repeat, npair64, c64);
+	double tq  = bench_engine<float>(set1, set2, paramq, scale, repeat, npairq, cq);
+	double ts  = bench_engine<float>(set1, set2, params, scale, repeat, npairs, cs);
+	double tu  = bench_engine<double>(set1, set2, paramu, scale, repeat, npairu, cu);
+	double tk32 = bench_engine<float>(set1, set2, param, scale, repeat, npairk32, ck32, true);
+	double tk64 = bench_engine<double>(set1, set2, param, scale, repeat, npairk64, ck64, true);
+	printf ("samples: %d x %d, block %d KB\n", n1, n2, param.block_size);
+	print_bench("float32:", t32, npair32, c32);
+	print_bench("float64:", t64, npair64, c64);
+	print_bench("quant16:", tq, npairq, cq);
+	print_bench("stream:", ts, npairs, cs);
+	print_bench("unblocked:", tu, npairu, cu);
+	print_bench("kernel32:", tk32, npairk32, ck32);
+	print_bench("kernel64:", tk64, npairk64, ck64);
+	printf ("speedup: %8.2f\n", t64 / t32);
+	printf ("kernel speedup: %8.2f\n", t64 / tk64);
+
+	return 0;
+}
+
+/*------------------------------------------------------------------------*/
+void print_solution(const MatchRefsys::solution& sol) {
+	printf ("center: %9.5f %9.5f, scale: %7.4f, rotation: %8.3f, parity: %2d, rms: %.3f, matched: %d\n",
+			sol.ra, sol.dec, sol.scale, sol.rotation, sol.parity, sol.rms, sol.matched);
+}
+
+/*!
+ * @brief 拟合并打印全视场WCS
+ * @param match  匹配系统. 已匹配成功
+ */
+void fit_wcs(const ParamMatchShape& param, const MatchRefsys& match, int w, int h) {
+	WcsFit fit;
+	fit.SetParameter(param);
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	bool success = fit.Fit(match, w, h);
+	chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+	if (!success) {
+		printf ("wcs fit failed\n");
+		return;
+	}
+
+	const WcsFit::wcs_sip& wcs = fit.GetWcs();
+	printf ("wcs fit: %d of %lu objects matched, order: %d, rms: %.3f, %.2f ms\n",
+			wcs.matched, match.GetImageObject().size(), wcs.order, wcs.rms, dt.count());
+	printf ("crval: %10.6f %10.6f, crpix: %9.3f %9.3f\n", wcs.crval[0], wcs.crval[1], wcs.crpix[0], wcs.crpix[1]);
+	printf ("cd: %13.6E %13.6E %13.6E %13.6E\n", wcs.cd[0][0], wcs.cd[0][1], wcs.cd[1][0], wcs.cd[1][1]);
+	for (int p = 0; param.use_stdprint && p <= wcs.order; ++p) {
+		for (int q = 0; p + q <= wcs.order; ++q) {
+			if (p + q >= 2) printf ("A_%d_%d: %13.6E, B_%d_%d: %13.6E\n", p, q, wcs.a[p][q], p, q, wcs.b[p][q]);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+/*!
+ * @brief 并发解算同一指向的多帧
+ * @param nthread  线程数
+ * @param paths    CAT文件路径
+ * @param npath    CAT文件数量
+ * @param stars    指向附近的参考星
+ * @return
+ * 解算成功的帧数
+ */
+int solve_concurrent(int nthread, char **paths, int npath, const ParamMatchShape& param, int w, int h,
+		double rac, double decc, double scale_low, double scale_high, const CatStarVec& stars) {
+	ParamMatchShape cfg(param);
+	cfg.use_stdprint = false;	// 避免多个会话的输出交错
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	MatchSolver solver(cfg, w, h, scale_low, scale_high);
+	MatchFieldPtr field = solver.BuildField(rac, decc, stars);
+	if (!field) {
+		printf ("failed to build catalog model\n");
+		return 0;
+	}
+	chrono::duration<double, milli> dt_field = chrono::steady_clock::now() - t0;
+
+	vector<MatchRefsys::solution> sols(npath);
+	vector<char> success(npath, 0);
+	atomic<int> next(0);
+	vector<thread> workers;
+
+	t0 = chrono::steady_clock::now();
+	for (int k = 0; k < nthread; ++k) {
+		workers.push_back(thread([&]() {
+			for (int i = next++; i < npath; i = next++) {
+				MatchSolver::SessionPtr session = solver.Acquire();
+				if (load_cat(w, h, paths[i], *session) >= 5 && session->DoMatch(*field)) {
+					success[i] = 1;
+					sols[i] = session->GetSolution();
+				}
+			}
+		}));
+	}
+	for (size_t k = 0; k < workers.size(); ++k) workers[k].join();
+	chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+
+	int nsucc(0);
+	for (int i = 0; i < npath; ++i) {
+		printf ("%s: %s\n", paths[i], success[i] ? "match succeed" : "match failed");
+		if (success[i]) {
+			print_solution(sols[i]);
+			++nsucc;
+		}
+	}
+	printf ("%d/%d frames solved by %d sessions in %.1f ms, catalog model built in %.1f ms\n",
+			nsucc, npath, solver.SessionCount(), dt.count(), dt_field.count());
+	return nsucc;
+}
+
+/*------------------------------------------------------------------------*/
+/* 拼接相机 */
+/*!
+ * @brief 加载芯片几何文件
+ * @param filepath  芯片几何文件路径
+ * @param chips     芯片标称几何
+ * @return
+ * 芯片数量
+ */
+int load_mosaic_geometry(const char* filepath, vector<MosaicChip>& chips) {
+	FILE *fp = fopen(filepath, "r");
+	if (!fp) return 0;
+
+	string dirpath(filepath);
+	size_t pos = dirpath.rfind('/');
+	dirpath = pos == string::npos ? string(".") : dirpath.substr(0, pos);
+
+	char line[300], name[256];
+	while (fgets(line, 300, fp)) {
+		MosaicChip chip;
+		if (line[0] == '#' || sscanf(line, "%255s %d %d %lf %lf %lf", name,
+				&chip.w, &chip.h, &chip.x0, &chip.y0, &chip.rotation) != 6)
+			continue;
+		chip.filepath = name[0] == '/' ? string(name) : dirpath + "/" + name;
+		chips.push_back(chip);
+	}
+	fclose(fp);
+
+	return chips.size();
+}
+
+/*!
+ * @brief 解算拼接相机的一次曝光
+ * @param geompath  芯片几何文件路径
+ * @param nthread   线程数
+ * @param cat       参考星表
+ * @return
+ * 与联合解一致的芯片数量
+ */
+int solve_mosaic(const char* geompath, int nthread, const ParamMatchShape& param, ACatalog& cat,
+		double rac, double decc, double scale_low, double scale_high) {
+	vector<MosaicChip> chips;
+	if (!load_mosaic_geometry(geompath, chips)) {
+		printf ("failed to load mosaic geometry[%s]\n", geompath);
+		return 0;
+	}
+	MosaicSolver solver(param, chips, scale_low, scale_high);
+
+	// 一次查询拼接视场内的参考星
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	CatStarVec stars;
+	cat_footprint fp;
+	solver.Footprint(rac, decc, fp);
+	cat.FindStar(fp, [&stars](double ra, double dec, double mag) {
+		cat_star star = { ra, dec, mag };
+		stars.push_back(star);
+	});
+	chrono::duration<double, milli> dt_cat = chrono::steady_clock::now() - t0;
+
+	t0 = chrono::steady_clock::now();
+	int nverified = solver.Solve(rac, decc, stars, [](const MosaicChip& chip, MatchRefsys& session) {
+		return load_cat(chip.w, chip.h, chip.filepath.c_str(), session);
+	}, nthread);
+	chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+
+	for (int k = 0; k < solver.ChipCount(); ++k) {
+		const MosaicChipResult& rslt = solver.GetChip(k);
+		printf ("%s: %s%s, joint rms: %.3f\n", chips[k].filepath.c_str(),
+				rslt.verified ? "verified" : (rslt.solved ? "inconsistent" : "failed"),
+				rslt.recovered ? " (re-solved)" : "", rslt.rms_joint);
+		if (rslt.solved) print_solution(rslt.sol);
+	}
+	printf ("joint ");
+	print_solution(solver.GetJoint());
+	printf ("%d/%d chips verified in %.1f ms, %lu reference stars loaded in %.1f ms\n",
+			nverified, solver.ChipCount(), dt.count(), stars.size(), dt_cat.count());
+	return nverified;
+}
+
+/*------------------------------------------------------------------------*/
+/*!
+ * @brief 在已解算星场缓存中查找并复核
+ * @param param  参数
+ * @param cache  星场缓存
+ * @param codes  图像编码
+ * @param w      图像宽度
+ * @param h      图像高度
+ * @param cat    参考星表
+ * @param match  匹配系统, 已导入图像目标
+ * @return
+ * 复核成功的星场编号. 未命中时返回-1
+ * @note
+ * - 按得票递减复核至多3个候选星场. 比例尺范围收窄为候选星场比例尺的±2%, 调用者负责恢复
+ * - 以候选星场的定位解为先验跟踪匹配. 指向或旋转偏离较大时, DoTrack回退至DoMatch
+ */
+int solve_cache(const ParamMatchShape& param, FieldCache& cache, const vector<unsigned int>& codes,
+		int w, int h, ACatalog& cat, MatchRefsys& match) {
+	vector<int> fields;
+	int n = cache.Lookup(codes, param.cache_vote, fields);
+	if (n > 3) n = 3;
+
+	for (int i = 0; i < n; ++i) {
+		const fieldcache_field& field = cache.GetField(fields[i]);
+		if (field.w != w || field.h != h) continue;
+		double fov = (w >= h ? w : h) * field.scale * 1.02 * 1.414 / 60.0; // 对角线视场
+		MatchRefsys::solution prior;
+		prior.ra       = field.ra;
+		prior.dec      = field.dec;
+		prior.scale    = field.scale;
+		prior.rotation = field.rotation;
+		prior.parity   = field.parity;
+		match.SetGuessScale(field.scale * 0.98, field.scale * 1.02);
+		// DoTrack可能回退至DoMatch, 旋转角不以缓存为准
+		cat_footprint fp;
+		fp.SetCircle(field.ra, field.dec, fov * 0.5);
+		if (load_refstar(fp, cat, match) && match.DoTrack(prior)) return fields[i];
+	}
+	return -1;
+}
+
+/*!
+ * @brief 完整解算成功后, 星场加入缓存
+ */
+void update_cache(const ParamMatchShape& param, FieldCache& cache, const vector<unsigned int>& codes,
+		int w, int h, const MatchRefsys::solution& sol) {
+	if (!param.use_cache || codes.empty()) return;
+	int k = cache.Add(sol, w, h, codes);
+	if (!cache.Save(param.pathcache.c_str()))
+		printf ("failed to save field cache[%s]\n", param.pathcache.c_str());
+	else
+		printf ("field %d cached, %d fields in cache\n", k, cache.FieldCount());
+}
+
+/*!
+ * @brief 解析UTC时间
+ * @param text  时间, 格式: YYYY-MM-DDThh:mm:ss
+ * @param mjd   修正儒略日
+ * @return
+ * 解析结果
+ */
+bool parse_utc(const char* text, double& mjd) {
+	int year, month, day, hour, minute;
+	double second;
+	if (sscanf(text, "%d-%d-%dT%d:%d:%lf", &year, &month, &day, &hour, &minute, &second) != 6) return false;
+	mjd = SkyTile::MJD(year, month, day, hour + minute / 60.0 + second / 3600.0);
+	return true;
+}
+
+void usage() {
+	printf ("Usage:\n");
+	printf ("\t fovmatch [-c config_path] catfile_path\n");
+	printf ("\t fovmatch [-c config_path] -t solved_frame_dir\n");
+	printf ("\t fovmatch [-c config_path] -b catfile_path\n");
+	printf ("\t fovmatch [-c config_path] -s catfile_path1 catfile_path2 ...\n");
+	printf ("\t fovmatch [-c config_path] -p nthread catfile_path1 catfile_path2 ...\n");
+	printf ("\t fovmatch [-c config_path] [-p nthread] -m mosaic_geometry_path\n");
+	printf ("\t fovmatch [-c config_path] [-u utc] [-r ra,dec,sigma] catfile_path\n");
+}
+
 int main(int argc, char **argv) {
-	if (argc < 2) {
-		printf ("Usage:\n");
-		printf ("\t fovmatch catfile_path\n");
+	ParamMatchShape param;
+	const char *tunedir(NULL), *geompath(NULL);
+	bool bench(false), track(false), prior(false);
+	double mjd(0.0);	// 曝光时间, 修正儒略日
+	double prior_ra, prior_dec, prior_sigma;	// 先验指向及其不确定度, 角度
+	int nthread(0);
+	int ch;
+
+	while ((ch = getopt(argc, argv, "c:t:bsp:m:u:r:")) != -1) {
+		switch (ch) {
+		case 'c':
+			if (!param.Load(optarg)) {
+				printf ("failed to load config[%s]: %s\n", optarg, param.GetErrmsg());
+				return -1;
+			}
+			break;
+		case 't':
+			tunedir = optarg;
+			break;
+		case 'b':
+			bench = true;
+			break;
+		case 's':
+			track = true;
+			break;
+		case 'p':
+			nthread = atoi(optarg);
+			break;
+		case 'm':
+			geompath = optarg;
+			break;
+		case 'u':
+			if (!parse_utc(optarg, mjd)) {
+				printf ("invalid UTC[%s]\n", optarg);
+				return -1;
+			}
+			break;
+		case 'r':
+			if (sscanf(optarg, "%lf,%lf,%lf", &prior_ra, &prior_dec, &prior_sigma) != 3) {
+				printf ("invalid prior pointing[%s]\n", optarg);
+				return -1;
+			}
+			prior = true;
+			break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+	if (tunedir) return autotune(tunedir, param);
+	if (mjd > 0.0 && !param.use_site) {
+		printf ("UTC requires site information, set Site.use in config\n");
+		return -1;
+	}
+	if (optind >= argc && !geompath) {
+		usage();
 		return -1;
 	}
 
 	// 图像与中心指向
 	int wimg(4096), himg(4096);	// 图像宽度和高度
-	double scale_low(11.0), scale_high(12.0); // 像元比例尺, 估计值, 角秒/像素
+	double scale_low(param.scale_low), scale_high(param.scale_high); // 像元比例尺, 估计值, 角秒/像素
 	double rac(230.0), decc(-13.0);	// 中心视场指向, 估计值, 角度
 //	double rac(1000.0), decc(-15.0);	// 中心视场指向, 估计值, 角度
 	double fov;	// 匹配视场, 角分
 	MatchRefsys match;
 
-	if (load_cat(wimg, himg, argv[1], match) < 5) {
-		printf ("fail to load image catalog[%s] or objects is not enough\n", argv[1]);
-		return -2;
-	}
-
-	// !! 约束: 像元比例尺
+	// !! 约束: 像元比例尺. 宽范围由匹配引擎按比例尺分档处理, 不再截断
 	if (scale_low < 0.1) scale_low = 0.1;
-	if (scale_high / scale_low > 1.414) scale_high = scale_low * 1.414;
-	match.SetGuessScale(scale_low, scale_high);
+	if (scale_high < scale_low) scale_high = scale_low;
 
 	// 参考星表
-	ACatTycho2 tycho2;
+	unique_ptr<ACatalog> cat(open_catalog(param));
+
+	if (geompath) {// 拼接相机
+		if (nthread <= 0) nthread = thread::hardware_concurrency();
+		return solve_mosaic(geompath, nthread, param, *cat, rac, decc, scale_low, scale_high) ? 0 : -4;
+	}
+
+	const char *catpath = argv[optind];
+	if (bench) return benchmark(catpath, param);
+
+	match.SetParameter(param);
+	if (load_cat(wimg, himg, catpath, match) < 5) {
+		printf ("fail to load image catalog[%s] or objects is not enough\n", catpath);
+		return -2;
+	}
+	match.SetGuessScale(scale_low, scale_high);
 
-	tycho2.SetPathRoot("/Users/lxm/Catalogue/tycho2/tycho2.dat");
+	// 已解算星场缓存: 重复观测的星场由一次DoMatch解算
+	FieldCache cache;
+	vector<unsigned int> codes;
+	if (param.use_cache && !track && nthread <= 0) {
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		if (!cache.Load(param.pathcache.c_str()))
+			printf ("invalid field cache[%s], rebuild\n", param.pathcache.c_str());
+		FieldCache::Hash(match.GetImageObject(), param.cache_stars, param.aimg_min, codes);
+		int k = solve_cache(param, cache, codes, wimg, himg, *cat, match);
+		if (k >= 0) {
+			chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+			printf ("match succeed: field %d in cache, %.2f ms\n", k, dt.count());
+			printf ("result:\n");
+			print_solution(match.GetSolution());
+			update_cache(param, cache, codes, wimg, himg, match.GetSolution());
+			return 0;
+		}
+		match.SetGuessScale(scale_low, scale_high);
+	}
 
-	if (isValidRA(rac) && isValidDEC(decc)) {
+	// 给定曝光时间或先验指向时, 以先验信息引导盲匹配
+	bool blind = prior || mjd > 0.0;
+	if (!blind && isValidRA(rac) && isValidDEC(decc)) {
 		/* 当知道中心粗略指向时, 直接在其附近星场尝试匹配 */
 		fov = (wimg >= himg ? wimg : himg) * scale_high * 1.414 / 60.0; // 对角线视场
+		cat_footprint fp;
+		frame_footprint(param, rac, decc, wimg, himg, scale_high, fp);
 
-		if (!load_refstar(rac, decc, fov, tycho2, match)) {
+		if (nthread > 0) {// 并发解算
+			CatStarVec stars;
+			cat->FindStar(fp, [&stars](double ra, double dec, double mag) {
+				cat_star star = { ra, dec, mag };
+				stars.push_back(star);
+			});
+			return solve_concurrent(nthread, argv + optind, argc - optind, param, wimg, himg,
+					rac, decc, scale_low, scale_high, stars) ? 0 : -4;
+		}
+
+		if (!load_refstar(fp, *cat, match)) {
 			printf ("failed to load catalog or refstar is not enough\n");
 			return -3;
 		}
 		if (match.DoMatch()) {
+			double maglim;
+			int nsample = match.GetWcsSample(maglim);
 			printf ("match succeed\n");
 			printf ("result:\n");
+			print_solution(match.GetSolution());
+			printf ("wcs sample: %d, magnitude limit: %.2f\n", nsample, maglim);
+			if (param.use_wcsfit) fit_wcs(param, match, wimg, himg);
+			update_cache(param, cache, codes, wimg, himg, match.GetSolution());
 		}
 		else {
 			printf ("match failed\n");
+			return -4;
+		}
+
+		/* 跟踪模式: 后续帧以最近一次成功的解为先验. 失败的帧不改变先验 */
+		MatchRefsys::solution last = match.GetSolution();
+		for (int i = optind + 1; track && i < argc; ++i) {
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			if (load_cat(wimg, himg, argv[i], match) < 5) {
+				printf ("fail to load image catalog[%s] or objects is not enough\n", argv[i]);
+				continue;
+			}
+			// 指向偏离参考星中心超过1/4视场时, 重新加载参考星
+			double dra  = (last.ra - rac) * cos(last.dec * D2R);
+			double ddec = last.dec - decc;
+			if (sqrt(dra * dra + ddec * ddec) * 60.0 > fov * 0.25) {
+				rac  = last.ra;
+				decc = last.dec;
+				frame_footprint(param, rac, decc, wimg, himg, scale_high, fp);
+				if (!load_refstar(fp, *cat, match)) continue;
+			}
+			bool success = match.DoTrack(last);
+			chrono::duration<double, milli> dt = chrono::steady_clock::now() - t0;
+			printf ("%s: %s in %.2f ms\n", argv[i], success ? "track succeed" : "track failed", dt.count());
+			if (success) {
+				last = match.GetSolution();
+				print_solution(last);
+			}
 		}
 	}
 	else {
 		// 当中心指向未知时, 全天盲匹配. 全天盲匹配耗时较长
+		// 天球划分为等面积天区, 匹配当前天区的同时由后台线程预取后续天区的参考星
+		SkyTile sky;
 		bool success(false);
-		double step = (wimg <= himg ? wimg : himg) * scale_low * 0.5 / 3600.0;
-		double stepr;
-		int nzd, izd, iz(0);
+		sky.Generate(SkyTile::FrameRadius(wimg, himg, scale_low, param.blind_overlap));
+		const SkyTileVec& tiles = sky.Tiles();
 
 		fov = (wimg > himg ? wimg : himg) * scale_high * 1.414 / 60.0; // 对角线视场
-		nzd = int(180.001 / step);
-
-		for (izd = 0, decc = -12.0; izd < nzd && !success; decc -= step, ++izd) {
-			if (decc < -90.0) decc += 180.0;
-			if ((90.0 - fabs(decc)) < fov * 0.2 / 60.0) stepr = 360.1;
-			else stepr = step / cos(decc * D2R);
-			printf ("try to solve field %d. dec = %8.4f, stepD = %.4f, stepR = %.4f\n",
-					++iz, decc, step, stepr);
-			for (rac = 0.0; rac < 360.0 && !success; rac += stepr) {
-				printf ("\t rac = %8.4f\n", rac);
-				success = load_refstar(rac, decc, fov, tycho2, match) && match.DoMatch();
-			}
+		printf ("blind search: %d tiles in %d rings, tile radius = %.4f\n",
+				int(tiles.size()), sky.RingCount(), sky.Radius());
+		// 先验信息: 剔除不可见的天区, 按先验指向排列天区
+		if (param.use_site && mjd > 0.0) {
+			sky.CullHorizon(param.site_lon, param.site_lat, mjd, param.site_alt_min);
+			printf ("visible tiles: %d, LST = %.4f\n", int(tiles.size()),
+					cyclemod(SkyTile::GMST(mjd) + param.site_lon, 360.0));
+		}
+		if (prior) {
+			double expect = sky.SortByPrior(prior_ra, prior_dec, prior_sigma);
+			printf ("prior pointing: %.4f %.4f, sigma = %.4f, expected tiles = %.1f\n",
+					prior_ra, prior_dec, prior_sigma, expect);
 		}
 
+		ACatAsync async(*cat);
+		deque<future<CatStarVec> > pending;
+		size_t ntile(tiles.size()), next(0);
+		int prefetch = param.cat_prefetch > 0 ? param.cat_prefetch : 0;
+
+		size_t k;
+		for (k = 0; k < ntile && !success; ++k) {
+			const sky_tile& tile = tiles[k];
+			for (; next < ntile && next <= k + prefetch; ++next)
+				pending.push_back(async.FindStar(tiles[next].ra, tiles[next].dec, fov * 0.5));
+			CatStarVec stars = pending.front().get();
+			pending.pop_front();
+
+			if (!prior && (!k || tile.ring != tiles[k - 1].ring))
+				printf ("try to solve ring %d. dec = %8.4f, radius = %.4f\n",
+						tile.ring + 1, tile.dec, tile.radius);
+			printf ("\t rac = %8.4f, decc = %8.4f\n", tile.ra, tile.dec);
+			success = import_refstar(tile.ra, tile.dec, stars, match) && match.DoMatch();
+		}
+		async.Cancel();
+
 		if (success) {
 			// 输出匹配结果和残差
-			printf ("match succeed\n");
+			printf ("match succeed after %d tiles\n", int(k));
 			printf ("result:\n");
+			print_solution(match.GetSolution());
+			update_cache(param, cache, codes, wimg, himg, match.GetSolution());
 		}
 		else {
 			printf ("match failed\n");
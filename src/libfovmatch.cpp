@@ -0,0 +1,240 @@
+/**
+ * @file libfovmatch.cpp
+ * @brief libfovmatch: 星场与星表匹配的C语言接口
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <memory>
+#include "ADefine.h"
+#include "ACatMmap.h"
+#include "ParamMatchShape.h"
+#include "MatchRefsys.h"
+#include "WcsFit.h"
+#include "libfovmatch.h"
+
+using namespace std;
+using namespace AstroUtil;
+
+static_assert(FM_SIP_ORDER_MAX == WCSFIT_ORDER_MAX, "SIP order of fm_wcs must match WcsFit");
+
+struct fm_catalog {
+	ParamMatchShape param;		//< 参数
+	unique_ptr<ACatalog> cat;	//< 参考星表. 以访问接口查询, 可被多个线程并发调用
+};
+
+struct fm_solver {
+	fm_catalog* cat;			//< 参考星表
+	ParamMatchShape param;		//< 参数
+	int w, h;					//< 图像宽度和高度
+	double scale_low;			//< 像元比例尺下限, 量纲: 角秒/像素
+	double scale_high;			//< 像元比例尺上限, 量纲: 角秒/像素
+	double fov;					//< 对角线视场, 量纲: 角分
+	double rac, decc;			//< 已加载参考星的中心, 量纲: 角度
+	bool loaded;				//< 参考星已加载
+	bool solved;				//< 当前帧已有定位解, 样本对与当前星像和参考星对应
+	bool tracked;				//< 已有可作为跟踪先验的定位解
+	MatchRefsys::solution last;	//< 最近一次成功的定位解
+	MatchRefsys match;			//< 匹配系统
+	WcsFit wcsfit;				//< 全视场WCS拟合
+};
+
+static void set_error(int* err, int code) {
+	if (err) *err = code;
+}
+
+/*!
+ * @brief 查询参考星并导入匹配系统
+ */
+static int load_refstar(fm_solver* solver, double ra, double dec) {
+	MatchRefsys& match = solver->match;
+	int nstar;
+
+	solver->solved = false;	// 参考星改变后样本对失效
+	match.BeginImportWcsObject(ra, dec);
+	nstar = solver->cat->cat->FindStar(ra, dec, solver->fov * 0.5, [&match](double ra, double dec, double mag) {
+		match.ImportWcsObject(ra, dec, mag);
+	});
+	solver->loaded = false;
+	if (nstar < 0) return FM_ERR_CATALOG;
+	if (nstar < 5) return FM_ERR_REFSTAR;
+	match.CompleteImportWcsObjectr();
+	solver->rac    = ra;
+	solver->decc   = dec;
+	solver->loaded = true;
+	return FM_OK;
+}
+
+int fm_version(void) {
+	return FM_VERSION;
+}
+
+const char* fm_strerror(int err) {
+	switch (err) {
+	case FM_OK:				return "success";
+	case FM_ERR_ARG:		return "invalid argument";
+	case FM_ERR_CONFIG:		return "failed to load config";
+	case FM_ERR_CATALOG:	return "catalog is not available";
+	case FM_ERR_OBJECT:		return "image objects are not enough";
+	case FM_ERR_REFSTAR:	return "reference stars are not enough";
+	case FM_ERR_NOMATCH:	return "match failed";
+	case FM_ERR_NOSOLUTION:	return "no solution";
+	default:				return "unknown error";
+	}
+}
+
+fm_catalog* fm_catalog_open(const char* config_path, const char* catalog_path, int* err) {
+	unique_ptr<fm_catalog> cat(new fm_catalog);
+	if (config_path && !cat->param.Load(config_path)) {
+		set_error(err, FM_ERR_CONFIG);
+		return NULL;
+	}
+	if (catalog_path) cat->param.pathcat = catalog_path;
+	cat->param.use_stdprint = false;
+	cat->cat.reset(ACatMmap::Open(cat->param.pathcat.c_str(), size_t(cat->param.cat_budget) << 20,
+			cat->param.cat_maglim));
+	// 加载星表索引
+	if (cat->cat->FindStar(0.0, 0.0, 1.0, [](double, double, double) {}) < 0) {
+		set_error(err, FM_ERR_CATALOG);
+		return NULL;
+	}
+	set_error(err, FM_OK);
+	return cat.release();
+}
+
+void fm_catalog_close(fm_catalog* cat) {
+	delete cat;
+}
+
+fm_solver* fm_solver_create(fm_catalog* cat, int w, int h, int* err) {
+	if (!cat || w <= 0 || h <= 0) {
+		set_error(err, FM_ERR_ARG);
+		return NULL;
+	}
+	fm_solver* solver = new fm_solver;
+	solver->cat    = cat;
+	solver->param  = cat->param;
+	solver->w      = w;
+	solver->h      = h;
+	solver->rac    = solver->decc = 0.0;
+	solver->loaded = solver->solved = solver->tracked = false;
+	solver->match.SetParameter(solver->param);
+	solver->wcsfit.SetParameter(solver->param);
+	fm_solver_set_scale(solver, solver->param.scale_low, solver->param.scale_high);
+	set_error(err, FM_OK);
+	return solver;
+}
+
+void fm_solver_destroy(fm_solver* solver) {
+	delete solver;
+}
+
+int fm_solver_set_scale(fm_solver* solver, double low, double high) {
+	if (!solver || low <= 0.0 || high < low) return FM_ERR_ARG;
+	if (low < 0.1) low = 0.1;
+	if (high < low) high = low;
+	solver->scale_low  = low;
+	solver->scale_high = high;
+	solver->fov    = (solver->w >= solver->h ? solver->w : solver->h) * high * 1.414 / 60.0;
+	solver->loaded = false;
+	solver->match.SetGuessScale(low, high);
+	return FM_OK;
+}
+
+int fm_solver_import(fm_solver* solver, const double* x, const double* y, const double* flux, int n) {
+	if (!solver || !x || !y || !flux || n < 0) return FM_ERR_ARG;
+	MatchRefsys& match = solver->match;
+	solver->solved = false;	// 星像改变后样本对失效
+	match.BeginImportImageObject(solver->w, solver->h);
+	for (int i = 0; i < n; ++i) match.ImportImageObject(x[i], y[i], flux[i]);
+	match.CompleteImportImageObject();
+	return n < 5 ? FM_ERR_OBJECT : FM_OK;
+}
+
+int fm_solver_solve(fm_solver* solver, double ra, double dec) {
+	if (!solver || ra < 0.0 || ra >= 360.0 || dec <= -90.0 || dec >= 90.0) return FM_ERR_ARG;
+	if (solver->match.GetImageObject().size() < 5) return FM_ERR_OBJECT;
+	int rslt = load_refstar(solver, ra, dec);
+	if (rslt != FM_OK) return rslt;
+	if ((solver->solved = solver->match.DoMatch())) {
+		solver->last    = solver->match.GetSolution();
+		solver->tracked = true;
+	}
+	return solver->solved ? FM_OK : FM_ERR_NOMATCH;
+}
+
+int fm_solver_track(fm_solver* solver) {
+	if (!solver) return FM_ERR_ARG;
+	if (!solver->tracked) return FM_ERR_NOSOLUTION;
+	if (solver->match.GetImageObject().size() < 5) return FM_ERR_OBJECT;
+
+	MatchRefsys::solution prior = solver->last;
+	// 指向偏离参考星中心超过1/4视场时, 重新加载参考星
+	double dra  = (prior.ra - solver->rac) * cos(prior.dec * D2R);
+	double ddec = prior.dec - solver->decc;
+	if (!solver->loaded || sqrt(dra * dra + ddec * ddec) * 60.0 > solver->fov * 0.25) {
+		int rslt = load_refstar(solver, prior.ra, prior.dec);
+		if (rslt != FM_OK) return rslt;
+	}
+	if ((solver->solved = solver->match.DoTrack(prior))) solver->last = solver->match.GetSolution();
+	return solver->solved ? FM_OK : FM_ERR_NOMATCH;
+}
+
+int fm_solver_get_solution(const fm_solver* solver, fm_solution* sol) {
+	if (!solver || !sol) return FM_ERR_ARG;
+	if (!solver->solved) return FM_ERR_NOSOLUTION;
+	const MatchRefsys::solution& s = solver->match.GetSolution();
+	sol->ra       = s.ra;
+	sol->dec      = s.dec;
+	sol->scale    = s.scale;
+	sol->rotation = s.rotation;
+	sol->parity   = s.parity;
+	sol->rms      = s.rms;
+	sol->matched  = s.matched;
+	return FM_OK;
+}
+
+int fm_solver_get_pairs(const fm_solver* solver, fm_pair* pairs, int max) {
+	if (!solver || max < 0) return FM_ERR_ARG;
+	if (!solver->solved) return FM_ERR_NOSOLUTION;
+	const MatchRefsys& match = solver->match;
+	const PtPairMSVec& matched = match.GetMatchedPair();
+	const MatchRefsys::ObjImgVec& objimg = match.GetImageObject();
+	const MatchRefsys::ObjWcsVec& objwcs = match.GetWcsObject();
+	int n = matched.size();
+
+	for (int i = 0; pairs && i < n && i < max; ++i) {
+		const MatchRefsys::object_image& img = objimg[matched[i].id1];
+		const MatchRefsys::object_wcs& wcs   = objwcs[matched[i].id2];
+		pairs[i].x   = img.x;
+		pairs[i].y   = img.y;
+		pairs[i].ra  = wcs.l * R2D;
+		pairs[i].dec = wcs.b * R2D;
+	}
+	return n;
+}
+
+int fm_solver_fit_wcs(fm_solver* solver, fm_wcs* wcs) {
+	if (!solver || !wcs) return FM_ERR_ARG;
+	if (!solver->solved) return FM_ERR_NOSOLUTION;
+	if (!solver->wcsfit.Fit(solver->match, solver->w, solver->h)) return FM_ERR_NOMATCH;
+
+	const WcsFit::wcs_sip& fit = solver->wcsfit.GetWcs();
+	for (int i = 0; i < 2; ++i) {
+		wcs->crval[i] = fit.crval[i];
+		wcs->crpix[i] = fit.crpix[i];
+		wcs->cd[i][0] = fit.cd[i][0];
+		wcs->cd[i][1] = fit.cd[i][1];
+	}
+	for (int p = 0; p <= FM_SIP_ORDER_MAX; ++p) {
+		for (int q = 0; q <= FM_SIP_ORDER_MAX; ++q) {
+			wcs->a[p][q] = fit.a[p][q];
+			wcs->b[p][q] = fit.b[p][q];
+		}
+	}
+	wcs->order   = fit.order;
+	wcs->rms     = fit.rms;
+	wcs->matched = fit.matched;
+	return FM_OK;
+}
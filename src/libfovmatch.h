@@ -0,0 +1,201 @@
+/**
+ * @file libfovmatch.h
+ * @brief libfovmatch: 星场与星表匹配的C语言接口
+ * @version 0.1
+ * @date 2026-10-18
+ * @note
+ * 函数调用流程:
+ * - fm_catalog_open: 由参数文件打开参考星表并加载索引. 星表在进程内常驻, 可被多个求解器共享
+ * - fm_solver_create: 由星表和图像尺寸创建求解器
+ * - 逐帧: fm_solver_import导入星像, fm_solver_solve或fm_solver_track解算,
+ *   fm_solver_get_solution/fm_solver_get_pairs查看结果. 需要全视场WCS时调用fm_solver_fit_wcs
+ * - fm_solver_destroy, fm_catalog_close: 释放资源. 星表应在全部求解器销毁后关闭
+ * @note
+ * 线程安全:
+ * - 不同求解器可在不同线程中并发使用, 同一求解器不可并发使用
+ * - 共享星表以访问接口查询, 不修改星表状态, 多个求解器的查询并发执行, 无需加锁
+ * @note
+ * ABI约定: 句柄不透明; 结构体布局固定, 扩展功能时新增函数和结构体; 以fm_version检查兼容性
+ */
+
+#ifndef LIBFOVMATCH_H_
+#define LIBFOVMATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define FM_API __attribute__((visibility("default")))
+#else
+#define FM_API
+#endif
+
+#define FM_VERSION		2	//< 接口版本
+
+/* 错误码 */
+#define FM_OK			0	//< 成功
+#define FM_ERR_ARG		-1	//< 参数错误
+#define FM_ERR_CONFIG	-2	//< 参数文件错误
+#define FM_ERR_CATALOG	-3	//< 星表不可用
+#define FM_ERR_OBJECT	-4	//< 星像不足
+#define FM_ERR_REFSTAR	-5	//< 参考星不足
+#define FM_ERR_NOMATCH	-6	//< 匹配失败
+#define FM_ERR_NOSOLUTION	-7	//< 尚无定位解
+
+typedef struct fm_catalog fm_catalog;	///< 参考星表句柄
+typedef struct fm_solver fm_solver;		///< 求解器句柄
+
+/*!
+ * @struct fm_solution
+ * @brief 定位解: 图像系到世界系的相似变换
+ */
+typedef struct fm_solution {
+	double ra, dec;		///< 图像中心的世界坐标, 量纲: 角度
+	double scale;		///< 像元比例尺, 量纲: 角秒/像素
+	double rotation;	///< 旋转角, 量纲: 角度
+	int parity;			///< 镜像: +1, 同向; -1, 沿X轴镜像
+	double rms;			///< 残差, 量纲: 像素
+	int matched;		///< 参与拟合的样本对数量
+} fm_solution;
+
+/*!
+ * @struct fm_pair
+ * @brief 样本对: 星像与参考星
+ */
+typedef struct fm_pair {
+	double x, y;		///< 星像坐标, 量纲: 像素
+	double ra, dec;		///< 参考星坐标, 量纲: 角度
+} fm_pair;
+
+#define FM_SIP_ORDER_MAX	5	//< SIP多项式的最高阶数
+
+/*!
+ * @struct fm_wcs
+ * @brief 全视场WCS: TAN投影与SIP畸变多项式
+ * @note
+ * u = x - crpix[0], v = y - crpix[1]
+ * (xi, eta) = cd * (u + sum(a[p][q] * u^p * v^q), v + sum(b[p][q] * u^p * v^q)), 2 <= p + q <= order
+ */
+typedef struct fm_wcs {
+	double crval[2];	///< 切点的世界坐标, 量纲: 角度
+	double crpix[2];	///< 参考像素, 与导入的星像坐标一致
+	double cd[2][2];	///< 线性变换, 量纲: 角度/像素
+	int order;			///< SIP阶数. 小于2时无畸变项
+	double a[FM_SIP_ORDER_MAX + 1][FM_SIP_ORDER_MAX + 1];	///< SIP系数: X
+	double b[FM_SIP_ORDER_MAX + 1][FM_SIP_ORDER_MAX + 1];	///< SIP系数: Y
+	double rms;			///< 残差, 量纲: 像素
+	int matched;		///< 交叉匹配的星像数量
+} fm_wcs;
+
+/*!
+ * @brief 查看接口版本
+ * @return
+ * FM_VERSION
+ */
+FM_API int fm_version(void);
+/*!
+ * @brief 查看错误码的说明
+ */
+FM_API const char* fm_strerror(int err);
+
+/*!
+ * @brief 打开参考星表
+ * @param config_path   参数文件路径. NULL: 使用内置参数
+ * @param catalog_path  星表文件路径. NULL: 使用参数文件中的路径
+ * @param err           错误码. 可为NULL
+ * @return
+ * 星表句柄. 失败时返回NULL
+ * @note
+ * 打开时执行一次查询, 使星表索引常驻内存
+ */
+FM_API fm_catalog* fm_catalog_open(const char* config_path, const char* catalog_path, int* err);
+/*!
+ * @brief 关闭参考星表
+ */
+FM_API void fm_catalog_close(fm_catalog* cat);
+
+/*!
+ * @brief 创建求解器
+ * @param cat  参考星表
+ * @param w    图像宽度, 量纲: 像素
+ * @param h    图像高度, 量纲: 像素
+ * @param err  错误码. 可为NULL
+ * @return
+ * 求解器句柄. 失败时返回NULL
+ * @note
+ * 求解器使用星表的参数, 比例尺范围取参数文件中的值
+ */
+FM_API fm_solver* fm_solver_create(fm_catalog* cat, int w, int h, int* err);
+/*!
+ * @brief 销毁求解器
+ */
+FM_API void fm_solver_destroy(fm_solver* solver);
+/*!
+ * @brief 设置像元比例尺范围
+ * @param low   下限, 量纲: 角秒/像素
+ * @param high  上限, 量纲: 角秒/像素
+ * @return
+ * 错误码
+ */
+FM_API int fm_solver_set_scale(fm_solver* solver, double low, double high);
+/*!
+ * @brief 导入一帧星像
+ * @param x     X坐标, 量纲: 像素
+ * @param y     Y坐标, 量纲: 像素
+ * @param flux  流量
+ * @param n     星像数量
+ * @return
+ * 错误码
+ * @note
+ * 此前的解和样本对失效, 需重新解算后查看
+ */
+FM_API int fm_solver_import(fm_solver* solver, const double* x, const double* y, const double* flux, int n);
+/*!
+ * @brief 在估计指向附近解算
+ * @param ra   图像中心赤经, 估计值, 量纲: 角度
+ * @param dec  图像中心赤纬, 估计值, 量纲: 角度
+ * @return
+ * 错误码
+ */
+FM_API int fm_solver_solve(fm_solver* solver, double ra, double dec);
+/*!
+ * @brief 以最近一次成功的解为先验跟踪解算
+ * @return
+ * 错误码
+ * @note
+ * 指向偏离参考星中心超过1/4视场时重新查询参考星. 跟踪失败时回退至完整匹配.
+ * 失败的帧不改变先验
+ */
+FM_API int fm_solver_track(fm_solver* solver);
+/*!
+ * @brief 查看定位解
+ * @param sol  定位解
+ * @return
+ * 错误码
+ */
+FM_API int fm_solver_get_solution(const fm_solver* solver, fm_solution* sol);
+/*!
+ * @brief 查看样本对
+ * @param pairs  样本对缓存区. 为NULL时仅返回数量
+ * @param max    缓存区容量
+ * @return
+ * 样本对数量. 大于max时仅写入前max项. 尚无定位解时返回错误码
+ */
+FM_API int fm_solver_get_pairs(const fm_solver* solver, fm_pair* pairs, int max);
+/*!
+ * @brief 拟合全视场WCS
+ * @param wcs  拟合结果
+ * @return
+ * 错误码
+ * @note
+ * 以定位解和样本对为初值, 交叉匹配全部星像与已加载的参考星, 拟合TAN投影和SIP畸变多项式.
+ * 阶数、搜索半径等取参数文件中的值
+ */
+FM_API int fm_solver_fit_wcs(fm_solver* solver, fm_wcs* wcs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBFOVMATCH_H_ */